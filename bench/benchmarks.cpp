@@ -1,38 +1,171 @@
-// #define CATCH_CONFIG_MAIN
-// #include "catch2/catch.hpp"
-
 #define ANKERL_NANOBENCH_IMPLEMENT
-#include "nanobench.h"
-#include "fhe/common/ntt.h"
-#include "fhe/ckks/ckks.h"
+#include "benchmarks.h"
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
 
-using namespace hehub;
 using namespace std;
 
-int main() {
-    // double d = 1.0;
-    // ankerl::nanobench::Bench().run("some double ops", [&] {
-    //     d += 1.0 / d;
-    //     if (d > 5.0) {
-    //         d -= 5.0;
-    //     }
-    //     ankerl::nanobench::doNotOptimizeAway(d);
-    // });
-    for (auto [LOGN, scaling_bits] :
-         {pair{12, 36}, pair{13, 43}, pair{14, 48}, pair{15, 55}}) {
-        u64 N = 1 << LOGN;
-        auto params = ckks::create_params(N, scaling_bits);
-        cache_ntt_factors_strict(LOGN, params.moduli);
-
-        CkksSk sk(params);
-        auto rot_key = get_rot_key(sk, params.additional_mod, 1);
-        std::vector<cc_double> data(N / 2);
-        auto ct = ckks::encrypt(ckks::simd_encode(data, params), sk);
-        ankerl::nanobench::Bench().timeUnit(1ms, "ms")
-            .run(string("CKKS rotation / N=") + to_string(N) +
-                 string(" / scaling=2^") + to_string(scaling_bits), [&] {
-            auto ct_rotated = ckks::rotate(ct, rot_key, 1);
-            ankerl::nanobench::doNotOptimizeAway(ct_rotated);
-        });
+namespace hehub {
+
+string bench_params(size_t log_dim, size_t limb_count) {
+    return "N=" + to_string(1ULL << log_dim) + " L=" + to_string(limb_count);
+}
+
+static u64 __pow_mod(u64 base, u64 exp, u64 modulus) {
+    u64 result = 1;
+    for (base %= modulus; exp; exp >>= 1) {
+        if (exp & 1) {
+            result = (u128)result * base % modulus;
+        }
+        base = (u128)base * base % modulus;
+    }
+    return result;
+}
+
+/// Miller-Rabin test, which is deterministic for 64-bit integers with these
+/// bases.
+static bool __is_prime(u64 n) {
+    if (n < 2) {
+        return false;
+    }
+    u64 d = n - 1;
+    size_t s = 0;
+    for (; d % 2 == 0; d /= 2) {
+        s++;
+    }
+    for (u64 a : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}) {
+        if (n == a) {
+            return true;
+        }
+        auto x = __pow_mod(a, d, n);
+        if (x == 1 || x == n - 1) {
+            continue;
+        }
+        bool composite = true;
+        for (size_t r = 1; r < s && composite; r++) {
+            x = (u128)x * x % n;
+            composite = (x != n - 1);
+        }
+        if (composite) {
+            return false;
+        }
+    }
+    return true;
+}
+
+vector<u64> bench_primes(size_t bits, size_t log_dim, size_t count) {
+    static map<pair<size_t, size_t>, vector<u64>> found;
+    auto &primes = found[{bits, log_dim}];
+    const u64 step = 2ULL << log_dim;
+    u64 candidate =
+        primes.empty() ? (1ULL << bits) - step + 1 : primes.back() - step;
+    for (; primes.size() < count; candidate -= step) {
+        if (__is_prime(candidate)) {
+            primes.push_back(candidate);
+        }
+    }
+    return vector<u64>(primes.begin(), primes.begin() + count);
+}
+
+CkksParams bench_ckks_params(size_t log_dim, size_t limb_count,
+                             size_t prime_bits) {
+    auto primes = bench_primes(prime_bits, log_dim, limb_count + 1);
+    CkksParams params;
+    params.dimension = 1ULL << log_dim;
+    params.moduli.assign(primes.begin(), primes.begin() + limb_count);
+    params.component_count = limb_count;
+    params.additional_mod = primes.back();
+    params.initial_scaling_factor = pow(2.0, 40);
+    return params;
+}
+
+} // namespace hehub
+
+using namespace hehub;
+
+static vector<size_t> parse_list(const string &text) {
+    vector<size_t> list;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        list.push_back(stoul(item));
+    }
+    return list;
+}
+
+static void print_usage() {
+    cout << "Usage: benchmarks [options]\n"
+            "  --filter=<prefix>    run the benchmarks whose names start with "
+            "the prefix,\n"
+            "                       e.g. ntt, ckks or ckks.rotate\n"
+            "  --log-dims=<list>    log2 of the dimensions, default "
+            "12,13,14,15,16\n"
+            "  --limbs=<list>       numbers of RNS components, default "
+            "1,2,4,8\n"
+            "  --prime-bits=<n>     bit length of the RNS primes, at most 62, "
+            "default 50\n"
+            "  --epochs=<n>         measurements per benchmark, default 11\n"
+            "  --format=<format>    text, json or csv, default text\n"
+            "  --output=<file>      where to write the json or csv results, "
+            "default stdout\n";
+}
+
+int main(int argc, char *argv[]) {
+    BenchSuite suite;
+    string format = "text";
+    string output_path;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto eq = arg.find('=');
+        auto key = arg.substr(0, eq);
+        auto value = eq == string::npos ? "" : arg.substr(eq + 1);
+        if (key == "--filter") {
+            suite.filter = value;
+        } else if (key == "--log-dims") {
+            suite.log_dims = parse_list(value);
+        } else if (key == "--limbs") {
+            suite.limb_counts = parse_list(value);
+        } else if (key == "--prime-bits") {
+            suite.prime_bits = stoul(value);
+        } else if (key == "--epochs") {
+            suite.bench.epochs(stoul(value));
+        } else if (key == "--format" &&
+                   (value == "text" || value == "json" || value == "csv")) {
+            format = value;
+        } else if (key == "--output") {
+            output_path = value;
+        } else {
+            print_usage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    // The table printed while running would break the machine-readable
+    // results if both go to stdout.
+    if (format != "text" && output_path.empty()) {
+        suite.bench.output(nullptr);
+    }
+    suite.bench.title("HEhub").warmup(1);
+
+    bench_mod_arith(suite);
+    bench_ntt(suite);
+    bench_rns(suite);
+    bench_ckks(suite);
+    bench_bgv(suite);
+    bench_linear_algebra(suite);
+
+    if (format == "text") {
+        return 0;
+    }
+    auto result_template = format == "json" ? ankerl::nanobench::templates::json()
+                                            : ankerl::nanobench::templates::csv();
+    if (output_path.empty()) {
+        suite.bench.render(result_template, cout);
+    } else {
+        ofstream output_file(output_path);
+        suite.bench.render(result_template, output_file);
     }
+    return 0;
 }
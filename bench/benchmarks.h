@@ -0,0 +1,88 @@
+/**
+ * @file benchmarks.h
+ * @brief The benchmark suite, in which each file registers the benchmarks of
+ * one module.
+ *
+ */
+
+#pragma once
+
+#include "fhe/ckks/ckks.h"
+#include "nanobench.h"
+#include <string>
+#include <vector>
+
+namespace hehub {
+
+/**
+ * @brief The settings and the results of a benchmark run. All the benchmarks
+ * share one nanobench object, so that the results are rendered together.
+ */
+struct BenchSuite {
+    /// Log2 of the polynomial dimensions to sweep.
+    std::vector<size_t> log_dims{12, 13, 14, 15, 16};
+
+    /// The numbers of RNS components (limbs) to sweep.
+    std::vector<size_t> limb_counts{1, 2, 4, 8};
+
+    /// The bit length of the primes of the RNS components.
+    size_t prime_bits = 50;
+
+    /// Only the benchmarks whose names start with this are run.
+    std::string filter;
+
+    ankerl::nanobench::Bench bench;
+
+    /// @brief Whether any benchmark with the name prefix is selected, which
+    /// is checked before an expensive setup (e.g. key generation).
+    bool wants(const std::string &prefix) const {
+        auto common = std::min(prefix.size(), filter.size());
+        return filter.compare(0, common, prefix, 0, common) == 0;
+    }
+
+    /**
+     * @brief Run a benchmark if it is selected.
+     * @param name The name of the operation, e.g. "ckks.rotate".
+     * @param params The parameters shown after the name, e.g. "N=4096 L=2".
+     * @param op The operation to measure.
+     */
+    template <typename Op>
+    void run(const std::string &name, const std::string &params, Op &&op) {
+        if (name.compare(0, filter.size(), filter) != 0) {
+            return;
+        }
+        bench.run(name + " " + params, std::forward<Op>(op));
+    }
+};
+
+/// @brief Format the dimension and limb count as benchmark parameters.
+std::string bench_params(size_t log_dim, size_t limb_count);
+
+/**
+ * @brief Get NTT-friendly primes, i.e. primes q = 1 mod 2N, just below a power
+ * of 2. This covers the dimensions beyond the built-in prime lists.
+ * @param bits The bit length of the primes.
+ * @param log_dim Log2 of the polynomial dimension N.
+ * @param count The number of primes.
+ * @return The primes in descending order.
+ */
+std::vector<u64> bench_primes(size_t bits, size_t log_dim, size_t count);
+
+/// @brief CKKS parameters with the given number of primes of prime_bits and one
+/// more as the additional modulus.
+CkksParams bench_ckks_params(size_t log_dim, size_t limb_count,
+                             size_t prime_bits = 50);
+
+void bench_mod_arith(BenchSuite &suite);
+
+void bench_ntt(BenchSuite &suite);
+
+void bench_rns(BenchSuite &suite);
+
+void bench_ckks(BenchSuite &suite);
+
+void bench_bgv(BenchSuite &suite);
+
+void bench_linear_algebra(BenchSuite &suite);
+
+} // namespace hehub
@@ -0,0 +1,71 @@
+#include "benchmarks.h"
+#include "fhe/bgv/bgv.h"
+#include "fhe/common/ntt.h"
+
+using namespace std;
+using ankerl::nanobench::doNotOptimizeAway;
+
+namespace hehub {
+
+void bench_bgv(BenchSuite &suite) {
+    if (!suite.wants("bgv")) {
+        return;
+    }
+    for (auto log_dim : suite.log_dims) {
+        // a plaintext prime with the 2N-th roots of unity for the SIMD slots,
+        // e.g. 786433 for N = 2^16 where 65537 has none
+        const u64 pt_modulus = bench_primes(20, log_dim, 1)[0];
+        for (auto limb_count : suite.limb_counts) {
+            auto moduli = bench_primes(suite.prime_bits, log_dim, limb_count);
+            RnsPolyParams params{1ULL << log_dim, limb_count, moduli};
+            cache_ntt_factors_strict(log_dim, moduli);
+            auto params_str = bench_params(log_dim, limb_count);
+
+            RlweSk sk(params);
+            vector<u64> data(params.dimension);
+            for (size_t i = 0; i < data.size(); i++) {
+                data[i] = i % pt_modulus;
+            }
+            auto pt = bgv::simd_encode(data, pt_modulus);
+            auto ct = bgv::encrypt(pt, sk);
+
+            suite.run("bgv.encode", params_str, [&] {
+                auto pt_encoded = bgv::simd_encode(data, pt_modulus);
+                doNotOptimizeAway(pt_encoded);
+            });
+            suite.run("bgv.decode", params_str, [&] {
+                auto data_decoded = bgv::simd_decode(pt);
+                doNotOptimizeAway(data_decoded);
+            });
+            suite.run("bgv.encrypt", params_str, [&] {
+                auto ct_encrypted = bgv::encrypt(pt, sk);
+                doNotOptimizeAway(ct_encrypted);
+            });
+            suite.run("bgv.decrypt", params_str, [&] {
+                auto pt_decrypted = bgv::decrypt(ct, sk);
+                doNotOptimizeAway(pt_decrypted);
+            });
+            suite.run("bgv.add", params_str, [&] {
+                auto ct_sum = bgv::add(ct, ct);
+                doNotOptimizeAway(ct_sum);
+            });
+            suite.run("bgv.mult_plain", params_str, [&] {
+                auto ct_prod = bgv::mult_plain(ct, pt);
+                doNotOptimizeAway(ct_prod);
+            });
+            suite.run("bgv.mult", params_str, [&] {
+                auto ct_prod = bgv::mult_low_level(ct, ct);
+                doNotOptimizeAway(ct_prod);
+            });
+            if (limb_count > 1) {
+                suite.run("bgv.mod_switch", params_str, [&] {
+                    auto ct_switched = ct;
+                    bgv::mod_switch_inplace(ct_switched);
+                    doNotOptimizeAway(ct_switched);
+                });
+            }
+        }
+    }
+}
+
+} // namespace hehub
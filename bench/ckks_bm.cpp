@@ -1,37 +1,139 @@
-// #include "catch2/catch.hpp"
-// #include "fhe/ckks/ckks.h"
-// #include "fhe/common/ntt.h"
-
-// using namespace hehub;
-// using namespace std;
-
-// TEST_CASE("benchmark ckks") {
-//     for (auto [LOGN, scaling_bits] :
-//          {pair{12, 36}, pair{13, 43}, pair{14, 48}, pair{15, 55}}) {
-//         u64 N = 1 << LOGN;
-//         auto params = ckks::create_params(N, scaling_bits);
-//         cache_ntt_factors_strict(LOGN, params.moduli);
-
-//         CkksSk sk(params);
-//         std::vector<cc_double> data(N / 2);
-//         BENCHMARK(string("CKKS encode+encrypt / N=") + to_string(N) +
-//                   string(" / scaling=2^") + to_string(scaling_bits)) {
-//             return ckks::encrypt(ckks::simd_encode(data, params), sk);
-//         };
-//     }
-
-//     for (auto [LOGN, scaling_bits] :
-//          {pair{12, 36}, pair{13, 43}, pair{14, 48}, pair{15, 55}}) {
-//         u64 N = 1 << LOGN;
-//         auto params = ckks::create_params(N, scaling_bits);
-//         cache_ntt_factors_strict(LOGN, params.moduli);
-
-//         CkksSk sk(params);
-//         std::vector<cc_double> data(N / 2);
-//         auto ct = ckks::encrypt(ckks::simd_encode(data, params), sk);
-//         BENCHMARK(string("CKKS decrypt+decode / N=") + to_string(N) +
-//                   string(" / scaling=2^") + to_string(scaling_bits)) {
-//             return ckks::simd_decode(ckks::decrypt(ct, sk));
-//         };
-//     }
-// }
+#include "benchmarks.h"
+#include "fhe/common/ntt.h"
+
+using namespace std;
+using ankerl::nanobench::doNotOptimizeAway;
+
+namespace hehub {
+
+void bench_ckks(BenchSuite &suite) {
+    if (!suite.wants("ckks")) {
+        return;
+    }
+    for (auto log_dim : suite.log_dims) {
+        for (auto limb_count : suite.limb_counts) {
+            auto params =
+                bench_ckks_params(log_dim, limb_count, suite.prime_bits);
+            auto all_moduli = params.moduli;
+            all_moduli.push_back(params.additional_mod);
+            cache_ntt_factors_strict(log_dim, all_moduli);
+            auto params_str = bench_params(log_dim, limb_count);
+
+            CkksSk sk(params);
+            vector<double> data(params.dimension / 2, 0.5);
+            auto pt = ckks::simd_encode(data, params);
+            auto ct = ckks::encrypt(pt, sk);
+
+            suite.run("ckks.encode", params_str, [&] {
+                auto pt_encoded = ckks::simd_encode(data, params);
+                doNotOptimizeAway(pt_encoded);
+            });
+            suite.run("ckks.decode", params_str, [&] {
+                auto data_decoded = ckks::simd_decode(pt);
+                doNotOptimizeAway(data_decoded);
+            });
+            suite.run("ckks.decode_slot", params_str, [&] {
+                auto slot = ckks::simd_decode(pt, 1);
+                doNotOptimizeAway(slot);
+            });
+            suite.run("ckks.decode_mean", params_str, [&] {
+                auto mean = ckks::decode(pt);
+                doNotOptimizeAway(mean);
+            });
+            suite.run("ckks.encrypt", params_str, [&] {
+                auto ct_encrypted = ckks::encrypt(pt, sk);
+                doNotOptimizeAway(ct_encrypted);
+            });
+            suite.run("ckks.decrypt", params_str, [&] {
+                auto pt_decrypted = ckks::decrypt(ct, sk);
+                doNotOptimizeAway(pt_decrypted);
+            });
+            suite.run("ckks.add", params_str, [&] {
+                auto ct_sum = ckks::add(ct, ct);
+                doNotOptimizeAway(ct_sum);
+            });
+            ckks::CtAccumulator accumulator;
+            suite.run("ckks.accumulate", params_str,
+                      [&] { accumulator.add(ct); });
+            doNotOptimizeAway(accumulator);
+            suite.run("ckks.mult_plain", params_str, [&] {
+                auto ct_prod = ckks::mult_plain(ct, pt);
+                doNotOptimizeAway(ct_prod);
+            });
+            suite.run("ckks.mult", params_str, [&] {
+                auto ct_prod = ckks::mult_low_level(ct, ct);
+                doNotOptimizeAway(ct_prod);
+            });
+            if (limb_count > 1 && suite.wants("ckks.linear_combination")) {
+                // a combination of 16 ciphertexts, compared with as many
+                // mult_plain and add
+                const size_t term_count = 16;
+                vector<CkksCt> cts(term_count, ct);
+                vector<double> weights(term_count, 0.25);
+                auto weight_pt = ckks::encode(0.25, params);
+                suite.run("ckks.linear_combination", params_str + " n=16", [&] {
+                    auto ct_comb = ckks::linear_combination(cts, weights);
+                    doNotOptimizeAway(ct_comb);
+                });
+                suite.run("ckks.linear_combination_naive",
+                          params_str + " n=16", [&] {
+                              auto ct_comb = ckks::mult_plain(cts[0], weight_pt);
+                              for (size_t j = 1; j < term_count; j++) {
+                                  ct_comb = ckks::add(
+                                      ct_comb,
+                                      ckks::mult_plain(cts[j], weight_pt));
+                              }
+                              ckks::rescale_inplace(ct_comb);
+                              doNotOptimizeAway(ct_comb);
+                          });
+            }
+            if (limb_count > 1) {
+                suite.run("ckks.rescale", params_str, [&] {
+                    auto ct_rescaled = ct;
+                    ckks::rescale_inplace(ct_rescaled);
+                    doNotOptimizeAway(ct_rescaled);
+                });
+            }
+
+            suite.run("ckks.keygen.secret", params_str, [&] {
+                CkksSk sk_new(params);
+                doNotOptimizeAway(sk_new);
+            });
+            if (!suite.wants("ckks.keygen.relin") &&
+                !suite.wants("ckks.relinearize") &&
+                !suite.wants("ckks.keygen.rot") &&
+                !suite.wants("ckks.rotate")) {
+                continue;
+            }
+            auto relin_key = get_relin_key(sk, params.additional_mod);
+            auto rot_key = get_rot_key(sk, params.additional_mod, 1);
+            suite.run("ckks.keygen.relin", params_str, [&] {
+                auto key = get_relin_key(sk, params.additional_mod);
+                doNotOptimizeAway(key);
+            });
+            suite.run("ckks.keygen.rot", params_str, [&] {
+                auto key = get_rot_key(sk, params.additional_mod, 1);
+                doNotOptimizeAway(key);
+            });
+
+            auto ct_quadratic = ckks::mult_low_level(ct, ct);
+            suite.run("ckks.relinearize", params_str, [&] {
+                auto ct_relin = ckks::relinearize(ct_quadratic, relin_key);
+                doNotOptimizeAway(ct_relin);
+            });
+            if (limb_count > 1) {
+                suite.run("ckks.relinearize_and_rescale", params_str, [&] {
+                    auto ct_relin =
+                        ckks::relinearize_and_rescale(ct_quadratic, relin_key);
+                    doNotOptimizeAway(ct_relin);
+                });
+            }
+            suite.run("ckks.rotate", params_str, [&] {
+                auto ct_rotated = ckks::rotate(ct, rot_key);
+                doNotOptimizeAway(ct_rotated);
+            });
+        }
+    }
+}
+
+} // namespace hehub
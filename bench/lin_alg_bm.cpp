@@ -0,0 +1,46 @@
+#include "benchmarks.h"
+#include "circuits/linear_algebra.h"
+
+using namespace std;
+using ankerl::nanobench::doNotOptimizeAway;
+
+namespace hehub {
+
+void bench_linear_algebra(BenchSuite &suite) {
+    if (!suite.wants("lin_alg")) {
+        return;
+    }
+    // The matrix width decides the number of rotations, hence a few small
+    // widths are measured at each dimension.
+    for (auto log_dim : suite.log_dims) {
+        for (auto limb_count : suite.limb_counts) {
+            auto params =
+                bench_ckks_params(log_dim, limb_count, suite.prime_bits);
+            auto slot_count = params.dimension / 2;
+            CkksSk sk(params);
+            vector<double> vec(slot_count, 0.5);
+            auto ct_vec = ckks::encrypt(ckks::simd_encode(vec, params), sk);
+
+            for (size_t width : {4, 16}) {
+                vector<RotKey> rot_keys(slot_count);
+                for (auto step : ckks::mv_mul_requiring_steps(slot_count,
+                                                              width)) {
+                    rot_keys[step] =
+                        get_rot_key(sk, params.additional_mod, step);
+                }
+                vector<vector<double>> mat(slot_count,
+                                           vector<double>(width, 0.25));
+                suite.run("lin_alg.mv_mul_short",
+                          bench_params(log_dim, limb_count) +
+                              " width=" + to_string(width),
+                          [&] {
+                              auto ct_prod = ckks::matrix_vector_mul_short(
+                                  mat, ct_vec, rot_keys);
+                              doNotOptimizeAway(ct_prod);
+                          });
+            }
+        }
+    }
+}
+
+} // namespace hehub
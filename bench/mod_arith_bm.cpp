@@ -1,46 +1,77 @@
-// #include "catch2/catch.hpp"
-// #include "fhe/common/mod_arith.h"
+#include "benchmarks.h"
+#include "fhe/common/mod_arith.h"
 
-// using namespace hehub;
+using namespace std;
+using ankerl::nanobench::doNotOptimizeAway;
 
-// TEST_CASE("BM reductions") {
-//     const u64 modulus = 1234567890111111111;
-//     const size_t vec_len = 8192;
+namespace hehub {
 
-//     u64 seed = 42;
-//     u64 f[vec_len], g[vec_len], h[vec_len], k[vec_len];
-//     for (size_t i = 0; i < vec_len; i++) {
-//         seed = seed * 65968279837582827 ^ 3948528936546489545;
-//         f[i] = seed % modulus;
-//         seed = seed * 43534547657678213 ^ 7955436776934235466;
-//         g[i] = seed % modulus;
-//         seed = (seed ^ 39857467872338747) * 65536 + 394866313;
-//         h[i] = seed;
-//         seed = (seed ^ 39857467872338747) * 65536 + 394866313;
-//         k[i] = seed;
-//     }
+void bench_mod_arith(BenchSuite &suite) {
+    if (!suite.wants("mod_arith")) {
+        return;
+    }
+    ankerl::nanobench::Rng rng(42);
+    for (auto log_dim : suite.log_dims) {
+        const size_t vec_len = 1ULL << log_dim;
+        const auto modulus = bench_primes(suite.prime_bits, log_dim, 1)[0];
+        const auto params = "N=" + to_string(vec_len);
 
-//     BENCHMARK("batched_barrett_lazy 8192") {
-//         return batched_barrett_lazy(modulus, vec_len, h);
-//     };
+        vector<u64> vec1(vec_len), vec2(vec_len), out(vec_len);
+        vector<u128> wide(vec_len);
+        for (size_t i = 0; i < vec_len; i++) {
+            vec1[i] = rng() % modulus;
+            vec2[i] = rng() % modulus;
+            wide[i] = (u128)vec1[i] * vec2[i];
+        }
+        // The in-place kernels are fed with values not fully reduced, since
+        // this is how they are used after lazy operations.
+        auto lazy_inputs = [&]() {
+            for (size_t i = 0; i < vec_len; i++) {
+                out[i] = vec1[i] + modulus;
+            }
+        };
 
-//     BENCHMARK("batched_barrett 8192") {
-//         return batched_barrett(modulus, vec_len, k);
-//     };
+        suite.run("mod_arith.batched_barrett_lazy", params, [&] {
+            lazy_inputs();
+            batched_barrett_lazy(modulus, vec_len, out.data());
+            doNotOptimizeAway(out.data());
+        });
+        suite.run("mod_arith.batched_barrett", params, [&] {
+            lazy_inputs();
+            batched_barrett(modulus, vec_len, out.data());
+            doNotOptimizeAway(out.data());
+        });
+        suite.run("mod_arith.batched_reduce_strict", params, [&] {
+            lazy_inputs();
+            batched_reduce_strict(modulus, vec_len, out.data());
+            doNotOptimizeAway(out.data());
+        });
+        suite.run("mod_arith.batched_mul_mod_hybrid_lazy", params, [&] {
+            batched_mul_mod_hybrid_lazy(modulus, vec_len, vec1.data(),
+                                        vec2.data(), out.data());
+            doNotOptimizeAway(out.data());
+        });
+        suite.run("mod_arith.batched_mul_mod_hybrid", params, [&] {
+            batched_mul_mod_hybrid(modulus, vec_len, vec1.data(), vec2.data(),
+                                   out.data());
+            doNotOptimizeAway(out.data());
+        });
+        suite.run("mod_arith.batched_mul_mod_barrett_lazy", params, [&] {
+            batched_mul_mod_barrett_lazy(modulus, vec_len, vec1.data(),
+                                         vec2.data(), out.data());
+            doNotOptimizeAway(out.data());
+        });
+        suite.run("mod_arith.batched_mul_mod_barrett", params, [&] {
+            batched_mul_mod_barrett(modulus, vec_len, vec1.data(), vec2.data(),
+                                    out.data());
+            doNotOptimizeAway(out.data());
+        });
+        suite.run("mod_arith.batched_montgomery_128_lazy", params, [&] {
+            batched_montgomery_128_lazy(modulus, vec_len, wide.data(),
+                                        out.data());
+            doNotOptimizeAway(out.data());
+        });
+    }
+}
 
-//     BENCHMARK("batched_mul_mod_hybrid_lazy 8192") {
-//         return batched_mul_mod_hybrid_lazy(modulus, vec_len, f, g, h);
-//     };
-
-//     BENCHMARK("batched_mul_mod_barrett_lazy 8192") {
-//         return batched_mul_mod_barrett_lazy(modulus, vec_len, f, g, h);
-//     };
-
-//     BENCHMARK("batched_mul_mod_hybrid 8192") {
-//         return batched_mul_mod_hybrid(modulus, vec_len, f, g, h);
-//     };
-
-//     BENCHMARK("batched_mul_mod_barrett 8192") {
-//         return batched_mul_mod_barrett(modulus, vec_len, f, g, h);
-//     };
-// }
+} // namespace hehub
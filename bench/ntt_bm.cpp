@@ -1,41 +1,146 @@
-// #include "catch2/catch.hpp"
-// #include "fhe/common/ntt.h"
-// #include "fhe/common/rns.h"
-// #include <random>
-
-// using namespace hehub;
-
-// TEST_CASE("benchmark ntt and intt") {
-//     u64 Q = 576460752272228353ULL;
-
-//     std::random_device rd;
-//     std::default_random_engine generator(rd());
-//     std::uniform_int_distribution<u64> distribution(0, Q - 1);
-
-//     for (auto LOGN: {10, 11, 12, 13, 14, 15}) {
-//         u64 N = 1 << LOGN;
-//         cache_ntt_factors_strict(LOGN, std::vector{Q});
-
-//         u64 poly[N];
-//         for (int i = 0; i < N; i++) {
-//             poly[i] = distribution(generator);
-//         }
-        
-//         BENCHMARK(std::string("NTT / len=") + std::to_string(N)) {
-//             return ntt_negacyclic_inplace_lazy(LOGN, Q, poly);
-//         };
-//     }
-
-//     for (auto LOGN: {10, 11, 12, 13, 14, 15}) {
-//         u64 N = 1 << LOGN;
-
-//         u64 poly[N];
-//         for (int i = 0; i < N; i++) {
-//             poly[i] = distribution(generator);
-//         }
-        
-//         BENCHMARK(std::string("INTT / len=") + std::to_string(N)) {
-//             return intt_negacyclic_inplace_lazy(LOGN, Q, poly);
-//         };
-//     }
-// }
+#include "benchmarks.h"
+#include "fhe/common/kernel_presets.h"
+#include "fhe/common/ntt.h"
+#include "fhe/common/sampling.h"
+
+using namespace std;
+using ankerl::nanobench::doNotOptimizeAway;
+
+namespace hehub {
+
+/// A 59-bit prime for the dimensions up to 2^16, whose kernels are specialized.
+constexpr u64 PRESET_MODULUS = 576460752272228353ULL;
+
+template <size_t... LogDims>
+static void __register_ntt_preset(size_t log_dim,
+                                  std::index_sequence<LogDims...>) {
+    ((log_dim == LogDims + 1 ? register_kernel_preset<LogDims + 1,
+                                                      PRESET_MODULUS>()
+                             : void()),
+     ...);
+}
+
+void bench_ntt(BenchSuite &suite) {
+    if (!suite.wants("ntt")) {
+        return;
+    }
+    for (auto log_dim : suite.log_dims) {
+        for (auto limb_count : suite.limb_counts) {
+            auto moduli = bench_primes(suite.prime_bits, log_dim, limb_count);
+            RnsPolyParams params{1ULL << log_dim, limb_count, moduli};
+            cache_ntt_factors_strict(log_dim, moduli);
+            auto params_str = bench_params(log_dim, limb_count);
+
+            // The transforms are lazy, so that the input of one transform
+            // stays valid for the next.
+            auto poly = get_rand_uniform_poly(params, PolyRepForm::coeff);
+            suite.run("ntt.forward", params_str, [&] {
+                poly.rep_form = PolyRepForm::coeff;
+                ntt_negacyclic_inplace_lazy(poly);
+                doNotOptimizeAway(poly);
+            });
+            suite.run("ntt.inverse", params_str, [&] {
+                poly.rep_form = PolyRepForm::value;
+                intt_negacyclic_inplace_lazy(poly);
+                doNotOptimizeAway(poly);
+            });
+
+            // the factors in the compact storage, whose bytes of all the limbs
+            // are shown with those of the full storage
+            if (suite.wants("ntt.forward_compact") ||
+                suite.wants("ntt.inverse_compact")) {
+                auto factor_kib = [&](NTTFactorStorage storage) {
+                    return to_string(limb_count *
+                                     ntt_factor_bytes(log_dim, storage) / 1024);
+                };
+                auto compact_params_str =
+                    params_str + " factors=" +
+                    factor_kib(NTTFactorStorage::compact) + "/" +
+                    factor_kib(NTTFactorStorage::full) + "KiB";
+                set_ntt_factor_storage(NTTFactorStorage::compact);
+                cache_ntt_factors_strict(log_dim, moduli);
+                suite.run("ntt.forward_compact", compact_params_str, [&] {
+                    poly.rep_form = PolyRepForm::coeff;
+                    ntt_negacyclic_inplace_lazy(poly);
+                    doNotOptimizeAway(poly);
+                });
+                suite.run("ntt.inverse_compact", compact_params_str, [&] {
+                    poly.rep_form = PolyRepForm::value;
+                    intt_negacyclic_inplace_lazy(poly);
+                    doNotOptimizeAway(poly);
+                });
+                set_ntt_factor_storage(NTTFactorStorage::full);
+            }
+
+            // the NTTs of the small dimensions are done on several components
+            // at once, which is compared with doing them one by one
+            if (log_dim <= NTT_INTERLEAVING_MAX_LOG_DIMENSION &&
+                limb_count > 1) {
+                suite.run("ntt.forward_per_limb", params_str, [&] {
+                    for (size_t k = 0; k < limb_count; k++) {
+                        ntt_negacyclic_inplace_lazy(log_dim, moduli[k],
+                                                    poly[k].data());
+                    }
+                    doNotOptimizeAway(poly);
+                });
+            }
+        }
+
+        // a component modulo a 27-bit prime on 64-bit and on 32-bit words
+        const size_t dimension = 1ULL << log_dim;
+        const auto modulus = bench_primes(27, log_dim, 1)[0];
+        auto params_str = bench_params(log_dim, 1);
+        vector<u64> coeffs(dimension);
+        vector<u32> coeffs_32bit(dimension);
+        for (size_t i = 0; i < dimension; i++) {
+            coeffs[i] = coeffs_32bit[i] = i % modulus;
+        }
+        suite.run("ntt.forward_27bit", params_str, [&] {
+            ntt_negacyclic_inplace_lazy(log_dim, modulus, coeffs.data());
+            doNotOptimizeAway(coeffs);
+        });
+        suite.run("ntt.forward_27bit_32bit_words", params_str, [&] {
+            ntt_negacyclic_inplace_lazy(log_dim, (u32)modulus,
+                                        coeffs_32bit.data());
+            doNotOptimizeAway(coeffs_32bit);
+        });
+
+        // the transforms skipping the zeros and the unneeded outputs, e.g. of
+        // a plaintext with 8 slots used
+        const auto sparse_modulus =
+            bench_primes(suite.prime_bits, log_dim, 1)[0];
+        vector<u64> values(dimension, 0);
+        suite.run("ntt.inverse_sparse_8", params_str, [&] {
+            fill(values.begin(), values.begin() + 8, 1);
+            intt_negacyclic_inplace_lazy_sparse(log_dim, sparse_modulus,
+                                                values.data(), 8);
+            doNotOptimizeAway(values);
+        });
+        suite.run("ntt.forward_truncated_8", params_str, [&] {
+            ntt_negacyclic_inplace_lazy_truncated(log_dim, sparse_modulus,
+                                                  values.data(), 0, 8);
+            doNotOptimizeAway(values);
+        });
+
+        // the generic kernel and the one specialized for the dimension and
+        // the modulus, where the preset is registered after the former
+        if (suite.wants("ntt.forward_59bit")) {
+            for (size_t i = 0; i < dimension; i++) {
+                coeffs[i] = i;
+            }
+            suite.run("ntt.forward_59bit", params_str, [&] {
+                ntt_negacyclic_inplace_lazy(log_dim, PRESET_MODULUS,
+                                            coeffs.data());
+                doNotOptimizeAway(coeffs);
+            });
+            __register_ntt_preset(log_dim, std::make_index_sequence<16>());
+            suite.run("ntt.forward_59bit_preset", params_str, [&] {
+                ntt_negacyclic_inplace_lazy(log_dim, PRESET_MODULUS,
+                                            coeffs.data());
+                doNotOptimizeAway(coeffs);
+            });
+        }
+    }
+}
+
+} // namespace hehub
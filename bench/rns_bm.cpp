@@ -0,0 +1,48 @@
+#include "benchmarks.h"
+#include "fhe/common/ntt.h"
+#include "fhe/common/sampling.h"
+
+using namespace std;
+using ankerl::nanobench::doNotOptimizeAway;
+
+namespace hehub {
+
+void bench_rns(BenchSuite &suite) {
+    if (!suite.wants("rns") && !suite.wants("sampling")) {
+        return;
+    }
+    for (auto log_dim : suite.log_dims) {
+        for (auto limb_count : suite.limb_counts) {
+            auto moduli = bench_primes(suite.prime_bits, log_dim, limb_count);
+            RnsPolyParams params{1ULL << log_dim, limb_count, moduli};
+            cache_ntt_factors_strict(log_dim, moduli);
+            auto params_str = bench_params(log_dim, limb_count);
+
+            auto poly1 = get_rand_uniform_poly(params, PolyRepForm::value);
+            auto poly2 = get_rand_uniform_poly(params, PolyRepForm::value);
+            suite.run("rns.add", params_str, [&] {
+                auto sum = poly1 + poly2;
+                doNotOptimizeAway(sum);
+            });
+            suite.run("rns.mul", params_str, [&] {
+                auto prod = poly1 * poly2;
+                doNotOptimizeAway(prod);
+            });
+
+            suite.run("sampling.ternary", params_str, [&] {
+                auto poly = get_rand_ternary_poly(params);
+                doNotOptimizeAway(poly);
+            });
+            suite.run("sampling.uniform", params_str, [&] {
+                auto poly = get_rand_uniform_poly(params);
+                doNotOptimizeAway(poly);
+            });
+            suite.run("sampling.gaussian", params_str, [&] {
+                auto poly = get_rand_gaussian_poly(params);
+                doNotOptimizeAway(poly);
+            });
+        }
+    }
+}
+
+} // namespace hehub
@@ -0,0 +1,723 @@
+#include "circuit.h"
+#include "fhe/common/task_runtime.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+using namespace std;
+
+namespace hehub {
+
+Wire CircuitGraph::add_node(Op op, vector<Wire> operands, size_t param) {
+    for (auto operand : operands) {
+        if (operand >= nodes_.size()) {
+            throw invalid_argument("Invalid wire.");
+        }
+    }
+    if (op == Op::add || op == Op::mult) {
+        sort(operands.begin(), operands.end());
+    }
+
+    auto key = make_tuple(op, operands, param);
+    auto found = node_index_.find(key);
+    if (found != node_index_.end()) {
+        return found->second;
+    }
+    nodes_.push_back(Node{op, move(operands), param});
+    return node_index_[key] = nodes_.size() - 1;
+}
+
+Wire CircuitGraph::input() { return add_node(Op::input, {}, input_count_++); }
+
+Wire CircuitGraph::add(Wire wire1, Wire wire2) {
+    return add_node(Op::add, {wire1, wire2});
+}
+
+Wire CircuitGraph::sub(Wire wire1, Wire wire2) {
+    return add_node(Op::sub, {wire1, wire2});
+}
+
+Wire CircuitGraph::mult(Wire wire1, Wire wire2) {
+    return add_node(Op::mult, {wire1, wire2});
+}
+
+void CircuitGraph::output(Wire wire) {
+    if (wire >= nodes_.size()) {
+        throw invalid_argument("Invalid wire.");
+    }
+    outputs_.push_back(wire);
+}
+
+size_t CircuitGraph::Plan::count(StepKind kind) const {
+    return count_if(steps.begin(), steps.end(),
+                    [kind](const Step &step) { return step.kind == kind; });
+}
+
+CircuitGraph::Plan CircuitGraph::optimize() const {
+    // Find the nodes which the outputs depend on, noting that the operands of
+    // a node are always recorded before it.
+    vector<bool> live(nodes_.size(), false);
+    for (auto wire : outputs_) {
+        live[wire] = true;
+    }
+    for (size_t i = nodes_.size(); i-- > 0;) {
+        if (live[i]) {
+            for (auto operand : nodes_[i].operands) {
+                live[operand] = true;
+            }
+        }
+    }
+
+    // The rotations sharing an input will share the decomposition.
+    vector<size_t> rotation_count(nodes_.size(), 0);
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        if (live[i] && nodes_[i].op == Op::rotate) {
+            rotation_count[nodes_[i].operands[0]]++;
+        }
+    }
+
+    // The scaling factor of a result, which is Delta^delta_power divided by
+    // the primes dropped by rescaling, where Delta is the scaling factor of
+    // the inputs, and divisions[l] counts the prime dropped at level l. The
+    // plaintexts are encoded at the scaling factor of their ciphertexts.
+    struct Scale {
+        int delta_power = 1;
+        vector<int> divisions;
+
+        int division(size_t level) const {
+            return level < divisions.size() ? divisions[level] : 0;
+        }
+
+        void divide(size_t level, int count = 1) {
+            divisions.resize(max(divisions.size(), level + 1), 0);
+            divisions[level] += count;
+        }
+
+        Scale operator*(const Scale &other) const {
+            Scale product{delta_power + other.delta_power, divisions};
+            for (size_t l = 0; l < other.divisions.size(); l++) {
+                product.divide(l, other.divisions[l]);
+            }
+            return product;
+        }
+
+        bool operator==(const Scale &other) const {
+            auto levels = max(divisions.size(), other.divisions.size());
+            for (size_t l = 0; l < levels; l++) {
+                if (division(l) != other.division(l)) {
+                    return false;
+                }
+            }
+            return delta_power == other.delta_power;
+        }
+
+        /// The log of the scaling factor in the unit of log(Delta), as the
+        /// rescaling primes are close to Delta.
+        int magnitude() const {
+            int power = delta_power;
+            for (auto count : divisions) {
+                power -= count;
+            }
+            return power;
+        }
+    };
+
+    // How a node is computed by the plan. The level is the number of primes
+    // dropped, and an unscaled result (i.e. a product) needs rescaling before
+    // being multiplied again.
+    struct Form {
+        size_t step;
+        size_t level;
+        bool unscaled;
+        bool quadratic;
+        Scale scale;
+    };
+
+    Plan plan;
+    auto add_step = [&](StepKind kind, vector<size_t> operands,
+                        size_t param = 0) {
+        plan.steps.push_back(Step{kind, move(operands), param});
+        return plan.steps.size() - 1;
+    };
+
+    // The conversions are memorized so that a result used by several nodes is
+    // converted only once.
+    map<size_t, Form> relinearized, rescaled, decomposed;
+    map<pair<size_t, size_t>, Form> dropped;
+    map<tuple<size_t, size_t, size_t>, Form> upscaled;
+    auto as_linear = [&](Form form) {
+        if (!form.quadratic) {
+            return form;
+        }
+        auto found = relinearized.find(form.step);
+        if (found != relinearized.end()) {
+            return found->second;
+        }
+        Form result{add_step(StepKind::relinearize, {form.step}), form.level,
+                    form.unscaled, false, form.scale};
+        return relinearized[form.step] = result;
+    };
+    auto as_rescaled = [&](Form form) {
+        if (!form.unscaled) {
+            return form;
+        }
+        // A product not relinearized yet is relinearized and rescaled at once.
+        if (form.quadratic && !relinearized.count(form.step)) {
+            auto found = rescaled.find(form.step);
+            if (found != rescaled.end()) {
+                return found->second;
+            }
+            Form result{add_step(StepKind::relinearize_rescale, {form.step}),
+                        form.level + 1, false, false, form.scale};
+            result.scale.divide(form.level);
+            return rescaled[form.step] = result;
+        }
+        form = as_linear(form);
+        auto found = rescaled.find(form.step);
+        if (found != rescaled.end()) {
+            return found->second;
+        }
+        Form result{add_step(StepKind::rescale, {form.step}), form.level + 1,
+                    false, false, form.scale};
+        result.scale.divide(form.level);
+        return rescaled[form.step] = result;
+    };
+    auto at_level = [&](Form form, size_t level) {
+        if (form.level >= level) {
+            return form;
+        }
+        form = as_linear(form);
+        auto key = make_pair(form.step, level);
+        auto found = dropped.find(key);
+        if (found != dropped.end()) {
+            return found->second;
+        }
+        Form result{
+            add_step(StepKind::drop_primes, {form.step}, level - form.level),
+            level, form.unscaled, false, form.scale};
+        return dropped[key] = result;
+    };
+    auto align = [&](Form &form1, Form &form2) {
+        auto level = max(form1.level, form2.level);
+        form1 = at_level(form1, level);
+        form2 = at_level(form2, level);
+    };
+    // Bring a linear form to the scaling factor of the target, or to that
+    // times its last prime and then rescale it if to_rescale.
+    auto upscale = [&](Form form, const Form &target, bool to_rescale) {
+        auto key = make_tuple(form.step, target.step, (size_t)to_rescale);
+        auto found = upscaled.find(key);
+        if (found != upscaled.end()) {
+            return found->second;
+        }
+        Form result{add_step(StepKind::upscale, {form.step, target.step},
+                             to_rescale),
+                    form.level, true, false, target.scale};
+        if (to_rescale) {
+            result.scale.divide(form.level, -1);
+            result = as_rescaled(result);
+        }
+        return upscaled[key] = result;
+    };
+    // Match the scaling factors of two addends. A scaled addend is brought to
+    // the larger scaling factor of an unscaled one by a constant, so that the
+    // sum is rescaled once. Otherwise both are rescaled, and the one with more
+    // primes left is brought to the scaling factor of the other times its
+    // last prime, which is then dropped by rescaling, as the ratio of two
+    // scaling factors of the same magnitude is not a precise constant.
+    auto match_scales = [&](Form &form1, Form &form2) {
+        if (form1.scale == form2.scale) {
+            return;
+        }
+        if (form1.unscaled != form2.unscaled) {
+            auto &scaled = form1.unscaled ? form2 : form1;
+            const auto &unscaled = form1.unscaled ? form1 : form2;
+            if (unscaled.scale.magnitude() > scaled.scale.magnitude()) {
+                scaled = upscale(scaled, unscaled, false);
+                return;
+            }
+        }
+        form1 = as_rescaled(form1);
+        form2 = as_rescaled(form2);
+        if (form1.scale == form2.scale) {
+            return;
+        }
+        if (form1.level <= form2.level) {
+            form1 = upscale(form1, form2, true);
+        } else {
+            form2 = upscale(form2, form1, true);
+        }
+    };
+
+    vector<Form> forms(nodes_.size());
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        if (!live[i]) {
+            continue;
+        }
+        const auto &node = nodes_[i];
+        switch (node.op) {
+        case Op::input:
+            forms[i] = Form{add_step(StepKind::input, {}, node.param), 0,
+                            false, false, Scale{}};
+            break;
+        case Op::add:
+        case Op::sub: {
+            auto form1 = forms[node.operands[0]];
+            auto form2 = forms[node.operands[1]];
+            match_scales(form1, form2);
+            align(form1, form2);
+            auto kind = node.op == Op::add ? StepKind::add : StepKind::sub;
+            forms[i] = Form{add_step(kind, {form1.step, form2.step}),
+                            form1.level, form1.unscaled || form2.unscaled,
+                            form1.quadratic || form2.quadratic, form1.scale};
+            break;
+        }
+        case Op::add_plain: {
+            auto form = forms[node.operands[0]];
+            form.step = add_step(StepKind::add_plain, {form.step}, node.param);
+            forms[i] = form;
+            break;
+        }
+        case Op::mult_plain: {
+            auto form = as_rescaled(forms[node.operands[0]]);
+            forms[i] = Form{
+                add_step(StepKind::mult_plain, {form.step}, node.param),
+                form.level, true, false, form.scale * form.scale};
+            break;
+        }
+        case Op::mult: {
+            auto form1 = as_rescaled(forms[node.operands[0]]);
+            auto form2 = as_rescaled(forms[node.operands[1]]);
+            align(form1, form2);
+            forms[i] = Form{add_step(StepKind::mult, {form1.step, form2.step}),
+                            form1.level, true, true, form1.scale * form2.scale};
+            break;
+        }
+        case Op::rotate: {
+            auto form = as_rescaled(forms[node.operands[0]]);
+            vector<size_t> operands{form.step};
+            if (rotation_count[node.operands[0]] >= 2) {
+                auto found = decomposed.find(form.step);
+                if (found == decomposed.end()) {
+                    Form decomposition{add_step(StepKind::decompose,
+                                                {form.step}, node.param),
+                                       form.level, false, false, form.scale};
+                    found = decomposed.emplace(form.step, decomposition).first;
+                }
+                operands.push_back(found->second.step);
+            }
+            forms[i] = Form{add_step(StepKind::rotate, operands, node.param),
+                            form.level, false, false, form.scale};
+            break;
+        }
+        }
+    }
+
+    for (auto wire : outputs_) {
+        plan.outputs.push_back(as_rescaled(forms[wire]).step);
+    }
+    return plan;
+}
+
+void CircuitGraph::run(const Plan &plan,
+                       const function<void(size_t)> &eval,
+                       const function<void(size_t)> &release) const {
+    const auto step_count = plan.steps.size();
+    vector<vector<size_t>> consumers(step_count);
+    vector<atomic<size_t>> waiting(step_count);
+    vector<atomic<size_t>> uses(step_count);
+    for (size_t i = 0; i < step_count; i++) {
+        for (auto operand : plan.steps[i].operands) {
+            consumers[operand].push_back(i);
+            waiting[i]++;
+            uses[operand]++;
+        }
+    }
+    // the outputs are never released
+    for (auto output : plan.outputs) {
+        uses[output]++;
+    }
+
+    auto finish = [&](size_t i) {
+        for (auto operand : plan.steps[i].operands) {
+            if (--uses[operand] == 0) {
+                release(operand);
+            }
+        }
+    };
+
+    // The steps are in topological order, hence can be run one by one.
+    if (get_thread_count() == 1) {
+        for (size_t i = 0; i < step_count; i++) {
+            eval(i);
+            finish(i);
+        }
+        return;
+    }
+
+    TaskGroup group;
+    function<void(size_t)> run_step = [&](size_t i) {
+        eval(i);
+        finish(i);
+        for (auto consumer : consumers[i]) {
+            if (--waiting[consumer] == 0) {
+                group.spawn([&run_step, consumer]() { run_step(consumer); });
+            }
+        }
+    };
+    // The ready steps are collected first, since the counters are decreased
+    // by the running steps once spawned.
+    vector<size_t> ready_steps;
+    for (size_t i = 0; i < step_count; i++) {
+        if (waiting[i] == 0) {
+            ready_steps.push_back(i);
+        }
+    }
+    for (auto i : ready_steps) {
+        group.spawn([&run_step, i]() { run_step(i); });
+    }
+    group.wait();
+}
+
+/// Negate a polynomial modulo each of its moduli.
+static RnsPolynomial __negate(const RnsPolynomial &poly) {
+    vector<u64> minus_one;
+    for (auto modulus : poly.modulus_vec()) {
+        minus_one.push_back(modulus - 1);
+    }
+    auto negated(poly);
+    negated *= minus_one;
+    return negated;
+}
+
+/// The result of a step, which is a ciphertext possibly with a third
+/// polynomial (i.e. quadratic), or the decomposition for key switching.
+template <typename Ct> struct StepValue {
+    Ct ct;
+
+    bool quadratic = false;
+
+    RnsPolynomial ct2;
+
+    vector<RnsPolynomial> decomposed;
+};
+
+/// Add or subtract two step values by the addition or subtraction of the
+/// scheme, taking care of the third polynomials.
+template <typename Ct, typename AddSub>
+static StepValue<Ct> __add_sub(const StepValue<Ct> &value1,
+                               const StepValue<Ct> &value2, bool subtract,
+                               AddSub add_sub) {
+    StepValue<Ct> result;
+    result.ct = add_sub(value1.ct, value2.ct);
+    result.quadratic = value1.quadratic || value2.quadratic;
+    if (value1.quadratic && value2.quadratic) {
+        result.ct2 = subtract ? value1.ct2 - value2.ct2
+                              : value1.ct2 + value2.ct2;
+    } else if (value1.quadratic) {
+        result.ct2 = value1.ct2;
+    } else if (value2.quadratic) {
+        result.ct2 = subtract ? __negate(value2.ct2) : value2.ct2;
+    }
+    return result;
+}
+
+namespace ckks {
+
+/// Multiply a ciphertext by the integer nearest to a factor, which is large
+/// enough for the rounding to be negligible.
+static CkksCt __mult_constant(const CkksCt &ct, double factor) {
+    if (!(factor >= 1.0 && factor < std::pow(2.0, 63))) {
+        throw logic_error("Scaling factors too different to be matched.");
+    }
+    auto constant = (u64)std::llround(factor);
+    vector<u64> reduced;
+    for (auto modulus : ct[0].modulus_vec()) {
+        reduced.push_back(constant % modulus);
+    }
+    auto product(ct);
+    for (auto &poly : product) {
+        poly *= reduced;
+    }
+    return product;
+}
+
+/// The plan matches the scaling factors of the addends, whose floating point
+/// values may still differ in the last bits as they are computed in different
+/// orders, hence the second one is unified with the first one. A larger
+/// difference is left to the check of the addition.
+static CkksCt __with_scaling_factor_of(const CkksCt &ct, const CkksCt &other) {
+    auto unified(ct);
+    if (std::abs(ct.scaling_factor - other.scaling_factor) <=
+        other.scaling_factor * std::pow(2.0, -40)) {
+        unified.scaling_factor = other.scaling_factor;
+    }
+    return unified;
+}
+
+size_t Circuit::plain_index(const vector<double> &data) {
+    auto found = plain_indices_.find(data);
+    if (found != plain_indices_.end()) {
+        return found->second;
+    }
+    plain_data_.push_back(data);
+    return plain_indices_[data] = plain_data_.size() - 1;
+}
+
+Wire Circuit::add_plain(Wire wire, const vector<double> &data) {
+    return add_node(Op::add_plain, {wire}, plain_index(data));
+}
+
+Wire Circuit::mult_plain(Wire wire, const vector<double> &data) {
+    return add_node(Op::mult_plain, {wire}, plain_index(data));
+}
+
+Wire Circuit::rotate(Wire wire, size_t step) {
+    return add_node(Op::rotate, {wire}, step);
+}
+
+vector<CkksCt> Circuit::execute(const vector<CkksCt> &inputs,
+                                const RlweKsk &relin_key,
+                                const vector<RotKey> &rot_key_set) const {
+    if (inputs.size() != input_count()) {
+        throw invalid_argument("Input number mismatch.");
+    }
+    auto plan = optimize();
+    for (auto &step : plan.steps) {
+        if (step.kind == StepKind::rotate &&
+            (step.param >= rot_key_set.size() ||
+             rot_key_set[step.param].empty())) {
+            throw invalid_argument(
+                "Required rotation key not generated. (Need key for " +
+                to_string(step.param) + " steps.)");
+        }
+    }
+
+    auto encode_like = [](const vector<double> &data, const CkksCt &ct) {
+        CkksParams params = ct[0].params();
+        params.initial_scaling_factor = ct.scaling_factor;
+        return simd_encode(data, params);
+    };
+
+    vector<StepValue<CkksCt>> values(plan.steps.size());
+    auto eval = [&](size_t i) {
+        const auto &step = plan.steps[i];
+        auto operand = [&](size_t k) -> const StepValue<CkksCt> & {
+            return values[step.operands[k]];
+        };
+        auto &result = values[i];
+        switch (step.kind) {
+        case StepKind::input:
+            result.ct = inputs[step.param];
+            break;
+        case StepKind::add:
+        case StepKind::sub: {
+            bool subtract = step.kind == StepKind::sub;
+            result = __add_sub(operand(0), operand(1), subtract,
+                               [subtract](const CkksCt &ct1,
+                                          const CkksCt &ct2) {
+                                   auto ct2_unified =
+                                       __with_scaling_factor_of(ct2, ct1);
+                                   return subtract
+                                              ? ckks::sub(ct1, ct2_unified)
+                                              : ckks::add(ct1, ct2_unified);
+                               });
+            break;
+        }
+        case StepKind::add_plain: {
+            const auto &ct = operand(0).ct;
+            result = operand(0);
+            result.ct = ckks::add_plain(
+                ct, encode_like(plain_data_[step.param], ct));
+            break;
+        }
+        case StepKind::mult_plain: {
+            const auto &ct = operand(0).ct;
+            result.ct =
+                ckks::mult_plain(ct, encode_like(plain_data_[step.param], ct));
+            break;
+        }
+        case StepKind::mult: {
+            auto ct_prod = mult_low_level(operand(0).ct, operand(1).ct);
+            result.ct = RlweCt{move(ct_prod[0]), move(ct_prod[1])};
+            result.ct.scaling_factor = ct_prod.scaling_factor;
+            result.ct2 = move(ct_prod[2]);
+            result.quadratic = true;
+            break;
+        }
+        case StepKind::relinearize:
+        case StepKind::relinearize_rescale: {
+            CkksQuadraticCt ct_quadratic;
+            ct_quadratic[0] = operand(0).ct[0];
+            ct_quadratic[1] = operand(0).ct[1];
+            ct_quadratic[2] = operand(0).ct2;
+            ct_quadratic.scaling_factor = operand(0).ct.scaling_factor;
+            result.ct = step.kind == StepKind::relinearize
+                            ? relinearize(ct_quadratic, relin_key)
+                            : relinearize_and_rescale(ct_quadratic, relin_key);
+            break;
+        }
+        case StepKind::rescale:
+            result.ct = operand(0).ct;
+            rescale_inplace(result.ct);
+            break;
+        case StepKind::upscale: {
+            const auto &ct = operand(0).ct;
+            auto scaling_factor = operand(1).ct.scaling_factor;
+            if (step.param) {
+                scaling_factor *= ct[0].modulus_vec().back();
+            }
+            result.ct = __mult_constant(ct, scaling_factor / ct.scaling_factor);
+            result.ct.scaling_factor = scaling_factor;
+            break;
+        }
+        case StepKind::drop_primes:
+            // the scaling factor is not affected by dropping primes directly
+            result.ct = operand(0).ct;
+            for (auto &poly : result.ct) {
+                poly.remove_components(step.param);
+            }
+            break;
+        case StepKind::decompose: {
+            auto additional_mod =
+                rot_key_set[step.param][0][0].modulus_vec().back();
+            result.decomposed =
+                ext_prod_decompose(operand(0).ct[1], additional_mod);
+            break;
+        }
+        case StepKind::rotate:
+            if (step.operands.size() == 2) {
+                result.ct = ckks::rotate(operand(0).ct, operand(1).decomposed,
+                                         rot_key_set[step.param]);
+            } else {
+                result.ct =
+                    ckks::rotate(operand(0).ct, rot_key_set[step.param]);
+            }
+            break;
+        }
+    };
+    auto release = [&](size_t i) { values[i] = StepValue<CkksCt>(); };
+    run(plan, eval, release);
+
+    vector<CkksCt> outputs;
+    for (auto output : plan.outputs) {
+        outputs.push_back(values[output].ct);
+    }
+    return outputs;
+}
+
+} // namespace ckks
+
+namespace bgv {
+
+size_t Circuit::plain_index(const vector<u64> &data) {
+    auto found = plain_indices_.find(data);
+    if (found != plain_indices_.end()) {
+        return found->second;
+    }
+    plain_data_.push_back(data);
+    return plain_indices_[data] = plain_data_.size() - 1;
+}
+
+Wire Circuit::add_plain(Wire wire, const vector<u64> &data) {
+    return add_node(Op::add_plain, {wire}, plain_index(data));
+}
+
+Wire Circuit::mult_plain(Wire wire, const vector<u64> &data) {
+    return add_node(Op::mult_plain, {wire}, plain_index(data));
+}
+
+vector<BgvCt> Circuit::execute(const vector<BgvCt> &inputs,
+                               const RlweKsk &relin_key) const {
+    if (inputs.size() != input_count()) {
+        throw invalid_argument("Input number mismatch.");
+    }
+    auto plan = optimize();
+
+    auto encode_like = [](const vector<u64> &data, const BgvCt &ct) {
+        return simd_encode(data, ct.plain_modulus, ct[0].dimension());
+    };
+
+    vector<StepValue<BgvCt>> values(plan.steps.size());
+    auto eval = [&](size_t i) {
+        const auto &step = plan.steps[i];
+        auto operand = [&](size_t k) -> const StepValue<BgvCt> & {
+            return values[step.operands[k]];
+        };
+        auto &result = values[i];
+        switch (step.kind) {
+        case StepKind::input:
+            result.ct = inputs[step.param];
+            break;
+        case StepKind::add:
+        case StepKind::sub: {
+            bool subtract = step.kind == StepKind::sub;
+            result = __add_sub(operand(0), operand(1), subtract,
+                               [subtract](const BgvCt &ct1, const BgvCt &ct2) {
+                                   return subtract ? bgv::sub(ct1, ct2)
+                                                   : bgv::add(ct1, ct2);
+                               });
+            break;
+        }
+        case StepKind::add_plain: {
+            const auto &ct = operand(0).ct;
+            result = operand(0);
+            result.ct = bgv::add_plain(
+                ct, encode_like(plain_data_[step.param], ct));
+            break;
+        }
+        case StepKind::mult_plain: {
+            const auto &ct = operand(0).ct;
+            result.ct =
+                bgv::mult_plain(ct, encode_like(plain_data_[step.param], ct));
+            break;
+        }
+        case StepKind::mult: {
+            auto ct_prod = mult_low_level(operand(0).ct, operand(1).ct);
+            result.ct = RlweCt{move(ct_prod[0]), move(ct_prod[1])};
+            result.ct.plain_modulus = ct_prod.plain_modulus;
+            result.ct2 = move(ct_prod[2]);
+            result.quadratic = true;
+            break;
+        }
+        case StepKind::relinearize:
+        case StepKind::relinearize_rescale: {
+            BgvQuadraticCt ct_quadratic;
+            ct_quadratic[0] = operand(0).ct[0];
+            ct_quadratic[1] = operand(0).ct[1];
+            ct_quadratic[2] = operand(0).ct2;
+            ct_quadratic.plain_modulus = operand(0).ct.plain_modulus;
+            result.ct =
+                step.kind == StepKind::relinearize
+                    ? relinearize(ct_quadratic, relin_key)
+                    : relinearize_and_mod_switch(ct_quadratic, relin_key);
+            break;
+        }
+        case StepKind::rescale:
+            result.ct = operand(0).ct;
+            mod_switch_inplace(result.ct);
+            break;
+        case StepKind::upscale:
+            // the modulus switching keeps the plaintext, hence no scaling
+            result.ct = operand(0).ct;
+            break;
+        case StepKind::drop_primes:
+            result.ct = operand(0).ct;
+            mod_switch_inplace(result.ct, step.param);
+            break;
+        default:
+            throw logic_error("Unsupported step in BGV circuit.");
+        }
+    };
+    auto release = [&](size_t i) { values[i] = StepValue<BgvCt>(); };
+    run(plan, eval, release);
+
+    vector<BgvCt> outputs;
+    for (auto output : plan.outputs) {
+        outputs.push_back(values[output].ct);
+    }
+    return outputs;
+}
+
+} // namespace bgv
+} // namespace hehub
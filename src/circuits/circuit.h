@@ -0,0 +1,217 @@
+/**
+ * @file circuit.h
+ * @brief Homomorphic circuits which are recorded lazily, optimized as a whole
+ * and executed in parallel.
+ *
+ */
+
+#pragma once
+
+#include "fhe/bgv/bgv.h"
+#include "fhe/ckks/ckks.h"
+#include <functional>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace hehub {
+
+/// @brief Handle of a value in a circuit.
+using Wire = size_t;
+
+/**
+ * @brief The scheme-independent part of a circuit, i.e. a DAG of homomorphic
+ * operations recorded by the user, which is turned into an execution plan by
+ * optimize(). The optimization includes:
+ *  - common subexpression elimination, which is done when recording,
+ *  - dead operation elimination, i.e. only the operations which the outputs
+ *    depend on are executed,
+ *  - rescaling (or modulus switching) placement by level analysis, where a
+ *    product is rescaled only before it is multiplied or rotated again or
+ *    output, so that a sum of products is rescaled once, and operands at
+ *    different levels are aligned by dropping primes,
+ *  - scaling factor tracking, where the addends of different scaling factors
+ *    are matched by multiplying one of them by a constant, e.g. a fresh
+ *    ciphertext added to a product is brought to the scaling factor of the
+ *    product instead of rescaling the product first,
+ *  - delayed relinearization, where a product is kept quadratic across
+ *    additions and is relinearized once when needed, together with its
+ *    rescaling if both are due, which merges the two divisions,
+ *  - rotation hoisting, where the rotations of one ciphertext share the
+ *    decomposition in key switching.
+ */
+class CircuitGraph {
+public:
+    enum class Op { input, add, sub, mult, add_plain, mult_plain, rotate };
+
+    struct Node {
+        Op op;
+
+        std::vector<Wire> operands;
+
+        /// The input index, the plaintext index or the rotation step.
+        size_t param = 0;
+    };
+
+    enum class StepKind {
+        input,
+        add,
+        sub,
+        add_plain,
+        mult_plain,
+        mult,
+        relinearize,
+        rescale,
+        /// Relinearize and rescale by one division, e.g. by
+        /// ckks::relinearize_and_rescale.
+        relinearize_rescale,
+        /// Multiply by the constant which brings the scaling factor to that
+        /// of the second operand, times the last prime of the first operand
+        /// if the param is 1, in which case the result is to be rescaled.
+        upscale,
+        drop_primes,
+        decompose,
+        rotate
+    };
+
+    struct Step {
+        StepKind kind;
+
+        /// The indices of the steps whose results are used.
+        std::vector<size_t> operands;
+
+        /// The input index, the plaintext index, the rotation step, or the
+        /// number of primes to drop.
+        size_t param = 0;
+    };
+
+    /// @brief An execution plan, where the steps are in topological order.
+    struct Plan {
+        std::vector<Step> steps;
+
+        /// The indices of the steps producing the outputs.
+        std::vector<size_t> outputs;
+
+        /// @brief The number of steps of the kind.
+        size_t count(StepKind kind) const;
+    };
+
+    /// @brief Add an input ciphertext, which is the next one in the inputs
+    /// when executing the circuit.
+    Wire input();
+
+    Wire add(Wire wire1, Wire wire2);
+
+    Wire sub(Wire wire1, Wire wire2);
+
+    Wire mult(Wire wire1, Wire wire2);
+
+    /// @brief Mark a wire as the next output of the circuit.
+    void output(Wire wire);
+
+    inline size_t input_count() const { return input_count_; }
+
+    inline const std::vector<Node> &nodes() const { return nodes_; }
+
+    /// @brief Create the optimized execution plan of the circuit.
+    Plan optimize() const;
+
+protected:
+    /// @brief Add a node, or return the existing node of the same operation
+    /// on the same operands.
+    Wire add_node(Op op, std::vector<Wire> operands, size_t param = 0);
+
+    /**
+     * @brief Run the steps of the plan on the task runtime, where each step is
+     * started once the steps it depends on are done.
+     * @param plan The execution plan.
+     * @param eval The function evaluating a step given its index.
+     * @param release The function freeing the result of a step given its
+     * index, which is called when the result is no longer used.
+     */
+    void run(const Plan &plan, const std::function<void(size_t)> &eval,
+             const std::function<void(size_t)> &release) const;
+
+private:
+    std::vector<Node> nodes_;
+
+    std::map<std::tuple<Op, std::vector<Wire>, size_t>, Wire> node_index_;
+
+    std::vector<Wire> outputs_;
+
+    size_t input_count_ = 0;
+};
+
+namespace ckks {
+
+/**
+ * @brief A CKKS circuit. The inputs are expected to have the same scaling
+ * factor and moduli, and the outputs are relinearized and rescaled.
+ */
+class Circuit : public CircuitGraph {
+public:
+    /// @brief Add a plaintext vector, which is encoded with the scaling
+    /// factor of the ciphertext.
+    Wire add_plain(Wire wire, const std::vector<double> &data);
+
+    /// @brief Multiply by a plaintext vector, which is encoded with the
+    /// scaling factor of the ciphertext.
+    Wire mult_plain(Wire wire, const std::vector<double> &data);
+
+    Wire rotate(Wire wire, size_t step);
+
+    /**
+     * @brief Execute the circuit.
+     * @param inputs The input ciphertexts.
+     * @param relin_key The relinearization key.
+     * @param rot_key_set Rotation key set indexed by steps, which should
+     * contain the keys for the steps in the circuit.
+     * @return The output ciphertexts.
+     */
+    std::vector<CkksCt> execute(const std::vector<CkksCt> &inputs,
+                                const RlweKsk &relin_key,
+                                const std::vector<RotKey> &rot_key_set = {})
+        const;
+
+private:
+    size_t plain_index(const std::vector<double> &data);
+
+    std::vector<std::vector<double>> plain_data_;
+
+    std::map<std::vector<double>, size_t> plain_indices_;
+};
+
+} // namespace ckks
+
+namespace bgv {
+
+/**
+ * @brief A BGV circuit, in which modulus switching takes the role of
+ * rescaling. The inputs are expected to have the same plain modulus and
+ * ciphertext moduli.
+ */
+class Circuit : public CircuitGraph {
+public:
+    Wire add_plain(Wire wire, const std::vector<u64> &data);
+
+    Wire mult_plain(Wire wire, const std::vector<u64> &data);
+
+    /**
+     * @brief Execute the circuit.
+     * @param inputs The input ciphertexts.
+     * @param relin_key The relinearization key.
+     * @return The output ciphertexts.
+     */
+    std::vector<BgvCt> execute(const std::vector<BgvCt> &inputs,
+                               const RlweKsk &relin_key) const;
+
+private:
+    size_t plain_index(const std::vector<u64> &data);
+
+    std::vector<std::vector<u64>> plain_data_;
+
+    std::map<std::vector<u64>, size_t> plain_indices_;
+};
+
+} // namespace bgv
+} // namespace hehub
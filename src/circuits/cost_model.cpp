@@ -0,0 +1,356 @@
+#include "cost_model.h"
+#include "fhe/common/mod_arith.h"
+#include "fhe/common/ntt.h"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+namespace hehub {
+
+/// Time a function by running it repeatedly for a few milliseconds after a
+/// warm-up run, returning the nanoseconds per run.
+template <typename Func> static double __time_ns(Func func) {
+    using namespace chrono;
+    func();
+    size_t repeats = 0;
+    auto start = steady_clock::now();
+    steady_clock::duration elapsed;
+    do {
+        func();
+        repeats++;
+        elapsed = steady_clock::now() - start;
+    } while (elapsed < milliseconds(5));
+    return duration<double, nano>(elapsed).count() / repeats;
+}
+
+CostCalibration CostCalibration::measure(size_t dimension) {
+    auto params = ckks::create_params(dimension, {40, 40}, 40, pow(2.0, 40));
+    const auto log_dimension = (size_t)log2(dimension);
+    const auto component_count = params.component_count;
+    const auto modulus = params.moduli[0];
+
+    CostCalibration calibration;
+    calibration.dimension = dimension;
+
+    vector<u64> values(dimension), other_values(dimension), product(dimension);
+    for (size_t i = 0; i < dimension; i++) {
+        values[i] = i % modulus;
+        other_values[i] = (modulus - 1 - i) % modulus;
+    }
+    // An NTT and an INTT are timed together to keep the values bounded.
+    calibration.ntt_ns = __time_ns([&]() {
+                             ntt_negacyclic_inplace_lazy(log_dimension, modulus,
+                                                         values.data());
+                             intt_negacyclic_inplace_lazy(
+                                 log_dimension, modulus, values.data());
+                         }) /
+                         2;
+    calibration.mul_ns = __time_ns([&]() {
+        batched_mul_mod_hybrid(modulus, dimension, values.data(),
+                               other_values.data(), product.data());
+    });
+
+    CkksSk sk(params);
+    auto relin_key = get_relin_key(sk, params.additional_mod);
+    auto ct = ckks::encrypt(
+        ckks::simd_encode(vector<double>(dimension / 2, 0.5), params), sk);
+    auto decomposed = ext_prod_decompose(ct[1], params.additional_mod);
+    auto mac_count = 2 * component_count * (component_count + 1);
+    calibration.key_mac_ns = __time_ns([&]() {
+                                 auto ct_tilde = ext_prod_montgomery(
+                                     decomposed, relin_key);
+                             }) /
+                             mac_count;
+
+    return calibration;
+}
+
+const CostCalibration &host_calibration() {
+    static const CostCalibration calibration = CostCalibration::measure();
+    return calibration;
+}
+
+string CostEstimate::to_string() const {
+    stringstream summary;
+    summary << "ntt=" << ntt_count << ", mul=" << mul_count
+            << ", key_mac=" << key_mac_count
+            << ", key_switch=" << key_switch_count
+            << ", key_bytes=" << key_bytes << ", peak_bytes=" << peak_bytes
+            << fixed << setprecision(3) << ", latency=" << latency_ns / 1e6
+            << " ms";
+    return summary.str();
+}
+
+struct CostModel::OpCost {
+    /// The counted work.
+    CostEstimate work;
+
+    u64 operand_bytes = 0;
+
+    u64 temp_bytes = 0;
+
+    u64 result_bytes = 0;
+};
+
+CostModel::CostModel(CostParams params, CostCalibration calibration)
+    : params_(params), calibration_(calibration) {
+    if (params_.dimension == 0 || params_.component_count == 0) {
+        throw invalid_argument("Empty parameters.");
+    }
+}
+
+CostModel::OpCost CostModel::op_cost(const CostOp &op) const {
+    using StepKind = CircuitGraph::StepKind;
+    if (op.level >= params_.component_count) {
+        throw invalid_argument("Too many primes dropped.");
+    }
+    const u64 L = params_.component_count - op.level;
+    const u64 comp_bytes = params_.dimension * sizeof(u64);
+    const bool bgv = params_.scheme == CostScheme::bgv;
+    const u64 ct_bytes = 2 * L * comp_bytes;
+    const u64 operand_ct_bytes = (op.quadratic ? 3 : 2) * L * comp_bytes;
+
+    OpCost cost;
+    auto &work = cost.work;
+
+    // Dropping the last d of l primes from a ciphertext in one pass, which
+    // takes INTTs of the dropped components and an NTT of the lifted remainder
+    // for each of the others, per polynomial. A remainder takes d
+    // multiplications to lift and one to subtract and divide, besides the
+    // Garner digits of d > 1 primes and the scaling of them by 1/t for BGV.
+    auto drop_primes = [&](u64 l, u64 d) {
+        work.ntt_count += 2 * l;
+        auto garner_muls = d * (d - 1) / 2 + (d - 1);
+        auto muls = (l - d) * (d + 1) + garner_muls + (bgv ? d : 0);
+        work.mul_count += 2 * muls;
+        cost.temp_bytes = max(cost.temp_bytes, comp_bytes);
+    };
+
+    // Decomposing a polynomial of L components, i.e. an INTT and the NTTs of
+    // each component modulo the other L moduli.
+    auto decompose = [&]() {
+        work.ntt_count += L + L * L;
+        return L * (L + 1) * comp_bytes;
+    };
+
+    // Multiplying the decomposition with the key and dropping the special
+    // prime, where the temporary bytes of the decomposition are given. If
+    // rescaling, the last ciphertext prime is dropped in the same division,
+    // into which the other part is added after multiplying by the special
+    // prime.
+    auto key_switch = [&](u64 decomposed_bytes, bool rescaling = false) {
+        work.key_switch_count++;
+        work.key_mac_count += 2 * L * (L + 1);
+        work.key_bytes += 2 * L * (L + 1) * comp_bytes;
+        auto ct_tilde_bytes = 2 * (L + 1) * comp_bytes;
+        if (rescaling) {
+            drop_primes(L + 1, 2);
+            work.mul_count += 2 * L;
+        } else {
+            drop_primes(L + 1, 1);
+        }
+        cost.temp_bytes += decomposed_bytes + ct_tilde_bytes;
+    };
+
+    switch (op.kind) {
+    case StepKind::input:
+        cost.result_bytes = ct_bytes;
+        break;
+    case StepKind::add:
+    case StepKind::sub:
+        cost.operand_bytes = 2 * operand_ct_bytes;
+        cost.result_bytes = operand_ct_bytes;
+        break;
+    case StepKind::add_plain:
+        // encoding and NTT of the plaintext
+        work.ntt_count += L;
+        cost.operand_bytes = operand_ct_bytes;
+        cost.temp_bytes = 2 * L * comp_bytes;
+        cost.result_bytes = operand_ct_bytes;
+        break;
+    case StepKind::mult_plain:
+        work.ntt_count += L;
+        work.mul_count += 2 * L;
+        cost.operand_bytes = ct_bytes;
+        cost.temp_bytes = 2 * L * comp_bytes;
+        cost.result_bytes = ct_bytes;
+        break;
+    case StepKind::mult:
+        // the tensor product reduces three sums of products per value
+        work.mul_count += 3 * L;
+        cost.operand_bytes = 2 * ct_bytes;
+        cost.result_bytes = 3 * L * comp_bytes;
+        break;
+    case StepKind::relinearize:
+        key_switch(decompose() + L * comp_bytes);
+        cost.operand_bytes = 3 * L * comp_bytes;
+        cost.result_bytes = ct_bytes;
+        break;
+    case StepKind::relinearize_rescale:
+        if (L < 2) {
+            throw invalid_argument("Unable to drop the only one prime.");
+        }
+        key_switch(decompose() + L * comp_bytes, true);
+        cost.operand_bytes = 3 * L * comp_bytes;
+        cost.result_bytes = 2 * (L - 1) * comp_bytes;
+        break;
+    case StepKind::rescale:
+        if (L < 2) {
+            throw invalid_argument("Unable to drop the only one prime.");
+        }
+        drop_primes(L, 1);
+        cost.operand_bytes = ct_bytes;
+        cost.result_bytes = 2 * (L - 1) * comp_bytes;
+        break;
+    case StepKind::upscale:
+        // a multiplication by a constant of each component
+        work.mul_count += 2 * L;
+        cost.operand_bytes = ct_bytes;
+        cost.result_bytes = ct_bytes;
+        break;
+    case StepKind::drop_primes:
+        if (op.param >= L) {
+            throw invalid_argument("Too many primes dropped.");
+        }
+        // CKKS just removes the components, while BGV switches the moduli
+        if (bgv) {
+            drop_primes(L, op.param);
+        }
+        cost.operand_bytes = ct_bytes;
+        cost.result_bytes = 2 * (L - op.param) * comp_bytes;
+        break;
+    case StepKind::decompose:
+        cost.temp_bytes = L * comp_bytes;
+        cost.result_bytes = decompose();
+        cost.operand_bytes = ct_bytes;
+        break;
+    case StepKind::rotate:
+        // the automorphisms only permute the values
+        if (op.hoisted) {
+            cost.operand_bytes = ct_bytes + L * (L + 1) * comp_bytes;
+            key_switch(L * (L + 1) * comp_bytes);
+        } else {
+            cost.operand_bytes = ct_bytes;
+            key_switch(ct_bytes + decompose() + L * comp_bytes);
+        }
+        cost.result_bytes = ct_bytes;
+        break;
+    }
+    work.peak_bytes = cost.operand_bytes + cost.temp_bytes + cost.result_bytes;
+    fill_latency(work);
+    return cost;
+}
+
+void CostModel::fill_latency(CostEstimate &estimate) const {
+    const auto dimension = (double)params_.dimension;
+    const auto calibrated_dimension = (double)calibration_.dimension;
+    const auto linear_scale = dimension / calibrated_dimension;
+    const auto ntt_scale =
+        linear_scale * log2(dimension) / log2(calibrated_dimension);
+    estimate.latency_ns =
+        estimate.ntt_count * calibration_.ntt_ns * ntt_scale +
+        estimate.mul_count * calibration_.mul_ns * linear_scale +
+        estimate.key_mac_count * calibration_.key_mac_ns * linear_scale;
+}
+
+/// Add the counts of some work, leaving the peak bytes to the caller.
+static void __add_work(CostEstimate &total, const CostEstimate &work) {
+    total.ntt_count += work.ntt_count;
+    total.mul_count += work.mul_count;
+    total.key_mac_count += work.key_mac_count;
+    total.key_switch_count += work.key_switch_count;
+    total.key_bytes += work.key_bytes;
+    total.latency_ns += work.latency_ns;
+}
+
+CostEstimate CostModel::estimate(const CostOp &op) const {
+    return op_cost(op).work;
+}
+
+CostEstimate CostModel::estimate(const vector<CostOp> &ops) const {
+    CostEstimate total;
+    for (auto &op : ops) {
+        auto work = op_cost(op).work;
+        __add_work(total, work);
+        total.peak_bytes = max(total.peak_bytes, work.peak_bytes);
+    }
+    return total;
+}
+
+CostEstimate CostModel::estimate(const CircuitGraph::Plan &plan) const {
+    using StepKind = CircuitGraph::StepKind;
+    const auto step_count = plan.steps.size();
+
+    // The steps are run in order, where a result is freed after its last use
+    // as CircuitGraph::run() does on one thread.
+    vector<size_t> uses(step_count, 0);
+    for (auto &step : plan.steps) {
+        for (auto operand : step.operands) {
+            uses[operand]++;
+        }
+    }
+    for (auto output : plan.outputs) {
+        uses[output]++;
+    }
+
+    vector<size_t> levels(step_count, 0);
+    vector<bool> quadratic(step_count, false);
+    vector<u64> result_bytes(step_count, 0);
+    u64 live_bytes = 0;
+    CostEstimate total;
+    for (size_t i = 0; i < step_count; i++) {
+        const auto &step = plan.steps[i];
+        CostOp op{step.kind};
+        if (!step.operands.empty()) {
+            op.level = levels[step.operands[0]];
+            op.quadratic = quadratic[step.operands[0]];
+        }
+        switch (step.kind) {
+        case StepKind::add:
+        case StepKind::sub:
+            op.quadratic = op.quadratic || quadratic[step.operands[1]];
+            break;
+        case StepKind::drop_primes:
+            op.param = step.param;
+            break;
+        case StepKind::rotate:
+            op.hoisted = step.operands.size() == 2;
+            break;
+        default:
+            break;
+        }
+
+        auto cost = op_cost(op);
+        __add_work(total, cost.work);
+        total.peak_bytes =
+            max(total.peak_bytes,
+                live_bytes + cost.temp_bytes + cost.result_bytes);
+
+        levels[i] = op.level;
+        if (step.kind == StepKind::rescale ||
+            step.kind == StepKind::relinearize_rescale) {
+            levels[i] += 1;
+        } else if (step.kind == StepKind::drop_primes) {
+            levels[i] += step.param;
+        }
+        quadratic[i] = step.kind == StepKind::mult ||
+                       (op.quadratic && step.kind != StepKind::relinearize &&
+                        step.kind != StepKind::relinearize_rescale);
+        result_bytes[i] = cost.result_bytes;
+        live_bytes += cost.result_bytes;
+        for (auto operand : step.operands) {
+            if (--uses[operand] == 0) {
+                live_bytes -= result_bytes[operand];
+            }
+        }
+        if (uses[i] == 0) {
+            live_bytes -= result_bytes[i];
+        }
+    }
+    return total;
+}
+
+} // namespace hehub
@@ -0,0 +1,158 @@
+/**
+ * @file cost_model.h
+ * @brief Static cost estimation of homomorphic circuits, which predicts the
+ * work and memory of a circuit or a sequence of operations without running
+ * them, and its latency from a calibration of the kernels on this host.
+ *
+ */
+
+#pragma once
+
+#include "circuit.h"
+#include <string>
+#include <vector>
+
+namespace hehub {
+
+/// @brief The scheme of the estimated operations, which matters only for
+/// dropping primes, i.e. CKKS drops them for free while BGV switches moduli.
+enum class CostScheme { ckks, bgv };
+
+/// @brief The parameters which the costs depend on.
+struct CostParams {
+    size_t dimension;
+
+    /// The number of ciphertext primes of the inputs.
+    size_t component_count;
+
+    CostScheme scheme = CostScheme::ckks;
+};
+
+/// @brief An operation in a sequence, which is run on a ciphertext with some
+/// primes dropped from the inputs.
+struct CostOp {
+    CircuitGraph::StepKind kind;
+
+    /// The number of primes dropped.
+    size_t level = 0;
+
+    /// The number of primes to drop if the kind is drop_primes.
+    size_t param = 0;
+
+    /// Whether the operand is quadratic, i.e. an unrelinearized product.
+    bool quadratic = false;
+
+    /// Whether a rotation uses a decomposition shared with other rotations,
+    /// which is computed by a decompose operation.
+    bool hoisted = false;
+};
+
+/**
+ * @brief The time of the kernels which the costs are made of, measured at one
+ * dimension and scaled to the others, i.e. by N log N for the NTT and by N for
+ * the others.
+ */
+struct CostCalibration {
+    size_t dimension = 0;
+
+    /// Nanoseconds of an NTT or INTT of one component.
+    double ntt_ns = 0;
+
+    /// Nanoseconds of a pointwise modular multiplication of two components.
+    double mul_ns = 0;
+
+    /// Nanoseconds of multiplying and accumulating one component of a key
+    /// switching key, i.e. the inner loop of ext_prod_montgomery.
+    double key_mac_ns = 0;
+
+    /**
+     * @brief Measure the kernels on this host by a micro-benchmark, which
+     * takes a few tens of milliseconds. The key switching is run on the task
+     * runtime, hence one thread should be set for the sequential latency.
+     * @param dimension The dimension to measure at.
+     */
+    static CostCalibration measure(size_t dimension = 4096);
+};
+
+/// @brief The calibration measured at the first call, which is shared by the
+/// cost models created later.
+const CostCalibration &host_calibration();
+
+/// @brief The predicted costs of a piece of work.
+struct CostEstimate {
+    /// NTTs and INTTs of one component each.
+    u64 ntt_count = 0;
+
+    /// Pointwise modular multiplications of two components, excluding those
+    /// with the keys in key switching.
+    u64 mul_count = 0;
+
+    /// Multiply-accumulations of a decomposed component with a key component
+    /// in key switching.
+    u64 key_mac_count = 0;
+
+    /// Multiplications of a decomposed polynomial with a key switching key.
+    u64 key_switch_count = 0;
+
+    /// Bytes of the key switching keys read, counted once per key switching.
+    u64 key_bytes = 0;
+
+    /// Bytes of the ciphertexts and temporaries alive at the same time at
+    /// most, excluding the keys.
+    u64 peak_bytes = 0;
+
+    /// Nanoseconds of running the work sequentially.
+    double latency_ns = 0;
+
+    /// @brief A one-line summary for logging.
+    std::string to_string() const;
+};
+
+/**
+ * @brief Estimate the costs of the operations following their implementations
+ * in this library, where e.g. a relinearization costs an INTT and L NTTs of
+ * each of the L components for the decomposition, 2L(L+1) component MACs with
+ * the key and the division by the special prime, which also drops the last
+ * ciphertext prime if rescaling in the same step.
+ */
+class CostModel {
+public:
+    explicit CostModel(CostParams params,
+                       CostCalibration calibration = host_calibration());
+
+    /// @brief The costs of one operation, where the peak bytes are those of
+    /// its operands, result and temporaries.
+    CostEstimate estimate(const CostOp &op) const;
+
+    /// @brief The costs of running the operations one after another, where
+    /// the peak bytes are the maximum among the operations.
+    CostEstimate estimate(const std::vector<CostOp> &ops) const;
+
+    /// @brief The costs of running an execution plan, where the peak bytes
+    /// follow the results kept alive until their last uses.
+    CostEstimate estimate(const CircuitGraph::Plan &plan) const;
+
+    /// @brief The costs of running the optimized plan of a recorded circuit.
+    inline CostEstimate estimate(const CircuitGraph &circuit) const {
+        return estimate(circuit.optimize());
+    }
+
+    inline const CostParams &params() const { return params_; }
+
+    inline const CostCalibration &calibration() const { return calibration_; }
+
+private:
+    /// The costs of an operation and the bytes it works on.
+    struct OpCost;
+
+    OpCost op_cost(const CostOp &op) const;
+
+    /// @brief Set the latency from the counted kernels.
+    void fill_latency(CostEstimate &estimate) const;
+
+    CostParams params_;
+
+    CostCalibration calibration_;
+};
+
+} // namespace hehub
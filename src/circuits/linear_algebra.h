@@ -8,6 +8,7 @@
 
 #include "fhe/ckks/ckks.h"
 #include "fhe/common/ntt.h"
+#include "fhe/common/task_runtime.h"
 #include "fhe/primitives/keys.h"
 #include "range/v3/view/iota.hpp"
 #include <vector>
@@ -97,35 +98,59 @@ CkksCt matrix_vector_mul_short(const std::vector<std::vector<T>> &mat,
         }
     }
 
-    auto ct_vec_rotating(ct_vec);
-    CkksCt ct_accumulated;
     CkksParams params = ct_vec[0].params();
     params.initial_scaling_factor = ct_vec.scaling_factor;
-    for (auto i : ranges::views::ints((size_t)0, matrix_width)) {
+    auto mult_diag = [&](size_t i, const CkksCt &ct_vec_rotated) {
         std::vector<T> curr_diag(slot_count, (T)0);
         for (auto j : ranges::views::ints((size_t)0, matrix_height)) {
             curr_diag[j] = mat[j][(j + matrix_width - i) % matrix_width];
         }
         auto encoded_diag = simd_encode(curr_diag, params);
+        return mult_plain(ct_vec_rotated, encoded_diag);
+    };
 
-        auto ct_prod_diag_vec = mult_plain(ct_vec_rotating, encoded_diag);
-
-        if (i == 0) {
-            ct_accumulated = std::move(ct_prod_diag_vec);
+    // The diagonals are processed in batches as many as the threads, so that
+    // only a few intermediate ciphertexts are kept at the same time.
+    const auto batch_size = get_thread_count();
+    auto ct_vec_rotating(ct_vec);
+    CkksCt ct_accumulated;
+    for (size_t batch_begin = 0; batch_begin < matrix_width;
+         batch_begin += batch_size) {
+        auto batch_end = std::min(batch_begin + batch_size, matrix_width);
+        std::vector<CkksCt> ct_prods(batch_end - batch_begin);
+        if (full_width) {
+            // Each rotation is based on the previous one, while the
+            // multiplications by diagonals are independent.
+            std::vector<CkksCt> ct_vec_rotated(batch_end - batch_begin);
+            for (auto i : ranges::views::ints(batch_begin, batch_end)) {
+                ct_vec_rotated[i - batch_begin] = ct_vec_rotating;
+                if (i != matrix_width - 1) {
+                    ct_vec_rotating = rotate(ct_vec_rotating, rot_key_set[1]);
+                }
+            }
+            parallel_for(batch_begin, batch_end, [&](size_t i) {
+                ct_prods[i - batch_begin] =
+                    mult_diag(i, ct_vec_rotated[i - batch_begin]);
+            });
         } else {
-            ct_accumulated = add(ct_accumulated, ct_prod_diag_vec);
+            parallel_for(batch_begin, batch_end, [&](size_t i) {
+                if (i == 0) {
+                    ct_prods[0] = mult_diag(0, ct_vec);
+                    return;
+                }
+                auto ct_vec_rotated = add(
+                    rotate(ct_vec, rot_key_set[i]),
+                    rotate(ct_vec, rot_key_set[i + slot_count - matrix_width]));
+                ct_prods[i - batch_begin] = mult_diag(i, ct_vec_rotated);
+            });
         }
 
-        if (i != matrix_width - 1) {
-            // update the encryted vector by rotation
-            if (full_width) {
-                ct_vec_rotating = rotate(ct_vec_rotating, rot_key_set[1]);
+        for (auto i : ranges::views::ints(batch_begin, batch_end)) {
+            if (i == 0) {
+                ct_accumulated = std::move(ct_prods[0]);
             } else {
-                auto next_step = i + 1;
-                ct_vec_rotating = add(
-                    rotate(ct_vec, rot_key_set[next_step]),
-                    rotate(ct_vec,
-                           rot_key_set[next_step + slot_count - matrix_width]));
+                ct_accumulated =
+                    add(ct_accumulated, ct_prods[i - batch_begin]);
             }
         }
     }
@@ -0,0 +1,212 @@
+#include "param_tuner.h"
+#include "fhe/common/primelists.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+
+using namespace std;
+
+namespace hehub {
+namespace ckks {
+
+/// The bits of precision lost to the rescaling errors, which grow with the
+/// square root of the dimension.
+static size_t __rescaling_error_bits(size_t log_dimension) {
+    return (log_dimension + 1) / 2 + 3;
+}
+
+/// A multiplication at each level, and the rotations at the top level which
+/// share the decomposition if more than one.
+static vector<CostOp> __default_workload(const TuningRequirements &req) {
+    using StepKind = CircuitGraph::StepKind;
+    vector<CostOp> ops;
+    for (size_t level = 0; level < req.depth; level++) {
+        ops.push_back(CostOp{StepKind::mult, level});
+        ops.push_back(CostOp{StepKind::relinearize_rescale, level, 0, true});
+    }
+    bool hoisted = req.rotation_steps.size() >= 2;
+    if (hoisted) {
+        ops.push_back(CostOp{StepKind::decompose});
+    }
+    for (size_t i = 0; i < req.rotation_steps.size(); i++) {
+        ops.push_back(CostOp{StepKind::rotate, 0, 0, false, hoisted});
+    }
+    return ops;
+}
+
+/// Run the workload on the parameters, returning the nanoseconds taken
+/// excluding the key generation.
+static double __benchmark(const CkksParams &params,
+                          const TuningRequirements &req) {
+    CkksSk sk(params);
+    auto relin_key = get_relin_key(sk, params.additional_mod);
+    vector<RotKey> rot_keys;
+    for (auto step : req.rotation_steps) {
+        rot_keys.resize(max(rot_keys.size(), step + 1));
+        rot_keys[step] = get_rot_key(sk, params.additional_mod, step);
+    }
+    vector<double> data(params.dimension / 2, 0.5);
+    auto ct = encrypt(simd_encode(data, params), sk);
+
+    auto start = chrono::steady_clock::now();
+    if (req.circuit) {
+        vector<CkksCt> inputs(req.circuit->input_count(), ct);
+        auto outputs = req.circuit->execute(inputs, relin_key, rot_keys);
+    } else {
+        auto ct_prod = ct;
+        for (size_t level = 0; level < req.depth; level++) {
+            ct_prod = mult_and_rescale(ct_prod, ct_prod, relin_key);
+        }
+        if (req.rotation_steps.size() >= 2) {
+            vector<reference_wrapper<const RotKey>> keys;
+            for (auto step : req.rotation_steps) {
+                keys.push_back(cref(rot_keys[step]));
+            }
+            auto ct_rotated = rotate_hoisted(ct, keys);
+        } else if (req.rotation_steps.size() == 1) {
+            auto ct_rotated = rotate(ct, rot_keys[req.rotation_steps[0]]);
+        }
+    }
+    auto elapsed = chrono::steady_clock::now() - start;
+    return chrono::duration<double, nano>(elapsed).count();
+}
+
+vector<TunedParams> tuning_candidates(const TuningRequirements &req) {
+    const size_t min_prime_bits = 27;
+    const size_t max_prime_bits = prime_lists.size() - 1;
+    const size_t max_base_primes = 3;
+    auto workload = __default_workload(req);
+
+    vector<TunedParams> candidates;
+    for (size_t log_dimension = 10; log_dimension <= 15; log_dimension++) {
+        const size_t dimension = 1ULL << log_dimension;
+        if (dimension / 2 < req.slot_count) {
+            continue;
+        }
+        if (any_of(req.rotation_steps.begin(), req.rotation_steps.end(),
+                   [&](size_t step) { return step >= dimension / 2; })) {
+            continue;
+        }
+        const auto budget_bits = max_modulus_bits(dimension, req.security);
+
+        // The costs depend on the number of primes only, hence are shared by
+        // the chains with the same number.
+        map<size_t, CostEstimate> estimates;
+        auto estimate = [&](size_t component_count) {
+            auto found = estimates.find(component_count);
+            if (found != estimates.end()) {
+                return found->second;
+            }
+            CostModel model(CostParams{dimension, component_count});
+            return estimates[component_count] =
+                       req.circuit ? model.estimate(*req.circuit)
+                                   : model.estimate(workload);
+        };
+
+        auto min_scaling_bits =
+            max(req.precision_bits + __rescaling_error_bits(log_dimension),
+                min_prime_bits);
+        for (auto scaling_bits = min_scaling_bits;
+             scaling_bits <= max_prime_bits; scaling_bits++) {
+            auto base_bits = scaling_bits + req.integer_bits;
+            for (size_t base_primes = 1; base_primes <= max_base_primes;
+                 base_primes++) {
+                auto base_prime_bits =
+                    (base_bits + base_primes - 1) / base_primes;
+                if (base_prime_bits < min_prime_bits ||
+                    base_prime_bits > max_prime_bits) {
+                    continue;
+                }
+                // The special prime is at least as large as the ciphertext
+                // primes, which bounds the noise of key switching.
+                for (auto special_bits = max(base_prime_bits, scaling_bits);
+                     special_bits <= max_prime_bits; special_bits++) {
+                    auto total_bits = base_primes * base_prime_bits +
+                                      req.depth * scaling_bits + special_bits;
+                    if (total_bits > budget_bits) {
+                        break;
+                    }
+                    map<size_t, size_t> primes_needed;
+                    primes_needed[base_prime_bits] += base_primes;
+                    primes_needed[scaling_bits] += req.depth;
+                    primes_needed[special_bits]++;
+                    if (any_of(primes_needed.begin(), primes_needed.end(),
+                               [](const pair<const size_t, size_t> &need) {
+                                   return prime_lists[need.first].size() <
+                                          need.second;
+                               })) {
+                        continue;
+                    }
+
+                    vector<size_t> moduli_bits(base_primes + req.depth,
+                                               scaling_bits);
+                    fill_n(moduli_bits.begin(), base_primes, base_prime_bits);
+                    TunedParams candidate;
+                    candidate.params =
+                        create_params(dimension, moduli_bits, special_bits,
+                                      pow(2.0, scaling_bits));
+                    candidate.scaling_bits = scaling_bits;
+                    candidate.modulus_bits = total_bits;
+                    candidate.estimate = estimate(moduli_bits.size());
+                    candidates.push_back(move(candidate));
+                }
+            }
+        }
+    }
+    return candidates;
+}
+
+/// Whether a candidate is preferred, i.e. it is faster by the given latency,
+/// or as fast and leaves more of the security margin.
+template <typename Latency>
+static bool __preferred(const TunedParams &a, const TunedParams &b,
+                        Latency latency) {
+    if (latency(a) != latency(b)) {
+        return latency(a) < latency(b);
+    }
+    return a.modulus_bits < b.modulus_bits;
+}
+
+TunedParams tune_params(const TuningRequirements &req) {
+    auto candidates = tuning_candidates(req);
+    if (candidates.empty()) {
+        throw invalid_argument("No parameters meet the requirements.");
+    }
+    auto estimated_ns = [](const TunedParams &candidate) {
+        return candidate.estimate.latency_ns;
+    };
+    if (req.benchmark) {
+        // The chains of the same dimension and number of primes share the
+        // estimate, hence only the one with the fewest bits is run for each.
+        map<pair<size_t, size_t>, TunedParams> shapes;
+        for (auto &candidate : candidates) {
+            auto key = make_pair(candidate.params.dimension,
+                                 candidate.params.component_count);
+            auto found = shapes.find(key);
+            if (found == shapes.end() ||
+                __preferred(candidate, found->second, estimated_ns)) {
+                shapes[key] = candidate;
+            }
+        }
+        vector<TunedParams> benchmarked;
+        for (auto &[key, candidate] : shapes) {
+            candidate.measured_ns = __benchmark(candidate.params, req);
+            benchmarked.push_back(candidate);
+        }
+        return *min_element(
+            benchmarked.begin(), benchmarked.end(),
+            [](const TunedParams &a, const TunedParams &b) {
+                return __preferred(a, b, [](const TunedParams &candidate) {
+                    return candidate.measured_ns;
+                });
+            });
+    }
+    return *min_element(candidates.begin(), candidates.end(),
+                        [&](const TunedParams &a, const TunedParams &b) {
+                            return __preferred(a, b, estimated_ns);
+                        });
+}
+
+} // namespace ckks
+} // namespace hehub
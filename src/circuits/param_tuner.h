@@ -0,0 +1,90 @@
+/**
+ * @file param_tuner.h
+ * @brief Choosing CKKS parameters for a computation, i.e. the smallest
+ * latency among the parameters which are secure and precise enough.
+ *
+ */
+
+#pragma once
+
+#include "cost_model.h"
+#include <vector>
+
+namespace hehub {
+namespace ckks {
+
+/// @brief What the parameters are required to support.
+struct TuningRequirements {
+    /// The multiplicative depth, i.e. the number of rescalings.
+    size_t depth;
+
+    /// The bits of precision required of the results after the rescalings.
+    size_t precision_bits;
+
+    /// The bits of the integral part of the values, i.e. the values should
+    /// be less than 2^integer_bits in magnitude.
+    size_t integer_bits = 10;
+
+    SecurityLevel security = SecurityLevel::classical_128;
+
+    /// The rotation steps used, which are also counted in the default
+    /// workload.
+    std::vector<size_t> rotation_steps;
+
+    /// The minimum number of slots.
+    size_t slot_count = 0;
+
+    /// The circuit whose latency is minimized. If null, the workload is a
+    /// multiplication at each level and the rotations at the top level.
+    const Circuit *circuit = nullptr;
+
+    /// Whether to rank the candidates by running the workload, instead of by
+    /// the cost model.
+    bool benchmark = false;
+};
+
+/// @brief A set of parameters and its costs on the workload.
+struct TunedParams {
+    CkksParams params;
+
+    /// The bits of the rescaling primes, which is also that of the initial
+    /// scaling factor.
+    size_t scaling_bits;
+
+    /// The total bits of the moduli, including the additional one.
+    size_t modulus_bits;
+
+    /// The estimated costs of the workload.
+    CostEstimate estimate;
+
+    /// The measured nanoseconds of the workload if benchmarked, otherwise 0.
+    double measured_ns = 0;
+};
+
+/**
+ * @brief Enumerate the modulus chains meeting the requirements for each
+ * dimension, which consist of depth rescaling primes of at least the precision
+ * bits and a margin for the rescaling errors, a base modulus of one to three
+ * primes which adds the integral bits, and a special prime at least as large
+ * as the others. The sizes of the rescaling and the special primes range up to
+ * the largest primes in the library, within the modulus bound of the security
+ * level. As the key switching decomposes by prime with one special prime, dnum
+ * is always the number of ciphertext primes.
+ * @param requirements The requirements.
+ * @return The candidates with their estimated costs, in ascending dimensions.
+ */
+std::vector<TunedParams> tuning_candidates(
+    const TuningRequirements &requirements);
+
+/**
+ * @brief Choose the parameters with the smallest latency on the workload
+ * among the candidates, and the fewest modulus bits among equally fast ones.
+ * If benchmarking, one chain with the fewest bits is run for each dimension
+ * and number of primes.
+ * @param requirements The requirements.
+ * @return The chosen parameters.
+ */
+TunedParams tune_params(const TuningRequirements &requirements);
+
+} // namespace ckks
+} // namespace hehub
@@ -1,11 +1,13 @@
 #include "bgv.h"
 #include "fhe/common/ntt.h"
 #include "fhe/common/rns_transform.h"
+#include "fhe/common/tracing.h"
 
 namespace hehub {
 namespace bgv {
 
 BgvCt add(const BgvCt &ct1, const BgvCt &ct2) {
+    HEHUB_TRACE_SPAN("bgv::add");
     if (ct1.plain_modulus != ct2.plain_modulus) {
         throw std::invalid_argument("Plain moduli mismatch.");
     }
@@ -15,6 +17,7 @@ BgvCt add(const BgvCt &ct1, const BgvCt &ct2) {
 }
 
 BgvCt add_plain(const BgvCt &ct, const BgvPt &pt) {
+    HEHUB_TRACE_SPAN("bgv::add_plain");
     if (pt.component_count() != 1 || pt.modulus_at(0) != ct.plain_modulus) {
         throw std::invalid_argument("plain moduli mismatch.");
     }
@@ -26,6 +29,7 @@ BgvCt add_plain(const BgvCt &ct, const BgvPt &pt) {
 }
 
 BgvCt sub(const BgvCt &ct1, const BgvCt &ct2) {
+    HEHUB_TRACE_SPAN("bgv::sub");
     if (ct1.plain_modulus != ct2.plain_modulus) {
         throw std::invalid_argument("Plain moduli mismatch.");
     }
@@ -35,6 +39,7 @@ BgvCt sub(const BgvCt &ct1, const BgvCt &ct2) {
 }
 
 BgvCt sub_plain(const BgvCt &ct, const BgvPt &pt) {
+    HEHUB_TRACE_SPAN("bgv::sub_plain");
     if (pt.component_count() != 1 || pt.modulus_at(0) != ct.plain_modulus) {
         throw std::invalid_argument("plain moduli mismatch.");
     }
@@ -46,6 +51,7 @@ BgvCt sub_plain(const BgvCt &ct, const BgvPt &pt) {
 }
 
 BgvCt mult_plain(const BgvCt &ct, const BgvPt &pt) {
+    HEHUB_TRACE_SPAN("bgv::mult_plain");
     if (pt.component_count() != 1 || pt.modulus_at(0) != ct.plain_modulus) {
         throw std::invalid_argument("plain moduli mismatch.");
     }
@@ -56,21 +62,79 @@ BgvCt mult_plain(const BgvCt &ct, const BgvPt &pt) {
     return prod_ct;
 }
 
+BgvCt linear_combination(const std::vector<BgvCt> &cts,
+                         const std::vector<u64> &weights) {
+    HEHUB_TRACE_SPAN("bgv::linear_combination");
+    if (cts.size() != weights.size()) {
+        throw std::invalid_argument(
+            "Numbers of the ciphertexts and the weights mismatch.");
+    }
+    if (cts.empty()) {
+        throw std::invalid_argument("No ciphertexts to combine.");
+    }
+    const auto plain_modulus = cts[0].plain_modulus;
+    for (auto &ct : cts) {
+        if (ct.plain_modulus != plain_modulus) {
+            throw std::invalid_argument("Plain moduli mismatch.");
+        }
+    }
+    const auto &moduli = cts[0][0].modulus_vec();
+    const auto component_count = moduli.size();
+
+    // the weights centered modulo t
+    std::vector<u64> rns_weights(cts.size() * component_count);
+    for (size_t j = 0; j < cts.size(); j++) {
+        const auto weight = weights[j] % plain_modulus;
+        const bool negative = weight > plain_modulus / 2;
+        const auto magnitude = negative ? plain_modulus - weight : weight;
+        for (size_t k = 0; k < component_count; k++) {
+            auto reduced = magnitude % moduli[k];
+            rns_weights[j * component_count + k] =
+                (negative && reduced) ? moduli[k] - reduced : reduced;
+        }
+    }
+
+    std::vector<std::reference_wrapper<const RlweCt>> ct_refs(cts.begin(),
+                                                              cts.end());
+    BgvCt result = linear_combination_core(ct_refs, rns_weights);
+    result.plain_modulus = plain_modulus;
+    return result;
+}
+
+void CtAccumulator::add(const BgvCt &ct) {
+    HEHUB_TRACE_SPAN("bgv::CtAccumulator::add");
+    if (count() == 0) {
+        plain_modulus_ = ct.plain_modulus;
+    } else if (ct.plain_modulus != plain_modulus_) {
+        throw std::invalid_argument("Plain moduli mismatch.");
+    }
+    sum_.add(ct);
+}
+
+BgvCt CtAccumulator::result() const {
+    BgvCt sum_ct = sum_.result();
+    sum_ct.plain_modulus = plain_modulus_;
+    return sum_ct;
+}
+
 BgvQuadraticCt mult_low_level(const BgvCt &ct1, const BgvCt &ct2) {
+    HEHUB_TRACE_SPAN("bgv::mult");
     if (ct1.plain_modulus != ct2.plain_modulus) {
         throw std::invalid_argument("Plain moduli mismatch.");
     }
     BgvQuadraticCt prod_ct;
-    prod_ct[0] = ct1[0] * ct2[0];
-    prod_ct[1] = ct1[0] * ct2[1] + ct1[1] * ct2[0];
-    prod_ct[2] = ct1[1] * ct2[1];
+    tensor_product(ct1, ct2, prod_ct);
     prod_ct.plain_modulus = ct1.plain_modulus;
     return prod_ct;
 }
 
 BgvCt relinearize(const BgvQuadraticCt &ct, const RlweKsk &relin_key) {
+    HEHUB_TRACE_SPAN("bgv::relinearize");
     BgvCt ct_new = ext_prod_montgomery(ct[2], relin_key);
-    mod_switch_inplace(ct_new);
+    {
+        HEHUB_TRACE_SPAN("ModDown");
+        mod_switch_inplace(ct_new);
+    }
 
     ct_new[0] += ct[0];
     ct_new[1] += ct[1];
@@ -2,14 +2,52 @@
 #include "fhe/common/mod_arith.h"
 #include "fhe/common/ntt.h"
 #include "fhe/common/rns_transform.h"
+#include "fhe/common/tracing.h"
 #include <algorithm>
 #include <cmath>
 
 namespace hehub {
 namespace bgv {
 
+/// Pack the data into the slots of a plaintext on the words of a type, and
+/// transform it into coeff form, skipping the butterflies of the unused slots.
+template <typename Word>
+static BasicRnsPolynomial<Word> __pack_slots(const std::vector<u64> &data,
+                                             const RnsPolyParams &params) {
+    BasicRnsPolynomial<Word> pt(params);
+    pt.rep_form = PolyRepForm::value;
+    auto &pt_poly = pt[0];
+    std::copy(data.begin(), data.end(), pt_poly.data());
+    std::fill(pt_poly.begin() + data.size(), pt_poly.end(), 0);
+
+    const auto data_size = data.size();
+    if (data_size > 0 && data_size < pt.dimension()) {
+        intt_negacyclic_inplace_lazy_sparse(pt.log_dimension(),
+                                            (Word)pt.modulus_at(0),
+                                            pt_poly.data(), data_size);
+        pt.rep_form = PolyRepForm::coeff;
+    } else {
+        intt_negacyclic_inplace_lazy(pt);
+    }
+    return pt;
+}
+
+/// The values of the first value_count slots of a plaintext on the words of a
+/// type, which is transformed in place.
+template <typename Word>
+static std::vector<u64> __unpack_slots(BasicRnsPolynomial<Word> &pt,
+                                       const size_t value_count) {
+    const Word modulus = pt.modulus_at(0);
+    auto values = pt[0].data();
+    ntt_negacyclic_inplace_lazy_truncated(pt.log_dimension(), modulus, values,
+                                          0, value_count);
+    batched_reduce_strict(modulus, value_count, values);
+    return std::vector<u64>(values, values + value_count);
+}
+
 RlwePt simd_encode(const std::vector<u64> &data, const u64 modulus,
                    size_t slot_count) {
+    HEHUB_TRACE_SPAN("bgv::encode");
     for (auto datum : data) {
         if (datum >= modulus) {
             throw std::invalid_argument(
@@ -28,20 +66,17 @@ RlwePt simd_encode(const std::vector<u64> &data, const u64 modulus,
                                     std::to_string(slot_count) + " slots.");
     }
 
-    // Pack the data into plaintext slots.
-    RlwePt pt(RnsPolyParams{slot_count, 1, std::vector<u64>{modulus}});
-    pt.rep_form = PolyRepForm::value;
-    auto &pt_poly = pt[0];
-    std::copy(data.begin(), data.end(), pt_poly.data());
-    std::fill(pt_poly.begin() + data_size, pt_poly.end(), 0);
-
-    // Transform the plaintext into coeff form which is required by encryption.
-    intt_negacyclic_inplace_lazy(pt);
-
-    return pt;
+    // The plaintext moduli are usually small, whose slots are transformed on
+    // 32-bit words, and then widened for the encryption.
+    RnsPolyParams params{slot_count, 1, std::vector<u64>{modulus}};
+    if (moduli_fit_words<u32>(params)) {
+        return RlwePt(__pack_slots<u32>(data, params));
+    }
+    return __pack_slots<u64>(data, params);
 }
 
 std::vector<u64> simd_decode(const RlwePt &pt, size_t data_size) {
+    HEHUB_TRACE_SPAN("bgv::decode");
     if (data_size == 0) {
         data_size = pt.dimension();
     }
@@ -51,10 +86,16 @@ std::vector<u64> simd_decode(const RlwePt &pt, size_t data_size) {
                                     "Use big int version of decoding.");
     }
 
-    auto pt_copy(pt);
-    ntt_negacyclic_inplace_lazy(pt_copy);
-    reduce_strict(pt_copy);
-    std::vector<u64> data(pt_copy[0].begin(), pt_copy[0].end());
+    // only the values of the first data_size slots are computed
+    const auto value_count = std::min(data_size, pt.dimension());
+    std::vector<u64> data;
+    if (moduli_fit_words<u32>(pt.params())) {
+        RnsPolynomial32 pt_narrowed(pt);
+        data = __unpack_slots(pt_narrowed, value_count);
+    } else {
+        auto pt_copy(pt);
+        data = __unpack_slots(pt_copy, value_count);
+    }
     data.resize(data_size);
 
     return data;
@@ -79,6 +120,7 @@ RlweCt get_rlwe_sample_lift_noise(const RlweSk &sk, const u64 lifting_factor,
 
 BgvCt encrypt(const RlwePt &pt, const RlweSk &rlwe_sk,
               std::vector<u64> ct_moduli) {
+    HEHUB_TRACE_SPAN("bgv::encrypt");
     auto pt_modulus = pt.modulus_at(0);
 
     if (ct_moduli.empty()) {
@@ -106,9 +148,10 @@ BgvCt encrypt(const RlwePt &pt, const RlweSk &rlwe_sk,
 }
 
 BgvPt decrypt(const BgvCt &ct, const RlweSk &rlwe_sk) {
-    // Apply RLWE decryption, obtaining the plaintext under ciphertext moduli
-    // (and in coefficient form).
-    auto pt_under_ct_mod = hehub::decrypt_core(ct, rlwe_sk);
+    HEHUB_TRACE_SPAN("bgv::decrypt");
+    // Apply RLWE decryption, obtaining the plaintext under the first or all of
+    // the ciphertext moduli (and in coefficient form).
+    auto pt_under_ct_mod = hehub::decrypt_core_minimal(ct, rlwe_sk);
 
     // Migrate the decrypted plaintext back to under original modulus
     auto pt =
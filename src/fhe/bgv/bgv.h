@@ -5,6 +5,7 @@
  */
 
 #pragma once
+#include "fhe/common/task_runtime.h"
 #include "fhe/primitives/keys.h"
 #include "fhe/primitives/rlwe.h"
 
@@ -87,11 +88,11 @@ BgvCt encrypt(const BgvPt &pt, const RlweSk &rlwe_sk,
               std::vector<u64> ct_moduli = std::vector<u64>{});
 
 /**
- * @brief TODO
- *
- * @param ct
- * @param rlwe_sk
- * @return BgvPt
+ * @brief Decrypt a ciphertext, with its first prime alone if the plaintext
+ * plus the noise fits in it, and otherwise with all of its primes.
+ * @param ct The ciphertext.
+ * @param rlwe_sk The secret key.
+ * @return BgvPt The plaintext modulo the plain modulus.
  */
 BgvPt decrypt(const BgvCt &ct, const RlweSk &rlwe_sk);
 
@@ -140,6 +141,40 @@ BgvCt sub_plain(const BgvCt &ct, const BgvPt &pt);
  */
 BgvCt mult_plain(const BgvCt &ct, const BgvPt &pt);
 
+/**
+ * @brief Compute the linear combination sum_j w_j * ct_j of ciphertexts with
+ * integral weights modulo t, which is one sweep over the ciphertexts instead of
+ * a mult_plain and an add for each of them. The weights are centered modulo
+ * t, which bounds the noise growth by t / 2 per ciphertext.
+ * @param cts The ciphertexts, which have the same primes and plain modulus.
+ * @param weights The weights, one for each ciphertext.
+ * @return BgvCt
+ */
+BgvCt linear_combination(const std::vector<BgvCt> &cts,
+                         const std::vector<u64> &weights);
+
+/**
+ * @brief An accumulator summing many ciphertexts of the same plain modulus
+ * lazily, which is much cheaper than a chain of add for a large sum.
+ */
+class CtAccumulator {
+public:
+    /// @brief Add a ciphertext, whose plain modulus should be that of the
+    /// ones added before.
+    void add(const BgvCt &ct);
+
+    /// @brief The sum of the ciphertexts added.
+    BgvCt result() const;
+
+    /// @brief The number of the ciphertexts added.
+    inline size_t count() const { return sum_.count(); }
+
+private:
+    hehub::CtAccumulator sum_;
+
+    u64 plain_modulus_ = 0;
+};
+
 /**
  * @brief TODO
  *
@@ -159,13 +194,66 @@ BgvQuadraticCt mult_low_level(const BgvCt &ct1, const BgvCt &ct2);
 BgvCt relinearize(const BgvQuadraticCt &ct, const RlweKsk &relin_key);
 
 /**
- * @brief TODO
- *
- * @param ct
- * @param dropping_primes
+ * @brief Switch a ciphertext to a smaller modulus by dropping its last primes,
+ * keeping the plaintext, where several primes are dropped in one pass.
+ * @param ct The ciphertext to switch.
+ * @param dropping_primes The number of primes to drop.
  */
 void mod_switch_inplace(BgvCt &ct, size_t dropping_primes = 1);
 
+/**
+ * @brief Relinearize a product and switch it to the modulus without its last
+ * prime, where the ModDown by the special prime and the modulus switching are
+ * one division.
+ * @param ct The product to relinearize.
+ * @param relin_key The relinearization key.
+ * @return BgvCt
+ */
+BgvCt relinearize_and_mod_switch(const BgvQuadraticCt &ct,
+                                 const RlweKsk &relin_key);
+
+/**
+ * @brief Multiply two ciphertexts and switch the product to the modulus
+ * without its last prime, i.e. mult_low_level and relinearize followed by
+ * mod_switch_inplace with the divisions merged.
+ * @param ct1 The first ciphertext.
+ * @param ct2 The second ciphertext.
+ * @param relin_key The relinearization key.
+ * @return BgvCt
+ */
+inline BgvCt mult_and_mod_switch(const BgvCt &ct1, const BgvCt &ct2,
+                                 const RlweKsk &relin_key) {
+    auto ct_prod = mult_low_level(ct1, ct2);
+    return relinearize_and_mod_switch(ct_prod, relin_key);
+}
+
+/**
+ * @brief Relinearize asynchronously on the library's executor.
+ * @param ct The ciphertext to relinearize, which is copied into the task.
+ * @param relin_key The relinearization key, which should be kept alive until
+ * the result is ready.
+ * @return Future<BgvCt>
+ */
+inline Future<BgvCt> relinearize_async(const BgvQuadraticCt &ct,
+                                       const RlweKsk &relin_key) {
+    return run_async([ct, &relin_key]() { return relinearize(ct, relin_key); });
+}
+
+/**
+ * @brief Relinearize the result of another asynchronous operation, without
+ * blocking.
+ * @param ct The future of the ciphertext to relinearize.
+ * @param relin_key The relinearization key, which should be kept alive until
+ * the result is ready.
+ * @return Future<BgvCt>
+ */
+inline Future<BgvCt> relinearize_async(const Future<BgvQuadraticCt> &ct,
+                                       const RlweKsk &relin_key) {
+    return ct.then([&relin_key](const BgvQuadraticCt &ct) {
+        return relinearize(ct, relin_key);
+    });
+}
+
 } // namespace bgv
 } // namespace hehub
 
@@ -1,5 +1,6 @@
 #include "ckks.h"
 #include "fhe/common/ntt.h"
+#include "fhe/common/tracing.h"
 
 namespace hehub {
 namespace ckks {
@@ -13,6 +14,7 @@ auto check_scaling_factor = [](const auto &in1, const auto &in2) {
 };
 
 CkksCt add(const CkksCt &ct1, const CkksCt &ct2) {
+    HEHUB_TRACE_SPAN("ckks::add");
     check_scaling_factor(ct1, ct2);
     CkksCt sum_ct = ::hehub::add(ct1, ct2); // call addition on RLWE
     sum_ct.scaling_factor = ct1.scaling_factor;
@@ -20,6 +22,7 @@ CkksCt add(const CkksCt &ct1, const CkksCt &ct2) {
 }
 
 CkksCt add_plain(const CkksCt &ct, const CkksPt &pt) {
+    HEHUB_TRACE_SPAN("ckks::add_plain");
     check_scaling_factor(ct, pt);
     auto pt_ntt(pt);
     ntt_negacyclic_inplace_lazy(pt_ntt);
@@ -29,6 +32,7 @@ CkksCt add_plain(const CkksCt &ct, const CkksPt &pt) {
 }
 
 CkksCt sub(const CkksCt &ct1, const CkksCt &ct2) {
+    HEHUB_TRACE_SPAN("ckks::sub");
     check_scaling_factor(ct1, ct2);
     CkksCt diff_ct = ::hehub::sub(ct1, ct2); // call subtraction on RLWE
     diff_ct.scaling_factor = ct1.scaling_factor;
@@ -36,6 +40,7 @@ CkksCt sub(const CkksCt &ct1, const CkksCt &ct2) {
 }
 
 CkksCt sub_plain(const CkksCt &ct, const CkksPt &pt) {
+    HEHUB_TRACE_SPAN("ckks::sub_plain");
     check_scaling_factor(ct, pt);
     auto pt_ntt(pt);
     ntt_negacyclic_inplace_lazy(pt_ntt);
@@ -45,6 +50,7 @@ CkksCt sub_plain(const CkksCt &ct, const CkksPt &pt) {
 }
 
 CkksCt mult_plain(const CkksCt &ct, const CkksPt &pt) {
+    HEHUB_TRACE_SPAN("ckks::mult_plain");
     auto pt_ntt(pt);
     ntt_negacyclic_inplace_lazy(pt_ntt);
     CkksCt prod_ct = mult_plain_core(ct, pt_ntt);
@@ -52,19 +58,78 @@ CkksCt mult_plain(const CkksCt &ct, const CkksPt &pt) {
     return prod_ct;
 }
 
+CkksCt linear_combination(const std::vector<CkksCt> &cts,
+                          const std::vector<double> &weights) {
+    HEHUB_TRACE_SPAN("ckks::linear_combination");
+    if (cts.size() != weights.size()) {
+        throw std::invalid_argument(
+            "Numbers of the ciphertexts and the weights mismatch.");
+    }
+    if (cts.empty()) {
+        throw std::invalid_argument("No ciphertexts to combine.");
+    }
+    for (auto &ct : cts) {
+        check_scaling_factor(ct, cts[0]);
+    }
+    const auto &moduli = cts[0][0].modulus_vec();
+    const auto component_count = moduli.size();
+    const auto q_last = moduli.back();
+
+    // The weights are scaled by the last prime, which the rescaling divides.
+    std::vector<u64> rns_weights(cts.size() * component_count);
+    for (size_t j = 0; j < cts.size(); j++) {
+        auto scaled = std::round(weights[j] * q_last);
+        if (!(std::abs(scaled) < std::pow(2.0, 63))) {
+            throw std::invalid_argument("The weight is too large.");
+        }
+        auto magnitude = (u64)std::abs(scaled);
+        for (size_t k = 0; k < component_count; k++) {
+            auto reduced = magnitude % moduli[k];
+            rns_weights[j * component_count + k] =
+                (scaled < 0 && reduced) ? moduli[k] - reduced : reduced;
+        }
+    }
+
+    std::vector<std::reference_wrapper<const RlweCt>> ct_refs(cts.begin(),
+                                                              cts.end());
+    CkksCt result = linear_combination_core(ct_refs, rns_weights);
+    result.scaling_factor = cts[0].scaling_factor * q_last;
+    rescale_inplace(result);
+    return result;
+}
+
+void CtAccumulator::add(const CkksCt &ct) {
+    HEHUB_TRACE_SPAN("ckks::CtAccumulator::add");
+    if (count() == 0) {
+        scaling_factor_ = ct.scaling_factor;
+    } else if (std::abs(ct.scaling_factor - scaling_factor_) > EPS) {
+        throw std::invalid_argument("The scaling factors mismatch");
+    }
+    sum_.add(ct);
+}
+
+CkksCt CtAccumulator::result() const {
+    CkksCt sum_ct = sum_.result();
+    sum_ct.scaling_factor = scaling_factor_;
+    return sum_ct;
+}
+
 CkksQuadraticCt mult_low_level(const CkksCt &ct1, const CkksCt &ct2) {
+    HEHUB_TRACE_SPAN("ckks::mult");
     CkksQuadraticCt ct_prod;
-    ct_prod[0] = ct1[0] * ct2[0];
-    ct_prod[1] = ct1[0] * ct2[1] + ct1[1] * ct2[0];
-    ct_prod[2] = ct1[1] * ct2[1];
+    tensor_product(ct1, ct2, ct_prod);
     ct_prod.scaling_factor = ct1.scaling_factor * ct2.scaling_factor;
     return ct_prod;
 }
 
 CkksCt relinearize(const CkksQuadraticCt &ct, const RlweKsk &relin_key) {
+    HEHUB_TRACE_SPAN("ckks::relinearize");
     CkksCt ct_new = ext_prod_montgomery(ct[2], relin_key);
-    rescale_inplace(ct_new); // this rescaling step shouldn't
-                             // modify scaling factor
+    {
+        HEHUB_TRACE_SPAN("ModDown");
+        rescale_inplace(ct_new); // this rescaling step shouldn't
+                                 // modify scaling factor
+    }
     ct_new.scaling_factor = ct.scaling_factor;
 
     ct_new[0] += ct[0];
@@ -73,9 +138,13 @@ CkksCt relinearize(const CkksQuadraticCt &ct, const RlweKsk &relin_key) {
 }
 
 CkksCt conjugate(const CkksCt &ct, const RlweKsk &conj_key) {
+    HEHUB_TRACE_SPAN("ckks::conjugate");
     auto ct_involved = RlweCt{involution(ct[0]), involution(ct[1])};
     CkksCt ct_conj = ext_prod_montgomery(ct_involved[1], conj_key);
-    rescale_inplace(ct_conj);
+    {
+        HEHUB_TRACE_SPAN("ModDown");
+        rescale_inplace(ct_conj);
+    }
     ct_conj.scaling_factor = ct.scaling_factor; // the scaling factor
                                                 // should remain
     ct_conj[0] += ct_involved[0];
@@ -83,14 +152,56 @@ CkksCt conjugate(const CkksCt &ct, const RlweKsk &conj_key) {
 }
 
 CkksCt rotate(const CkksCt &ct, const RlweKsk &rot_key, const size_t step) {
+    HEHUB_TRACE_SPAN("ckks::rotate");
     auto rotated = RlweCt{cycle(ct[0], step), cycle(ct[1], step)};
     CkksCt ct_rot = ext_prod_montgomery(rotated[1], rot_key);
-    rescale_inplace(ct_rot);
+    {
+        HEHUB_TRACE_SPAN("ModDown");
+        rescale_inplace(ct_rot);
+    }
     ct_rot.scaling_factor = ct.scaling_factor; // the scaling factor
                                                // should remain
     ct_rot[0] += rotated[0];
     return ct_rot;
 }
 
+CkksCt rotate(const CkksCt &ct,
+              const std::vector<RnsPolynomial> &decomposed_ct1,
+              const RotKey &rot_key) {
+    HEHUB_TRACE_SPAN("ckks::rotate");
+    // The automorphism commutes with the decomposition, hence can be applied
+    // to the decomposed polynomials in NTT form.
+    std::vector<RnsPolynomial> decomposed_rotated;
+    decomposed_rotated.reserve(decomposed_ct1.size());
+    for (const auto &poly : decomposed_ct1) {
+        decomposed_rotated.push_back(cycle(poly, rot_key.step));
+    }
+    CkksCt ct_rot = ext_prod_montgomery(decomposed_rotated, rot_key);
+    {
+        HEHUB_TRACE_SPAN("ModDown");
+        rescale_inplace(ct_rot);
+    }
+    ct_rot.scaling_factor = ct.scaling_factor;
+    ct_rot[0] += cycle(ct[0], rot_key.step);
+    return ct_rot;
+}
+
+std::vector<CkksCt> rotate_hoisted(
+    const CkksCt &ct,
+    const std::vector<std::reference_wrapper<const RotKey>> &rot_keys) {
+    HEHUB_TRACE_SPAN("ckks::rotate_hoisted");
+    if (rot_keys.empty()) {
+        return {};
+    }
+    auto additional_mod = rot_keys[0].get()[0][0].modulus_vec().back();
+    auto decomposed_ct1 = ext_prod_decompose(ct[1], additional_mod);
+
+    std::vector<CkksCt> cts_rot(rot_keys.size());
+    parallel_for(0, rot_keys.size(), [&](size_t i) {
+        cts_rot[i] = rotate(ct, decomposed_ct1, rot_keys[i]);
+    });
+    return cts_rot;
+}
+
 } // namespace ckks
 } // namespace hehub
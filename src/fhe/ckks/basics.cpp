@@ -1,9 +1,11 @@
 #include "ckks.h"
 #include "fhe/common/bigint.h"
+#include "fhe/common/concurrent_cache.h"
 #include "fhe/common/mod_arith.h"
 #include "fhe/common/permutation.h"
 #include "fhe/common/primelists.h"
 #include "fhe/common/rns_transform.h"
+#include "fhe/common/tracing.h"
 #include <numeric>
 
 using namespace std;
@@ -38,15 +40,12 @@ CkksParams create_params(size_t dimension, std::vector<size_t> moduli_bits,
 }
 
 CkksParams create_params(size_t dimension, size_t initial_scaling_bits) {
-    static map<size_t, size_t> std_log_q_size{{1024, 27},   {2048, 54},
-                                              {4096, 109},  {8192, 218},
-                                              {16384, 438}, {32768, 881}};
-
-    auto log_q_size_it = std_log_q_size.find(dimension);
-    if (log_q_size_it == std_log_q_size.end()) {
+    size_t log_q_size;
+    try {
+        log_q_size = max_modulus_bits(dimension);
+    } catch (const std::invalid_argument &) {
         throw "No suitable primes for this dimension.";
     }
-    auto log_q_size = log_q_size_it->second;
     if (log_q_size < 2 * initial_scaling_bits) {
         throw "Initial scaling bits too big.";
     }
@@ -100,22 +99,11 @@ void fft_negacyclic_natural_inout(cc_double *coeffs, size_t log_dimension,
         vector<cc_double> butterfly;
     };
 
-    static map<pair<size_t, bool>, FFTFactors> fft_factors_cache;
+    static ConcurrentCache<pair<size_t, bool>, FFTFactors> fft_factors_cache;
 
-    auto __find_or_create_fft_factors = [&](size_t log_dimension,
-                                            bool inverse) {
-        const auto args = make_pair(log_dimension, inverse);
-        auto it = fft_factors_cache.find(args);
-        if (it == fft_factors_cache.end()) {
-            fft_factors_cache.insert(
-                std::make_pair(args, FFTFactors(log_dimension, inverse)));
-            it = fft_factors_cache.find(args);
-        }
-        return it->second;
-    };
-
-    const FFTFactors &fft_factors =
-        __find_or_create_fft_factors(log_dimension, inverse);
+    const FFTFactors &fft_factors = fft_factors_cache.find_or_create(
+        make_pair(log_dimension, inverse),
+        [&]() { return FFTFactors(log_dimension, inverse); });
     /************************* End of preparations ***************************/
 
     auto dimension = 1ULL << log_dimension;
@@ -156,6 +144,7 @@ void fft_negacyclic_natural_inout(cc_double *coeffs, size_t log_dimension,
 CkksPt simd_encode_cc(const vector<cc_double> &data,
                       const double scaling_factor,
                       const CkksParams &pt_params) {
+    HEHUB_TRACE_SPAN("ckks::encode");
     if (scaling_factor <= 0) {
         throw invalid_argument("Scaling factor should be positive.");
     }
@@ -271,51 +260,42 @@ CkksPt simd_encode(const std::vector<double> &data,
     return simd_encode_cc(data_cc, pt_params.initial_scaling_factor, pt_params);
 }
 
-vector<cc_double> simd_decode_cc(const CkksPt &pt, size_t data_size) {
-    auto scaling_factor = pt.scaling_factor;
-    if (scaling_factor <= 0) {
+/// The coefficients of a plaintext centered modulo the whole modulus and
+/// divided by the scaling factor.
+static vector<double> __scaled_coeffs(const CkksPt &pt) {
+    if (pt.scaling_factor <= 0) {
         throw invalid_argument("Scaling factor should be positive.");
     }
-    auto slot_count = pt.dimension() / 2;
-    if (data_size == 0) {
-        data_size = slot_count; // Actual default argument
-    }
-    if (data_size > slot_count) {
-        throw invalid_argument("Cannot decode " + to_string(data_size) +
-                               " items from " + to_string(slot_count) +
-                               " slots.");
-    }
-
     auto pt_reduced(pt);
     reduce_strict(pt_reduced);
     auto dimension = pt.dimension();
-    size_t log_dimension = round(log2(dimension));
     auto components = pt.component_count();
 
     // Decide whether the coefficients when in composed form will be all smaller
     // than the first modulus.
     bool small_coeff = true;
-    RnsPolynomial first_component(dimension, 1, pt.modulus_vec());
-    first_component[0] = pt_reduced[0];
-    vector rest_moduli(pt.modulus_vec().begin() + 1, pt.modulus_vec().end());
-    auto first_compo_under_rest_mod =
-        rns_base_transform(first_component, rest_moduli);
-    for (size_t k = 0; k < components - 1; k++) {
-        if (first_compo_under_rest_mod[k] != pt_reduced[k + 1]) {
-            small_coeff = false;
-            break;
+    if (components > 1) {
+        vector rest_moduli(pt.modulus_vec().begin() + 1,
+                           pt.modulus_vec().end());
+        auto first_compo_under_rest_mod = rns_base_transform(
+            RnsPolyConstView(pt_reduced, 0, 1), rest_moduli);
+        for (size_t k = 0; k < components - 1; k++) {
+            if (first_compo_under_rest_mod[k] != pt_reduced[k + 1]) {
+                small_coeff = false;
+                break;
+            }
         }
     }
 
-    vector<cc_double> interpolated(pt.dimension());
+    vector<double> coeffs(dimension);
     if (small_coeff) {
         auto first_mod = pt_reduced.modulus_at(0);
         auto half_first_mod = first_mod / 2;
         for (size_t i = 0; i < dimension; i++) {
             if (pt_reduced[0][i] < half_first_mod) {
-                interpolated[i] = (double)pt_reduced[0][i];
+                coeffs[i] = (double)pt_reduced[0][i];
             } else {
-                interpolated[i] = -(double)(first_mod - pt_reduced[0][i]);
+                coeffs[i] = -(double)(first_mod - pt_reduced[0][i]);
             }
         }
     } else {
@@ -325,36 +305,153 @@ vector<cc_double> simd_decode_cc(const CkksPt &pt, size_t data_size) {
                        UBInt(1), [](auto acc, auto x) { return acc * x; });
         auto half_whole_mod = whole_modulus / 2;
         for (size_t i = 0; i < dimension; i++) {
-            double abs_real;
             if (pt_poly_big_int[i] < half_whole_mod) {
-                abs_real = to_double(pt_poly_big_int[i]);
-                interpolated[i] = abs_real;
+                coeffs[i] = to_double(pt_poly_big_int[i]);
             } else {
-                abs_real = to_double(whole_modulus - pt_poly_big_int[i]);
-                interpolated[i] = -abs_real;
+                coeffs[i] = -to_double(whole_modulus - pt_poly_big_int[i]);
             }
         }
     }
 
-    // Recover the data by scaling back and FFT
-    for (auto &i : interpolated) {
-        i /= scaling_factor;
+    for (auto &c : coeffs) {
+        c /= pt.scaling_factor;
     }
-    // interpolated.size() == dimension
-    fft_negacyclic_natural_inout(interpolated.data(), log_dimension);
+    return coeffs;
+}
 
-    // extract the original conjugation half
-    vector<cc_double> data(slot_count);
+/// The constant coefficient of a plaintext centered modulo the whole modulus
+/// and divided by the scaling factor, which is composed alone by the CRT.
+static double __scaled_constant_coeff(const CkksPt &pt) {
+    if (pt.scaling_factor <= 0) {
+        throw invalid_argument("Scaling factor should be positive.");
+    }
+    const auto &moduli = pt.modulus_vec();
+    UBInt whole_modulus(1);
+    for (auto modulus : moduli) {
+        whole_modulus *= modulus;
+    }
+
+    // x = sum_k [x_k * (Q/q_k)^(-1)]_{q_k} * Q/q_k mod Q, where the big integers
+    // are only multiplied and subtracted, as their division is slow.
+    UBInt composed;
+    for (size_t k = 0; k < moduli.size(); k++) {
+        auto modulus = moduli[k];
+        UBInt rest_product(1);
+        u64 rest_product_reduced = 1;
+        for (size_t l = 0; l < moduli.size(); l++) {
+            if (l != k) {
+                rest_product *= moduli[l];
+                rest_product_reduced =
+                    (u128)rest_product_reduced * moduli[l] % modulus;
+            }
+        }
+        u64 factor = (u128)(pt[k][0] % modulus) *
+                     inverse_mod_prime(rest_product_reduced, modulus) %
+                     modulus;
+        composed += UBInt(factor) * rest_product;
+    }
+    while (composed >= whole_modulus) {
+        composed -= whole_modulus;
+    }
+
+    double centered;
+    if (composed + composed < whole_modulus) {
+        centered = to_double(composed);
+    } else {
+        centered = -to_double(whole_modulus - composed);
+    }
+    return centered / pt.scaling_factor;
+}
+
+/// The weights w_j such that the sum of the slots of a message m(X) is
+/// sum_j m_j * w_j, i.e. w_j is the sum of the j-th powers of the slot roots,
+/// which is N times the conjugate of the interpolation of the slot indicator.
+static const vector<cc_double> &__slot_sum_weights(size_t log_dimension) {
+    static ConcurrentCache<size_t, vector<cc_double>> weights_cache;
+    return weights_cache.find_or_create(log_dimension, [log_dimension]() {
+        auto dimension = 1ULL << log_dimension;
+        vector<cc_double> weights(dimension, 0.0);
+        auto &root_indices = root_index_factors();
+        auto mask = (1 << (log_dimension + 1)) - 1;
+        for (size_t i = 0; i < dimension / 2; i++) {
+            weights[((root_indices[i] & mask) - 1) / 2] = 1.0;
+        }
+        fft_negacyclic_natural_inout(weights.data(), log_dimension,
+                                     /*inverse=*/true);
+        for (auto &w : weights) {
+            w = conj(w) * (double)dimension;
+        }
+        return weights;
+    });
+}
+
+vector<cc_double> simd_decode_cc(const CkksPt &pt, size_t data_size) {
+    HEHUB_TRACE_SPAN("ckks::decode");
+    auto slot_count = pt.dimension() / 2;
+    if (data_size == 0) {
+        data_size = slot_count; // Actual default argument
+    }
+    if (data_size > slot_count) {
+        throw invalid_argument("Cannot decode " + to_string(data_size) +
+                               " items from " + to_string(slot_count) +
+                               " slots.");
+    }
+
+    auto coeffs = __scaled_coeffs(pt);
+    auto dimension = pt.dimension();
+    size_t log_dimension = round(log2(dimension));
     auto &root_indices = root_index_factors();
     auto mask = (1 << (log_dimension + 1)) - 1; // for fast modulo 2*len
-    for (size_t i = 0; i < slot_count; i++) {
+    vector<cc_double> data(data_size);
+
+    // A few slots are evaluated at their roots directly by Horner's rule, which
+    // costs N per slot against the (N/2) log N butterflies of the FFT.
+    if (data_size <= log_dimension / 2) {
+        for (size_t i = 0; i < data_size; i++) {
+            auto root = polar(1.0, (root_indices[i] & mask) * M_PI / dimension);
+            double root_re = root.real(), root_im = root.imag();
+            double value_re = 0, value_im = 0;
+            for (size_t j = dimension; j-- > 0;) {
+                double temp_re = value_re * root_re - value_im * root_im;
+                value_im = value_re * root_im + value_im * root_re;
+                value_re = temp_re + coeffs[j];
+            }
+            data[i] = {value_re, value_im};
+        }
+        return data;
+    }
+
+    vector<cc_double> values(coeffs.begin(), coeffs.end());
+    fft_negacyclic_natural_inout(values.data(), log_dimension);
+
+    // extract the original conjugation half
+    for (size_t i = 0; i < data_size; i++) {
         auto root_index = root_indices[i] & mask;
         auto position = (root_index - 1) / 2;
-        data[i] = interpolated[position];
+        data[i] = values[position];
     }
     return data;
 }
 
+template <> double decode(const CkksPt &pt) {
+    HEHUB_TRACE_SPAN("ckks::decode");
+    // The real parts of the slots sum up to N/2 times the constant coefficient.
+    return __scaled_constant_coeff(pt);
+}
+
+template <> cc_double decode(const CkksPt &pt) {
+    HEHUB_TRACE_SPAN("ckks::decode");
+    auto coeffs = __scaled_coeffs(pt);
+    auto dimension = pt.dimension();
+    size_t log_dimension = round(log2(dimension));
+    const auto &weights = __slot_sum_weights(log_dimension);
+    cc_double sum = 0;
+    for (size_t j = 0; j < dimension; j++) {
+        sum += coeffs[j] * weights[j];
+    }
+    return sum / (double)(dimension / 2);
+}
+
 template <> vector<cc_double> simd_decode(const CkksPt &pt, size_t data_size) {
     return simd_decode_cc(pt, data_size);
 }
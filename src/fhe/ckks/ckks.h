@@ -6,11 +6,14 @@
 
 #pragma once
 
+#include "fhe/common/task_runtime.h"
+#include "fhe/common/tracing.h"
 #include "fhe/common/type_defs.h"
 #include "fhe/primitives/keys.h"
 #include "fhe/primitives/rgsw.h"
 #include "fhe/primitives/rlwe.h"
 #include <complex>
+#include <functional>
 #include <numeric>
 
 namespace hehub {
@@ -139,12 +142,13 @@ inline CkksPt encode(const double datum, const CkksParams &pt_params) {
 }
 
 /**
- * @brief TODO
- *
- * @tparam T
- * @param pt
- * @param data_size
- * @return std::vector<T>
+ * @brief Decode the first data_size slots of a plaintext, which are evaluated
+ * directly at their roots if there are only a few of them (at most log(N)/2),
+ * instead of running the whole FFT.
+ * @tparam T double or cc_double.
+ * @param pt The plaintext.
+ * @param data_size The number of slots to decode, where 0 means all of them.
+ * @return std::vector<T> The first data_size slots.
  */
 template <typename T = double,
           typename std::enable_if<std::is_same<T, double>::value ||
@@ -153,22 +157,19 @@ template <typename T = double,
 std::vector<T> simd_decode(const CkksPt &pt, size_t data_size = 0);
 
 /**
- * @brief TODO
- *
- * @tparam T
- * @param pt
- * @param data_size
- * @return std::vector<T>
+ * @brief Decode the mean of the slots of a plaintext without the FFT. The mean
+ * of the real parts is the constant coefficient, hence only that coefficient
+ * is composed from the RNS, while the complex mean is a weighted sum of the
+ * coefficients, which costs O(N).
+ * @tparam T double or cc_double.
+ * @param pt The plaintext.
+ * @return T The mean of the slots.
  */
 template <typename T = double,
           typename std::enable_if<std::is_same<T, double>::value ||
                                   std::is_same<T, cc_double>::value>::type * =
               nullptr>
-inline T decode(const CkksPt &pt) {
-    std::vector<T> decoded_vec = simd_decode(pt);
-    T sum = std::accumulate(decoded_vec.begin(), decoded_vec.end(), (T)0);
-    return sum / decoded_vec.size();
-}
+T decode(const CkksPt &pt);
 
 /**
  * @brief TODO
@@ -178,20 +179,22 @@ inline T decode(const CkksPt &pt) {
  * @return CkksCt
  */
 inline CkksCt encrypt(const CkksPt &pt, const RlweSk &sk) {
+    HEHUB_TRACE_SPAN("ckks::encrypt");
     CkksCt ct = encrypt_core(pt, sk);
     ct.scaling_factor = pt.scaling_factor;
     return ct;
 }
 
 /**
- * @brief TODO
- *
- * @param ct
- * @param sk
- * @return CkksCt
+ * @brief Decrypt a ciphertext with its first prime alone if the plaintext fits
+ * in it, which is checked by a second prime, and otherwise with all of them.
+ * @param ct The ciphertext.
+ * @param sk The secret key.
+ * @return CkksPt The plaintext, under the first one or all of the primes.
  */
 inline CkksPt decrypt(const CkksCt &ct, const RlweSk &sk) {
-    CkksPt pt = decrypt_core(ct, sk);
+    HEHUB_TRACE_SPAN("ckks::decrypt");
+    CkksPt pt = decrypt_core_minimal(ct, sk);
     pt.scaling_factor = ct.scaling_factor;
     return pt;
 }
@@ -241,6 +244,41 @@ CkksCt sub_plain(const CkksCt &ct, const CkksPt &pt);
  */
 CkksCt mult_plain(const CkksCt &ct, const CkksPt &pt);
 
+/**
+ * @brief Compute the linear combination sum_j w_j * ct_j of ciphertexts with
+ * real weights, which is one sweep over the ciphertexts instead of a
+ * mult_plain and an add for each of them. The weights are scaled by the last
+ * prime and rounded, and the sum is rescaled once in the end, hence the
+ * result has one prime less and the scaling factor of the inputs.
+ * @param cts The ciphertexts, which have the same primes and scaling factors.
+ * @param weights The weights, one for each ciphertext.
+ * @return CkksCt
+ */
+CkksCt linear_combination(const std::vector<CkksCt> &cts,
+                          const std::vector<double> &weights);
+
+/**
+ * @brief An accumulator summing many ciphertexts of the same scaling factor
+ * lazily, which is much cheaper than a chain of add for a large sum.
+ */
+class CtAccumulator {
+public:
+    /// @brief Add a ciphertext, whose scaling factor should be that of the
+    /// ones added before.
+    void add(const CkksCt &ct);
+
+    /// @brief The sum of the ciphertexts added.
+    CkksCt result() const;
+
+    /// @brief The number of the ciphertexts added.
+    inline size_t count() const { return sum_.count(); }
+
+private:
+    hehub::CtAccumulator sum_;
+
+    double scaling_factor_ = 0;
+};
+
 /**
  * @brief TODO
  *
@@ -305,13 +343,116 @@ inline CkksCt rotate(const CkksCt &ct, const RotKey &rot_key) {
 }
 
 /**
- * @brief TODO
- *
- * @param ct
- * @param dropping_primes
+ * @brief Rotate a ciphertext whose second polynomial has been decomposed by
+ * ext_prod_decompose in advance, so that the decomposition can be shared by the
+ * rotations of one ciphertext by different steps.
+ * @param ct The ciphertext to rotate.
+ * @param decomposed_ct1 The decomposition of ct[1].
+ * @param rot_key The rotation key.
+ * @return CkksCt
+ */
+CkksCt rotate(const CkksCt &ct,
+              const std::vector<RnsPolynomial> &decomposed_ct1,
+              const RotKey &rot_key);
+
+/**
+ * @brief Rotate a ciphertext by several steps, decomposing the ciphertext
+ * only once for all the key switchings (a.k.a. hoisting).
+ * @param ct The ciphertext to rotate.
+ * @param rot_keys The rotation keys, one for each step.
+ * @return The rotated ciphertexts in the order of the keys.
+ */
+std::vector<CkksCt> rotate_hoisted(
+    const CkksCt &ct,
+    const std::vector<std::reference_wrapper<const RotKey>> &rot_keys);
+
+/**
+ * @brief Rescale a ciphertext by dropping its last primes, where several
+ * primes are dropped in one pass.
+ * @param ct The ciphertext to rescale.
+ * @param dropping_primes The number of primes to drop.
  */
 void rescale_inplace(CkksCt &ct, size_t dropping_primes = 1);
 
+/**
+ * @brief Relinearize a product and rescale it by its last prime, where the
+ * ModDown by the special prime and the rescaling are one division, which
+ * saves the INTT of the last prime and the NTTs of a second base conversion.
+ * The result differs from relinearize followed by rescale_inplace only in the
+ * rounding.
+ * @param ct The product to relinearize.
+ * @param relin_key The relinearization key.
+ * @return CkksCt
+ */
+CkksCt relinearize_and_rescale(const CkksQuadraticCt &ct,
+                               const RlweKsk &relin_key);
+
+/**
+ * @brief Multiply two ciphertexts and rescale the product by its last prime,
+ * i.e. mult followed by rescale_inplace with the divisions merged.
+ * @param ct1 The first ciphertext.
+ * @param ct2 The second ciphertext.
+ * @param relin_key The relinearization key.
+ * @return CkksCt
+ */
+inline CkksCt mult_and_rescale(const CkksCt &ct1, const CkksCt &ct2,
+                               const RlweKsk &relin_key) {
+    auto ct_prod = mult_low_level(ct1, ct2);
+    return relinearize_and_rescale(ct_prod, relin_key);
+}
+
+/**
+ * @brief Relinearize asynchronously on the library's executor.
+ * @param ct The ciphertext to relinearize, which is copied into the task.
+ * @param relin_key The relinearization key, which should be kept alive until
+ * the result is ready.
+ * @return Future<CkksCt>
+ */
+inline Future<CkksCt> relinearize_async(const CkksQuadraticCt &ct,
+                                        const RlweKsk &relin_key) {
+    return run_async([ct, &relin_key]() { return relinearize(ct, relin_key); });
+}
+
+/**
+ * @brief Relinearize the result of another asynchronous operation, without
+ * blocking.
+ * @param ct The future of the ciphertext to relinearize.
+ * @param relin_key The relinearization key, which should be kept alive until
+ * the result is ready.
+ * @return Future<CkksCt>
+ */
+inline Future<CkksCt> relinearize_async(const Future<CkksQuadraticCt> &ct,
+                                        const RlweKsk &relin_key) {
+    return ct.then([&relin_key](const CkksQuadraticCt &ct) {
+        return relinearize(ct, relin_key);
+    });
+}
+
+/**
+ * @brief Rotate asynchronously on the library's executor.
+ * @param ct The ciphertext to rotate, which is copied into the task.
+ * @param rot_key The rotation key, which should be kept alive until the result
+ * is ready.
+ * @return Future<CkksCt>
+ */
+inline Future<CkksCt> rotate_async(const CkksCt &ct, const RotKey &rot_key) {
+    return run_async([ct, &rot_key]() { return rotate(ct, rot_key); });
+}
+
+/**
+ * @brief Rotate the result of another asynchronous operation, without
+ * blocking.
+ * @param ct The future of the ciphertext to rotate.
+ * @param rot_key The rotation key, which should be kept alive until the result
+ * is ready.
+ * @return Future<CkksCt>
+ */
+inline Future<CkksCt> rotate_async(const Future<CkksCt> &ct,
+                                   const RotKey &rot_key) {
+    return ct.then(
+        [&rot_key](const CkksCt &ct) { return rotate(ct, rot_key); });
+}
+
 } // namespace ckks
 } // namespace hehub
 
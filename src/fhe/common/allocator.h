@@ -1,14 +1,21 @@
 #pragma once
 
+#include "concurrent_cache.h"
+#include "profiling.h"
 #include "type_defs.h"
+#include <atomic>
 #include <cassert>
 #include <map>
+#include <mutex>
+#include <new>
 #include <set>
 #include <stack>
 #include <type_traits>
 
 namespace hehub {
 
+/// @note The allocator is thread-safe, i.e. blocks can be allocated from and
+/// returned to it by different threads at the same time.
 template <typename T> class FixedBlockAllocator {
 public:
     /// Constructor
@@ -25,6 +32,8 @@ public:
     /// @return Returns pointer to the block. Otherwise nullptr if
     /// unsuccessful.
     void *allocate() {
+        std::lock_guard lock(mutex_);
+
         // If can't obtain existing block then get a new one
         void *block = _pop();
         if (!block) {
@@ -43,6 +52,7 @@ public:
     /// @param[in] to_cache - block of memory deallocate (i.e push onto
     /// free-list)
     void deallocate(void *to_cache) {
+        std::lock_guard lock(mutex_);
         _push(to_cache);
         blocks_in_use_--;
         blocks_free_++;
@@ -54,15 +64,24 @@ public:
 
     /// Gets the number of blocks in use.
     /// @return The number of blocks in use by the application.
-    const size_t get_blocks_in_use() const { return blocks_in_use_; }
+    const size_t get_blocks_in_use() const {
+        std::lock_guard lock(mutex_);
+        return blocks_in_use_;
+    }
 
     /// Gets the total number of allocations for this allocator instance.
     /// @return The total number of allocations.
-    const size_t get_blocks_total() const { return blocks_total_; }
+    const size_t get_blocks_total() const {
+        std::lock_guard lock(mutex_);
+        return blocks_total_;
+    }
 
     /// Gets the total number of deallocations for this allocator instance.
     /// @return The total number of deallocations.
-    const size_t get_blocks_free() const { return blocks_free_; }
+    const size_t get_blocks_free() const {
+        std::lock_guard lock(mutex_);
+        return blocks_free_;
+    }
 
 private:
     /// Push a memory block onto head of free-list.
@@ -93,6 +112,8 @@ private:
 
     const size_t block_size_;
 
+    mutable std::mutex mutex_;
+
     Block *head_ = nullptr;
 
     size_t blocks_in_use_ = 0;
@@ -102,6 +123,17 @@ private:
     size_t blocks_free_ = 0;
 };
 
+/**
+ * @brief An array of a fixed dimension, allocated from a pool of blocks of that
+ * dimension. The arrays are copy-on-write: a copy shares the block of the
+ * original, and the block is copied only on the first mutable access through
+ * operator[], data(), begin() or end() while it is shared. The block keeps a
+ * reference count in front of the data, which is atomic, hence the arrays
+ * sharing a block can be used by different threads, while a single array
+ * should not be accessed mutably by several threads at the same time.
+ * @note A pointer from a mutable access is invalidated by copying the array,
+ * as writing through it would change the copy as well.
+ */
 template <typename T> class SmartArray {
 public:
     SmartArray() {}
@@ -110,27 +142,32 @@ public:
         require(dimension_);
     }
 
-    SmartArray(const SmartArray &other) {
-        dimension_ = other.dimension_;
-        aff_allocator_ = other.aff_allocator_;
-        require(dimension_);
-        std::copy(other.data_, other.data_ + dimension_, data_);
+    SmartArray(const SmartArray &other)
+        : data_(other.data_), dimension_(other.dimension_),
+          aff_allocator_(other.aff_allocator_) {
+        share();
     }
 
     SmartArray(SmartArray &&other) noexcept { *this = std::move(other); }
 
     ~SmartArray() { cache(); }
 
-    inline T &operator[](const int idx) { return data_[idx]; }
+    inline T &operator[](const int idx) {
+        detach();
+        return data_[idx];
+    }
 
     inline const T operator[](const int idx) const { return data_[idx]; }
 
     SmartArray &operator=(const SmartArray &copying) {
-        if (dimension_ != copying.dimension_) {
-            cache();
-            require(copying.dimension_);
+        if (data_ == copying.data_) {
+            return *this;
         }
-        std::copy(copying.data_, copying.data_ + dimension_, data_);
+        cache();
+        data_ = copying.data_;
+        dimension_ = copying.dimension_;
+        aff_allocator_ = copying.aff_allocator_;
+        share();
         return *this;
     }
 
@@ -138,14 +175,12 @@ public:
         if (this == &moving) {
             return *this;
         }
+        cache();
 
         dimension_ = moving.dimension_;
         moving.dimension_ = 0;
 
         aff_allocator_ = moving.aff_allocator_;
-        if (!aff_allocator_) {
-            init_allocator(dimension_);
-        }
         moving.aff_allocator_ = nullptr;
 
         data_ = moving.data_;
@@ -157,6 +192,8 @@ public:
     inline bool operator==(const SmartArray &other) const {
         if (dimension_ != other.dimension_)
             return false;
+        if (data_ == other.data_)
+            return true;
         for (int i = 0; i < dimension_; i++) {
             if ((*this)[i] != other[i]) {
                 return false;
@@ -169,48 +206,98 @@ public:
         return !((*this) == comparing);
     }
 
-    inline T *data() { return data_; }
+    inline T *data() {
+        detach();
+        return data_;
+    }
 
     inline const T *data() const { return data_; }
 
-    inline T *begin() { return data_; }
+    inline T *begin() {
+        detach();
+        return data_;
+    }
 
     inline const T *begin() const { return data_; }
 
-    inline T *end() { return data_ + dimension_; }
+    inline T *end() {
+        detach();
+        return data_ + dimension_;
+    }
 
     inline const T *end() const { return data_ + dimension_; }
 
     inline const auto &aff_allocator() const { return *aff_allocator_; }
 
+    /// The number of arrays sharing the block, or 0 if none is allocated.
+    inline size_t use_count() const {
+        return data_ ? ref_count().load(std::memory_order_acquire) : 0;
+    }
+
     void init_allocator(size_t dimension) {
-        auto allocator_iter = allocator_hub_.find(dimension);
-        if (allocator_iter == allocator_hub_.end()) {
-            allocator_hub_.insert(
-                std::make_pair(dimension, FixedBlockAllocator<T>(dimension)));
-            allocator_iter = allocator_hub_.find(dimension);
-        }
-        aff_allocator_ = &allocator_iter->second;
+        aff_allocator_ = &allocator_hub_.find_or_emplace(
+            dimension, dimension + HEADER_LENGTH);
     }
 
     inline void require(size_t dimension) {
+        HEHUB_PROFILE_COUNT(allocation, dimension * sizeof(T));
         if (!aff_allocator_) {
             init_allocator(dimension_);
         }
 
-        data_ = (T *)aff_allocator_->allocate();
+        auto block = (T *)aff_allocator_->allocate();
+        new (block) std::atomic<size_t>(1);
+        data_ = block + HEADER_LENGTH;
     }
 
     inline void cache() {
-        dimension_ = 0;
-        if (aff_allocator_) {
-            aff_allocator_->deallocate((void *)data_);
-            aff_allocator_ = nullptr;
+        if (data_ && aff_allocator_ &&
+            ref_count().fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            aff_allocator_->deallocate((void *)(data_ - HEADER_LENGTH));
         }
+        data_ = nullptr;
+        dimension_ = 0;
+        aff_allocator_ = nullptr;
     }
 
 private:
-    static std::map<size_t, FixedBlockAllocator<T>> allocator_hub_;
+    /// The length of the header before the data, which holds the reference
+    /// count and is 64 bytes long, keeping the alignment of the block.
+    static constexpr size_t HEADER_LENGTH =
+        (64 + sizeof(T) - 1) / sizeof(T);
+
+    static_assert(HEADER_LENGTH * sizeof(T) >= sizeof(std::atomic<size_t>));
+
+    inline std::atomic<size_t> &ref_count() const {
+        return ref_count_of(data_);
+    }
+
+    inline void share() {
+        if (data_) {
+            ref_count().fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /// Copy the block if it is shared, after which this array owns its block.
+    inline void detach() {
+        if (data_ && ref_count().load(std::memory_order_acquire) != 1) {
+            auto shared_data = data_;
+            auto block_allocator = aff_allocator_;
+            require(dimension_);
+            std::copy(shared_data, shared_data + dimension_, data_);
+            if (ref_count_of(shared_data).fetch_sub(
+                    1, std::memory_order_acq_rel) == 1) {
+                block_allocator->deallocate(
+                    (void *)(shared_data - HEADER_LENGTH));
+            }
+        }
+    }
+
+    static inline std::atomic<size_t> &ref_count_of(T *data) {
+        return *(std::atomic<size_t> *)(data - HEADER_LENGTH);
+    }
+
+    static ConcurrentCache<size_t, FixedBlockAllocator<T>> allocator_hub_;
 
     T *data_ = nullptr;
 
@@ -220,6 +307,6 @@ private:
 };
 
 template <typename T>
-std::map<size_t, FixedBlockAllocator<T>> SmartArray<T>::allocator_hub_;
+ConcurrentCache<size_t, FixedBlockAllocator<T>> SmartArray<T>::allocator_hub_;
 
 } // namespace hehub
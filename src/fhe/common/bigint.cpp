@@ -391,10 +391,11 @@ UBInt CRTComposer::inv_mod_prime(const UBInt &x, const u64 modulus) {
     return x_power;
 }
 
-UBIntVec::UBIntVec(const RnsPolynomial &rns_poly) {
+UBIntVec::UBIntVec(RnsPolyConstView rns_poly) {
     const auto dimension(rns_poly.dimension());
     const auto component_count(rns_poly.component_count());
-    CRTComposer crt_composer(rns_poly.modulus_vec());
+    CRTComposer crt_composer(std::vector<u64>(
+        rns_poly.moduli(), rns_poly.moduli() + component_count));
     for (size_t i = 0; i < dimension; i++) {
         std::vector<u64> remainder_coeffs;
         for (size_t j = 0; j < component_count; j++) {
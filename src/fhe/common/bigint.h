@@ -115,7 +115,7 @@ private:
 class UBIntVec {
 public:
 
-    UBIntVec(const RnsPolynomial &rns_poly);
+    UBIntVec(RnsPolyConstView rns_poly);
 
     inline const size_t dimension() const { return coeffs_.size(); }
 
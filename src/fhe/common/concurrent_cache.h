@@ -0,0 +1,81 @@
+/**
+ * @file concurrent_cache.h
+ * @brief A lazily filled, thread-safe key-value cache for precomputed tables.
+ *
+ */
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+
+namespace hehub {
+
+/**
+ * @brief A map from keys to precomputed values which can be shared by any
+ * number of threads. Entries are created on first use and only erased by
+ * clear(), so a reference returned by the cache stays valid until then.
+ * @note Lookups take a shared lock only, hence concurrent readers of existing
+ * entries do not block each other.
+ */
+template <typename Key, typename Value> class ConcurrentCache {
+public:
+    /// @brief Find the value of a key, or null if the key is not present.
+    const Value *find(const Key &key) {
+        std::shared_lock lock(mutex_);
+        auto it = map_.find(key);
+        return it != map_.end() ? &it->second : nullptr;
+    }
+
+    /// @brief Find the value of a key, or create it by calling factory() if
+    /// the key is not present yet. The factory is called without holding the
+    /// lock, so it may be called more than once if several threads miss the
+    /// same key concurrently, in which case only one result is kept.
+    template <typename Factory>
+    const Value &find_or_create(const Key &key, Factory &&factory) {
+        {
+            std::shared_lock lock(mutex_);
+            auto it = map_.find(key);
+            if (it != map_.end()) {
+                return it->second;
+            }
+        }
+
+        Value value = factory();
+        std::unique_lock lock(mutex_);
+        return map_.try_emplace(key, std::move(value)).first->second;
+    }
+
+    /// @brief Find the value of a key, or construct it in place from args if
+    /// the key is not present yet. This is for values which are not movable,
+    /// and the construction is done while holding the lock.
+    template <typename... Args>
+    Value &find_or_emplace(const Key &key, Args &&...args) {
+        {
+            std::shared_lock lock(mutex_);
+            auto it = map_.find(key);
+            if (it != map_.end()) {
+                return it->second;
+            }
+        }
+
+        std::unique_lock lock(mutex_);
+        return map_.try_emplace(key, std::forward<Args>(args)...)
+            .first->second;
+    }
+
+    /// @brief Erase all the entries, which invalidates the references returned
+    /// before, hence no other thread should be using the cache.
+    void clear() {
+        std::unique_lock lock(mutex_);
+        map_.clear();
+    }
+
+private:
+    std::shared_mutex mutex_;
+
+    std::map<Key, Value> map_;
+};
+
+} // namespace hehub
@@ -0,0 +1,38 @@
+#include "kernel_presets.h"
+#include "concurrent_cache.h"
+#include <atomic>
+
+namespace hehub {
+
+using PresetKernelsTable =
+    ConcurrentCache<std::pair<size_t, u64>, PresetKernels>;
+
+static PresetKernelsTable &preset_kernels_table() {
+    static PresetKernelsTable table;
+    return table;
+}
+
+/// Whether any preset is registered, which spares the lookups otherwise.
+static std::atomic<bool> any_preset_registered{false};
+
+void __register_preset_kernels(const size_t dimension, const u64 modulus,
+                               const PresetKernels &kernels) {
+    preset_kernels_table().find_or_create(std::make_pair(dimension, modulus),
+                                          [&]() { return kernels; });
+    any_preset_registered.store(true, std::memory_order_release);
+}
+
+void clear_kernel_presets() {
+    any_preset_registered.store(false, std::memory_order_release);
+    preset_kernels_table().clear();
+}
+
+const PresetKernels *__find_preset_kernels(const size_t dimension,
+                                           const u64 modulus) {
+    if (!any_preset_registered.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return preset_kernels_table().find(std::make_pair(dimension, modulus));
+}
+
+} // namespace hehub
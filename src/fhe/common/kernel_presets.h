@@ -0,0 +1,270 @@
+/**
+ * @file kernel_presets.h
+ * @brief Kernels specialized at compile time for a fixed dimension and fixed
+ * moduli, which lets the compiler unroll the NTT levels and strength-reduce
+ * the modular constants. A preset is opt-in: the application registers it by
+ * register_kernel_preset<LogDim, Moduli...>(), after which the generic NTT,
+ * pointwise multiplication, tensor product and rescaling kernels dispatch to
+ * the specialized ones for the dimension and moduli of the preset, and run the
+ * generic code for any other parameters.
+ *
+ */
+
+#pragma once
+
+#include "mod_arith.h"
+#include "ntt.h"
+#include "type_defs.h"
+#include <utility>
+#include <vector>
+
+namespace hehub {
+
+/// @brief The NTT factors of a modulus and a dimension, as stored in the cache
+/// of the generic NTT.
+struct NTTFactorTables {
+    const u64 *seq;
+
+    const u64 *seq_harvey;
+
+    /// Only for the inverse NTT.
+    const size_t *shuffled_indices;
+};
+
+/// @brief Get the cached NTT factors, creating them if not present.
+NTTFactorTables __ntt_factor_tables(const u64 modulus,
+                                    const size_t log_dimension,
+                                    const bool for_inverse);
+
+/// @brief The kernels specialized for one dimension and one modulus.
+struct PresetKernels {
+    NTTFactorTables ntt_factors;
+
+    NTTFactorTables intt_factors;
+
+    void (*ntt)(const PresetKernels &kernels, u64 coeffs[]);
+
+    void (*intt)(const PresetKernels &kernels, u64 values[]);
+
+    void (*mul_mod_hybrid_lazy)(const u64 in_vec1[], const u64 in_vec2[],
+                                u64 out_vec[]);
+
+    void (*tensor_mul_mod_hybrid_lazy)(const u64 a0[], const u64 a1[],
+                                       const u64 b0[], const u64 b1[],
+                                       u64 out0[], u64 out1[], u64 out2[]);
+
+    void (*sub_mul_scalar_lazy)(u64 vec[], const u64 sub_vec[],
+                                const u64 scalar, const u64 scalar_harvey);
+};
+
+void __register_preset_kernels(const size_t dimension, const u64 modulus,
+                               const PresetKernels &kernels);
+
+/// @brief Find the kernels of a dimension and a modulus, or null if no preset
+/// covers them, which costs one atomic load if no preset is registered.
+const PresetKernels *__find_preset_kernels(const size_t dimension,
+                                           const u64 modulus);
+
+/// @brief Unregister all the presets, after which the generic kernels are run
+/// for any parameters. This is mainly for tests, and should not be called
+/// while operations are running.
+void clear_kernel_presets();
+
+/// @brief Whether the kernels for a dimension and a modulus are specialized.
+inline bool has_kernel_preset(const size_t log_dimension, const u64 modulus) {
+    return __find_preset_kernels(1ULL << log_dimension, modulus) != nullptr;
+}
+
+/// round(log2(modulus)), computed on integers.
+constexpr size_t __preset_log_modulus(const u64 modulus) {
+    size_t floor_log = 0;
+    while ((modulus >> floor_log) > 1) {
+        floor_log++;
+    }
+    // rounding up iff modulus >= 2^(floor_log + 1/2)
+    return (u128)modulus * modulus >= ((u128)1 << (2 * floor_log + 1))
+               ? floor_log + 1
+               : floor_log;
+}
+
+/// One level of the NTT butterflies, where the factors of the level start from
+/// idx. The values grow by 2 * modulus if Growing, otherwise the low inputs
+/// are reduced to [0, 2 * modulus).
+template <size_t LogDim, u64 Modulus, bool Growing, size_t Level>
+inline void __preset_butterfly_level(const u64 seq[], const u64 seq_harvey[],
+                                     const size_t first_idx, u64 data[]) {
+    constexpr size_t dimension = 1ULL << LogDim;
+    constexpr size_t gap = dimension >> (Level + 1);
+    constexpr size_t block_count = 1ULL << Level;
+    constexpr u64 modulus_doubled = 2 * Modulus;
+    for (size_t block = 0; block < block_count; block++) {
+        const auto zeta = seq[first_idx + block];
+        const auto zeta_harvey = seq_harvey[first_idx + block];
+        const auto low = data + block * 2 * gap;
+        const auto high = low + gap;
+        for (size_t i = 0; i < gap; i++) {
+            u64 low_value = low[i];
+            if (!Growing) {
+                low_value -=
+                    modulus_doubled & -(u64)(low_value >= modulus_doubled);
+            }
+            auto temp =
+                mul_mod_harvey_lazy(Modulus, high[i], zeta, zeta_harvey);
+            high[i] = low_value + modulus_doubled - temp;
+            low[i] = low_value + temp;
+        }
+    }
+}
+
+template <size_t LogDim, u64 Modulus, bool Growing, size_t... Levels>
+inline void __preset_butterflies(const u64 seq[], const u64 seq_harvey[],
+                                 const size_t idx, u64 data[],
+                                 std::index_sequence<Levels...>) {
+    // the factors of level l start from idx + 2^l - 1
+    (__preset_butterfly_level<LogDim, Modulus, Growing, Levels>(
+         seq, seq_harvey, idx + (1ULL << Levels) - 1, data),
+     ...);
+}
+
+template <size_t LogDim, u64 Modulus>
+void __preset_ntt(const PresetKernels &kernels, u64 coeffs[]) {
+    constexpr size_t dimension = 1ULL << LogDim;
+    constexpr size_t log_modulus = __preset_log_modulus(Modulus);
+    constexpr bool growing =
+        log_modulus <= NTT_MAX_GROWING_LOG_MODULUS<u64>;
+    __preset_butterflies<LogDim, Modulus, growing>(
+        kernels.ntt_factors.seq, kernels.ntt_factors.seq_harvey, 1, coeffs,
+        std::make_index_sequence<LogDim>());
+
+    if (growing) {
+        constexpr u64 div_fix = (Modulus >= (1ULL << log_modulus)) ? 1 : 0;
+        for (size_t i = 0; i < dimension; i++) {
+            coeffs[i] -= ((coeffs[i] >> log_modulus) - div_fix) * Modulus;
+        }
+    } else {
+        constexpr u64 modulus_doubled = 2 * Modulus;
+        for (size_t i = 0; i < dimension; i++) {
+            coeffs[i] -= (coeffs[i] >= modulus_doubled) ? modulus_doubled : 0;
+        }
+    }
+}
+
+template <size_t LogDim, u64 Modulus>
+void __preset_intt(const PresetKernels &kernels, u64 values[]) {
+    constexpr size_t dimension = 1ULL << LogDim;
+    constexpr size_t log_modulus = __preset_log_modulus(Modulus);
+    constexpr bool growing =
+        log_modulus <= NTT_MAX_GROWING_LOG_MODULUS<u64>;
+    const auto &factors = kernels.intt_factors;
+
+    // per-thread scratch, as the largest presets do not fit on the stack
+    thread_local std::vector<u64> values_shuffled(dimension);
+    for (size_t i = 0; i < dimension; i++) {
+        values_shuffled[i] = values[factors.shuffled_indices[i]];
+    }
+    __preset_butterflies<LogDim, Modulus, growing>(
+        factors.seq, factors.seq_harvey, 0, values_shuffled.data(),
+        std::make_index_sequence<LogDim>());
+    for (size_t i = 0; i < dimension; i++) {
+        values[i] = values_shuffled[factors.shuffled_indices[i]];
+    }
+
+    constexpr u64 div_fix = (Modulus >= (1ULL << log_modulus)) ? 1 : 0;
+    const auto last_factors = factors.seq + dimension;
+    const auto last_factors_harvey = factors.seq_harvey + dimension;
+    for (size_t i = 0; i < dimension; i++) {
+        if (growing) {
+            values[i] -= ((values[i] >> log_modulus) - div_fix) * Modulus;
+        }
+        values[i] = mul_mod_harvey_lazy(Modulus, values[i], last_factors[i],
+                                        last_factors_harvey[i]);
+    }
+}
+
+/// The hybrid Montgomery-Harvey reduction of the generic kernels, with the
+/// constants computed at compile time.
+template <u64 Modulus> inline u64 __preset_hybrid_reduce(const u128 a) {
+    constexpr u64 minus_qinv = [] {
+        u64 inv = Modulus;
+        for (int i = 0; i < 5; i++) {
+            inv *= 2 - Modulus * inv;
+        }
+        return -inv;
+    }();
+    constexpr u64 _2to64_reduced = (u64)(-1) % Modulus + 1;
+    constexpr u64 _2to64_harvey = ((u128)_2to64_reduced << 64) / Modulus;
+
+    u128 u = (u64)((u64)a * minus_qinv);
+    u *= Modulus;
+    u64 out_temp = (a + u) >> 64;
+    u64 out_temp2 = (u128)out_temp * _2to64_harvey >> 64;
+    return (u128)out_temp * _2to64_reduced - (u128)out_temp2 * Modulus;
+}
+
+template <size_t LogDim, u64 Modulus>
+void __preset_mul_mod_hybrid_lazy(const u64 in_vec1[], const u64 in_vec2[],
+                                  u64 out_vec[]) {
+    constexpr size_t dimension = 1ULL << LogDim;
+    for (size_t i = 0; i < dimension; i++) {
+        out_vec[i] =
+            __preset_hybrid_reduce<Modulus>((u128)in_vec1[i] * in_vec2[i]);
+    }
+}
+
+template <size_t LogDim, u64 Modulus>
+void __preset_tensor_mul_mod_hybrid_lazy(const u64 a0[], const u64 a1[],
+                                         const u64 b0[], const u64 b1[],
+                                         u64 out0[], u64 out1[], u64 out2[]) {
+    constexpr size_t dimension = 1ULL << LogDim;
+    for (size_t i = 0; i < dimension; i++) {
+        const u64 x0 = a0[i], x1 = a1[i], y0 = b0[i], y1 = b1[i];
+        out0[i] = __preset_hybrid_reduce<Modulus>((u128)x0 * y0);
+        out1[i] = __preset_hybrid_reduce<Modulus>((u128)x0 * y1 +
+                                                  (u128)x1 * y0);
+        out2[i] = __preset_hybrid_reduce<Modulus>((u128)x1 * y1);
+    }
+}
+
+template <size_t LogDim, u64 Modulus>
+void __preset_sub_mul_scalar_lazy(u64 vec[], const u64 sub_vec[],
+                                  const u64 scalar, const u64 scalar_harvey) {
+    constexpr size_t dimension = 1ULL << LogDim;
+    constexpr u64 modulus_doubled = 2 * Modulus;
+    for (size_t i = 0; i < dimension; i++) {
+        vec[i] = mul_mod_harvey_lazy(Modulus,
+                                     vec[i] + modulus_doubled - sub_vec[i],
+                                     scalar, scalar_harvey);
+    }
+}
+
+template <size_t LogDim, u64 Modulus> void __register_preset_kernels() {
+    static_assert(Modulus % 2 == 1 && Modulus < (1ULL << 62),
+                  "The moduli of a preset should be odd and less than 2^62.");
+    PresetKernels kernels;
+    kernels.ntt_factors = __ntt_factor_tables(Modulus, LogDim, false);
+    kernels.intt_factors = __ntt_factor_tables(Modulus, LogDim, true);
+    kernels.ntt = __preset_ntt<LogDim, Modulus>;
+    kernels.intt = __preset_intt<LogDim, Modulus>;
+    kernels.mul_mod_hybrid_lazy = __preset_mul_mod_hybrid_lazy<LogDim, Modulus>;
+    kernels.tensor_mul_mod_hybrid_lazy =
+        __preset_tensor_mul_mod_hybrid_lazy<LogDim, Modulus>;
+    kernels.sub_mul_scalar_lazy =
+        __preset_sub_mul_scalar_lazy<LogDim, Modulus>;
+    __register_preset_kernels(1ULL << LogDim, Modulus, kernels);
+}
+
+/**
+ * @brief Instantiate and register the kernels specialized for a dimension and
+ * a list of moduli, e.g. register_kernel_preset<13, q0, q1, q2>(), which is
+ * done once, typically at the start of the application. The moduli should
+ * be NTT-friendly primes for the dimension, i.e. 2N divides q - 1.
+ * @tparam LogDim Log2 of the dimension.
+ * @tparam Moduli The moduli, including the additional (special) ones.
+ */
+template <size_t LogDim, u64... Moduli> void register_kernel_preset() {
+    static_assert(LogDim >= 1 && LogDim <= 16,
+                  "The dimension of a preset should be in [2, 2^16].");
+    (__register_preset_kernels<LogDim, Moduli>(), ...);
+}
+
+} // namespace hehub
@@ -1,21 +1,34 @@
 #include "mod_arith.h"
+#include "concurrent_cache.h"
+#include "kernel_presets.h"
+#include <algorithm>
 #include <cmath>
 #include <map>
 
 namespace hehub {
 
-using MulModLUT = std::tuple<u64, u64, u64>;
-
-void batched_barrett_lazy(const u64 modulus, const size_t vec_len, u64 vec[]) {
-    u64 c = (u64)(-1) / modulus;
+template <typename Word>
+inline void __batched_barrett_lazy(const Word modulus, const size_t vec_len,
+                                   Word vec[]) {
+    using DWord = DoubleWord<Word>;
+    constexpr size_t word_bits = sizeof(Word) * 8;
+    Word c = (Word)(-1) / modulus;
     for (size_t i = 0; i < vec_len; i++) {
-        u128 a = (u128)vec[i] * c;
-        u64 approx_quotient = a >> 64;
-        u128 approx_mod_multiple = modulus * approx_quotient;
+        DWord a = (DWord)vec[i] * c;
+        Word approx_quotient = a >> word_bits;
+        DWord approx_mod_multiple = (DWord)modulus * approx_quotient;
         vec[i] -= approx_mod_multiple;
     }
 }
 
+void batched_barrett_lazy(const u64 modulus, const size_t vec_len, u64 vec[]) {
+    __batched_barrett_lazy(modulus, vec_len, vec);
+}
+
+void batched_barrett_lazy(const u32 modulus, const size_t vec_len, u32 vec[]) {
+    __batched_barrett_lazy(modulus, vec_len, vec);
+}
+
 std::tuple<i128, i128, i128> xgcd128(i128 a, i128 b) {
     int sign_a = (a < 0) ? (-1) : 1;
     a *= sign_a;
@@ -46,82 +59,221 @@ std::tuple<i128, i128, i128> xgcd128(i128 a, i128 b) {
     return std::make_tuple(sign_a * prev_x, sign_b * prev_y, a);
 }
 
+template <typename Word>
+inline Word get_inv_minus_q_mod_2toword(const Word modulus) {
+    // Newton iteration on 2-adic inverse, where each round doubles the number
+    // of correct low bits, starting from 3 bits since q * q = 1 (mod 8).
+    Word inv = modulus;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - modulus * inv;
+    }
+    return -inv;
+}
+
 inline u64 get_inv_minus_q_mod_2to64(const u64 modulus) {
-    auto tmp = std::get<1>(xgcd128((i128)1 << 64, ((i128)1 << 64) - modulus));
-    return (u64)(tmp + ((i128)1 << 64));
+    return get_inv_minus_q_mod_2toword(modulus);
 }
 
-inline u64 get_2to64_reduced(const u64 modulus) {
-    const u64 _2to64_but_one = (u64)(-1LL) % modulus;
-    return _2to64_but_one + 1;
+template <typename Word>
+inline Word get_2toword_reduced(const Word modulus) {
+    const Word _2toword_but_one = (Word)(-1) % modulus;
+    return _2toword_but_one + 1;
 }
 
-inline u64 get_2to64_harvey(const u64 modulus) {
-    const u64 _2to64_but_one_reduced = (u64)(-1LL) % modulus;
-    return (((u128)(_2to64_but_one_reduced + 1)) << 64) / modulus;
+template <typename Word> inline Word get_2toword_harvey(const Word modulus) {
+    constexpr size_t word_bits = sizeof(Word) * 8;
+    const Word _2toword_but_one_reduced = (Word)(-1) % modulus;
+    return (((DoubleWord<Word>)(_2toword_but_one_reduced + 1)) << word_bits) /
+           modulus;
+}
+
+template <typename Word>
+inline void __batched_mul_mod_hybrid_lazy(const Word modulus,
+                                          const size_t vec_len,
+                                          const Word in_vec1[],
+                                          const Word in_vec2[],
+                                          Word out_vec[]) {
+    using DWord = DoubleWord<Word>;
+    // The constants are cheap compared with a batch, and computing them here
+    // keeps the function free of shared state.
+    const Word minus_qinv = get_inv_minus_q_mod_2toword(modulus);
+    const Word _2toword_reduced = get_2toword_reduced(modulus);
+    const Word _2toword_harvey = get_2toword_harvey(modulus);
+    const size_t mshift = sizeof(Word) * 8;
+
+    for (size_t i = 0; i < vec_len; i++) {
+        // The Montgomery part
+        DWord a = (DWord)in_vec1[i] * in_vec2[i];
+        DWord u = a * minus_qinv;
+        u &= (((DWord)1 << mshift) - 1);
+        u *= modulus;
+
+        // The D. Harvey part
+        Word out_temp = (a + u) >> mshift;
+        Word out_temp2 = (DWord)out_temp * _2toword_harvey >> mshift;
+        out_vec[i] =
+            (DWord)out_temp * _2toword_reduced - (DWord)out_temp2 * modulus;
+    }
 }
 
 void batched_mul_mod_hybrid_lazy(const u64 modulus, const size_t vec_len,
                                  const u64 in_vec1[], const u64 in_vec2[],
                                  u64 out_vec[]) {
-    static std::map<u64, MulModLUT> lut_cache;
-
-    auto it = lut_cache.find(modulus);
-    if (it == lut_cache.end()) {
-        lut_cache.insert(std::make_pair(
-            modulus,
-            std::make_tuple(get_inv_minus_q_mod_2to64(modulus), get_2to64_reduced(modulus),
-                            get_2to64_harvey(modulus))));
-        it = lut_cache.find(modulus);
+    if (auto preset = __find_preset_kernels(vec_len, modulus)) {
+        preset->mul_mod_hybrid_lazy(in_vec1, in_vec2, out_vec);
+        return;
+    }
+    __batched_mul_mod_hybrid_lazy(modulus, vec_len, in_vec1, in_vec2, out_vec);
+}
+
+void batched_mul_mod_hybrid_lazy(const u32 modulus, const size_t vec_len,
+                                 const u32 in_vec1[], const u32 in_vec2[],
+                                 u32 out_vec[]) {
+    __batched_mul_mod_hybrid_lazy(modulus, vec_len, in_vec1, in_vec2, out_vec);
+}
+
+/// The reduction of batched_mul_mod_hybrid_lazy on a 128-bit input, which
+/// should be less than 2^128 - q * 2^64, with the output in [0, 2q).
+inline u64 __hybrid_reduce(const u64 modulus, const u64 minus_qinv,
+                           const u64 _2to64_reduced, const u64 _2to64_harvey,
+                           const u128 a) {
+    u128 u = (u64)((u64)a * minus_qinv);
+    u *= modulus;
+    u64 out_temp = (a + u) >> 64;
+    u64 out_temp2 = (u128)out_temp * _2to64_harvey >> 64;
+    return (u128)out_temp * _2to64_reduced - (u128)out_temp2 * modulus;
+}
+
+void batched_tensor_mul_mod_hybrid_lazy(const u64 modulus, const size_t vec_len,
+                                        const u64 a0[], const u64 a1[],
+                                        const u64 b0[], const u64 b1[],
+                                        u64 out0[], u64 out1[], u64 out2[]) {
+    if (auto preset = __find_preset_kernels(vec_len, modulus)) {
+        preset->tensor_mul_mod_hybrid_lazy(a0, a1, b0, b1, out0, out1, out2);
+        return;
     }
-    const auto [minus_qinv, _2to64_reduced, _2to64_harvey] = it->second;
-    const u64 mshift = 64;
+    const u64 minus_qinv = get_inv_minus_q_mod_2to64(modulus);
+    const u64 _2to64_reduced = get_2toword_reduced(modulus);
+    const u64 _2to64_harvey = get_2toword_harvey(modulus);
 
+    // The sum a + u of the Montgomery part stays below 2^128 for a less than
+    // 2 * (2q)^2, hence the two products of out1 are added unreduced.
+    auto reduce = [&](u128 a) {
+        return __hybrid_reduce(modulus, minus_qinv, _2to64_reduced,
+                               _2to64_harvey, a);
+    };
     for (size_t i = 0; i < vec_len; i++) {
-        // The Montgomery part
-        u128 a = (u128)in_vec1[i] * in_vec2[i];
-        u128 u = a * minus_qinv;
-        u &= (((u128)1 << mshift) - 1);
-        u *= modulus;
+        const u64 x0 = a0[i], x1 = a1[i], y0 = b0[i], y1 = b1[i];
+        out0[i] = reduce((u128)x0 * y0);
+        out1[i] = reduce((u128)x0 * y1 + (u128)x1 * y0);
+        out2[i] = reduce((u128)x1 * y1);
+    }
+}
 
-        // The D. Harvey part
-        u64 out_temp = (a + u) >> mshift;
-        u64 out_temp2 = (u128)out_temp * _2to64_harvey >> 64;
-        out_vec[i] = (u128)out_temp * _2to64_reduced - (u128)out_temp2 * modulus;
+void batched_linear_combination_lazy(const u64 modulus, const size_t vec_len,
+                                     const size_t count,
+                                     const u64 *const in_vecs[],
+                                     const u64 scalars[], u64 out_vec[]) {
+    const u64 minus_qinv = get_inv_minus_q_mod_2to64(modulus);
+    const u64 _2to64_reduced = get_2toword_reduced(modulus);
+    const u64 _2to64_harvey = get_2toword_harvey(modulus);
+    auto reduce = [&](u128 a) {
+        return __hybrid_reduce(modulus, minus_qinv, _2to64_reduced,
+                               _2to64_harvey, a);
+    };
+
+    // The hybrid reduction takes inputs below 2^128 - q * 2^64, which bounds
+    // a reduced sum in [0, 2q) plus the products in [0, 2q * (q - 1)].
+    const u128 input_bound = ~(u128)0 - ((u128)modulus << 64) - 2 * modulus;
+    const u128 product_bound = (u128)(2 * modulus) * (modulus - 1);
+    const u128 max_terms = input_bound / product_bound;
+    const size_t terms_per_reduction = (size_t)std::min(max_terms, (u128)count);
+
+    constexpr size_t block_size = 1024;
+    u128 acc[block_size];
+    for (size_t begin = 0; begin < vec_len; begin += block_size) {
+        const size_t len = std::min(block_size, vec_len - begin);
+        std::fill(acc, acc + len, 0);
+        size_t terms = 0;
+        for (size_t j = 0; j < count; j++) {
+            const u64 scalar = scalars[j];
+            if (scalar == 0) {
+                continue;
+            }
+            const auto in_vec = in_vecs[j] + begin;
+            for (size_t i = 0; i < len; i++) {
+                acc[i] += (u128)in_vec[i] * scalar;
+            }
+            if (++terms == terms_per_reduction) {
+                for (size_t i = 0; i < len; i++) {
+                    acc[i] = reduce(acc[i]);
+                }
+                terms = 0;
+            }
+        }
+        for (size_t i = 0; i < len; i++) {
+            out_vec[begin + i] = reduce(acc[i]);
+        }
+    }
+}
+
+template <typename Word>
+inline void __batched_mul_mod_barrett_lazy(const Word modulus,
+                                           const size_t vec_len,
+                                           const Word in_vec1[],
+                                           const Word in_vec2[],
+                                           Word out_vec[]) {
+    using DWord = DoubleWord<Word>;
+    constexpr size_t word_bits = sizeof(Word) * 8;
+    DWord c = (DWord)(-1) / modulus;
+    Word ch = c >> word_bits;
+    Word cl = c;
+    for (size_t i = 0; i < vec_len; i++) {
+        DWord a = (DWord)in_vec1[i] * in_vec2[i];
+        Word ah = a >> word_bits;
+        Word al = a;
+        Word ah_ch = ah * ch;
+        DWord ah_cl = (DWord)ah * cl;
+        DWord al_ch = (DWord)al * ch;
+        Word approx_quotient = ah_ch + ((ah_cl + al_ch) >> word_bits);
+        DWord approx_mod_multiple = (DWord)modulus * approx_quotient;
+        out_vec[i] = a - approx_mod_multiple;
     }
 }
 
 void batched_mul_mod_barrett_lazy(const u64 modulus, const size_t vec_len,
                                   const u64 in_vec1[], const u64 in_vec2[],
                                   u64 out_vec[]) {
-    u128 c = (u128)(-1) / modulus;
-    u64 ch = c >> 64;
-    u64 cl = c;
+    __batched_mul_mod_barrett_lazy(modulus, vec_len, in_vec1, in_vec2,
+                                   out_vec);
+}
+
+void batched_mul_mod_barrett_lazy(const u32 modulus, const size_t vec_len,
+                                  const u32 in_vec1[], const u32 in_vec2[],
+                                  u32 out_vec[]) {
+    __batched_mul_mod_barrett_lazy(modulus, vec_len, in_vec1, in_vec2,
+                                   out_vec);
+}
+
+void batched_sub_mul_scalar_lazy(const u64 modulus, const size_t vec_len,
+                                 u64 vec[], const u64 sub_vec[],
+                                 const u64 scalar) {
+    const u64 scalar_harvey = ((u128)scalar << 64) / modulus;
+    if (auto preset = __find_preset_kernels(vec_len, modulus)) {
+        preset->sub_mul_scalar_lazy(vec, sub_vec, scalar, scalar_harvey);
+        return;
+    }
+    const u64 modulus_doubled = 2 * modulus;
     for (size_t i = 0; i < vec_len; i++) {
-        u128 a = (u128)in_vec1[i] * in_vec2[i];
-        u64 ah = a >> 64;
-        u64 al = a;
-        u64 ah_ch = ah * ch;
-        u128 ah_cl = (u128)ah * cl;
-        u128 al_ch = (u128)al * ch;
-        u64 approx_quotient = ah_ch + ((ah_cl + al_ch) >> 64);
-        u128 approx_mod_multiple = (u128)modulus * approx_quotient;
-        out_vec[i] = a - approx_mod_multiple;
+        vec[i] = mul_mod_harvey_lazy(modulus,
+                                     vec[i] + modulus_doubled - sub_vec[i],
+                                     scalar, scalar_harvey);
     }
 }
 
 void batched_montgomery_128_lazy(const u64 modulus, const size_t len,
                                  const u128 in[], u64 out[]) {
-    static std::map<u64, u64> minus_q_inv_lut;
-    u64 minus_q_inv;
-
-    auto it = minus_q_inv_lut.find(modulus);
-    if (it == minus_q_inv_lut.end()) {
-        minus_q_inv = get_inv_minus_q_mod_2to64(modulus);
-        minus_q_inv_lut.insert(std::make_pair(modulus, minus_q_inv));
-    } else {
-        minus_q_inv = it->second;
-    }
+    const u64 minus_q_inv = get_inv_minus_q_mod_2to64(modulus);
 
     for (int i = 0; i < len; i++) {
         u128 a = in[i];
@@ -133,19 +285,17 @@ void batched_montgomery_128_lazy(const u64 modulus, const size_t len,
     }
 }
 
-std::map<std::pair<u64, u64>, u64> modular_inverse_table;
+static ConcurrentCache<std::pair<u64, u64>, u64> modular_inverse_table;
 
 u64 inverse_mod_prime(const u64 elem, const u64 prime) {
-    auto it = modular_inverse_table.find(std::make_pair(elem, prime));
-    if (it != modular_inverse_table.end()) {
-        return it->second;
-    } else {
-        auto result = std::get<1>(xgcd128((i128)prime, (i128)elem));
-        if (result < 0) { result += prime; }
-        modular_inverse_table.insert(
-            std::make_pair(std::make_pair(elem, prime), result));
-        return result;
-    }
+    return modular_inverse_table.find_or_create(
+        std::make_pair(elem, prime), [&]() {
+            auto result = std::get<1>(xgcd128((i128)prime, (i128)elem));
+            if (result < 0) {
+                result += prime;
+            }
+            return (u64)result;
+        });
 }
 
 } // namespace hehub
@@ -13,10 +13,19 @@
 
 namespace hehub {
 
+/*
+ * The batched kernels are provided for 64-bit words, and for 32-bit words
+ * which take half of the memory traffic, for the moduli less than 2^30. The
+ * lazy results are in [0, 2 * modulus).
+ */
+
 void batched_barrett_lazy(const u64 modulus, const size_t vec_len, u64 vec[]);
 
-inline void batched_barrett(const u64 modulus, const size_t vec_len,
-                            u64 vec[]) {
+void batched_barrett_lazy(const u32 modulus, const size_t vec_len, u32 vec[]);
+
+template <typename Word>
+inline void batched_barrett(const Word modulus, const size_t vec_len,
+                            Word vec[]) {
     batched_barrett_lazy(modulus, vec_len, vec);
 
     for (size_t i = 0; i < vec_len; i++) {
@@ -28,9 +37,14 @@ void batched_mul_mod_hybrid_lazy(const u64 modulus, const size_t vec_len,
                                  const u64 in_vec1[], const u64 in_vec2[],
                                  u64 out_vec[]);
 
-inline void batched_mul_mod_hybrid(const u64 modulus, const size_t vec_len,
-                                   const u64 in_vec1[], const u64 in_vec2[],
-                                   u64 out_vec[]) {
+void batched_mul_mod_hybrid_lazy(const u32 modulus, const size_t vec_len,
+                                 const u32 in_vec1[], const u32 in_vec2[],
+                                 u32 out_vec[]);
+
+template <typename Word>
+inline void batched_mul_mod_hybrid(const Word modulus, const size_t vec_len,
+                                   const Word in_vec1[], const Word in_vec2[],
+                                   Word out_vec[]) {
     batched_mul_mod_hybrid_lazy(modulus, vec_len, in_vec1, in_vec2, out_vec);
 
     for (size_t i = 0; i < vec_len; i++) {
@@ -38,13 +52,53 @@ inline void batched_mul_mod_hybrid(const u64 modulus, const size_t vec_len,
     }
 }
 
+/**
+ * @brief The tensor product of two pairs of vectors, i.e. out0 = a0 * b0,
+ * out1 = a0 * b1 + a1 * b0 and out2 = a1 * b1 mod q, as in the multiplication
+ * of two ciphertexts. Each input is read once, and the two products of out1
+ * are accumulated in 128 bits before one reduction, which is the same hybrid
+ * reduction as batched_mul_mod_hybrid_lazy.
+ * @param modulus The modulus q, less than 2^62.
+ * @param vec_len The length of the vectors.
+ * @param a0, a1, b0, b1 The inputs in [0, 2q).
+ * @param out0, out1, out2 The outputs in [0, 2q), which should not overlap
+ * the inputs.
+ */
+void batched_tensor_mul_mod_hybrid_lazy(const u64 modulus, const size_t vec_len,
+                                        const u64 a0[], const u64 a1[],
+                                        const u64 b0[], const u64 b1[],
+                                        u64 out0[], u64 out1[], u64 out2[]);
+
+/**
+ * @brief Compute out[i] = sum_j in_vecs[j][i] * scalars[j] mod q, where the
+ * products are accumulated in 128 bits and reduced by the hybrid reduction
+ * only when the sum might overflow, i.e. once per few terms for 62-bit moduli
+ * and once in the end for small ones. The vectors are swept by blocks, whose
+ * accumulators stay in cache.
+ * @param modulus The modulus q, less than 2^62.
+ * @param vec_len The length of the vectors.
+ * @param count The number of the terms.
+ * @param in_vecs The vectors in [0, 2q).
+ * @param scalars The scalars in [0, q), where the zero ones are skipped.
+ * @param out_vec The sums in [0, 2q).
+ */
+void batched_linear_combination_lazy(const u64 modulus, const size_t vec_len,
+                                     const size_t count,
+                                     const u64 *const in_vecs[],
+                                     const u64 scalars[], u64 out_vec[]);
+
 void batched_mul_mod_barrett_lazy(const u64 modulus, const size_t vec_len,
                                   const u64 in_vec1[], const u64 in_vec2[],
                                   u64 out_vec[]);
 
-inline void batched_mul_mod_barrett(const u64 modulus, const size_t vec_len,
-                                    const u64 in_vec1[], const u64 in_vec2[],
-                                    u64 out_vec[]) {
+void batched_mul_mod_barrett_lazy(const u32 modulus, const size_t vec_len,
+                                  const u32 in_vec1[], const u32 in_vec2[],
+                                  u32 out_vec[]);
+
+template <typename Word>
+inline void batched_mul_mod_barrett(const Word modulus, const size_t vec_len,
+                                    const Word in_vec1[], const Word in_vec2[],
+                                    Word out_vec[]) {
     batched_mul_mod_barrett_lazy(modulus, vec_len, in_vec1, in_vec2, out_vec);
 
     for (size_t i = 0; i < vec_len; i++) {
@@ -52,23 +106,47 @@ inline void batched_mul_mod_barrett(const u64 modulus, const size_t vec_len,
     }
 }
 
+/**
+ * @brief Compute vec[i] = (vec[i] - sub_vec[i]) * scalar mod q, as done when
+ * dropping a prime by rescaling.
+ * @param modulus The modulus q, less than 2^62.
+ * @param vec_len The length of the vectors.
+ * @param vec The minuends in [0, 2q), which are replaced by the results in
+ * [0, 2q).
+ * @param sub_vec The subtrahends in [0, 2q).
+ * @param scalar The multiplier in [0, q).
+ */
+void batched_sub_mul_scalar_lazy(const u64 modulus, const size_t vec_len,
+                                 u64 vec[], const u64 sub_vec[],
+                                 const u64 scalar);
+
 void batched_montgomery_128_lazy(const u64 modulus, const size_t len,
                                  const u128 in[], u64 out[]);
 
-inline void batched_reduce_strict(const u64 modulus, const size_t vec_len,
-                                  u64 vec[]) {
+template <typename Word>
+inline void batched_reduce_strict(const Word modulus, const size_t vec_len,
+                                  Word vec[]) {
     for (size_t i = 0; i < vec_len; i++) {
         vec[i] -= (vec[i] >= modulus) ? modulus : 0;
     }
 }
 
-inline void reduce_strict(RnsPolynomial &rns_poly) {
-    const auto &moduli = rns_poly.modulus_vec();
-    const auto dimension = rns_poly.dimension();
+/// @brief Reduce the values of the components in a view from [0, 2q) to
+/// [0, q).
+inline void reduce_strict(RnsPolyView view) {
+    for (size_t k = 0; k < view.component_count(); k++) {
+        batched_reduce_strict(view.modulus_at(k), view.dimension(), view[k]);
+    }
+}
 
-    for (auto [component, modulus] : ranges::views::zip(rns_poly, moduli)) {
-        batched_reduce_strict(modulus, dimension, component.data());
+/// @brief Reduce the values of a polynomial to [0, q), which is skipped if they
+/// are already reduced as its value bound indicates.
+inline void reduce_strict(RnsPolynomial &rns_poly) {
+    if (rns_poly.value_bound == PolyValueBound::q) {
+        return;
     }
+    reduce_strict(RnsPolyView(rns_poly));
+    rns_poly.value_bound = PolyValueBound::q;
 }
 
 inline u64 mul_mod_harvey_lazy(const u64 modulus, const u64 in1, const u64 in2,
@@ -77,8 +155,19 @@ inline u64 mul_mod_harvey_lazy(const u64 modulus, const u64 in1, const u64 in2,
     return (u128)in1 * in2 - (u128)approx_quotient * modulus;
 }
 
-extern std::map<std::pair<u64, u64>, u64> modular_inverse_table;
+inline u32 mul_mod_harvey_lazy(const u32 modulus, const u32 in1, const u32 in2,
+                               const u32 in2_harvey) {
+    u32 approx_quotient = (u64)in1 * in2_harvey >> 32;
+    return (u64)in1 * in2 - (u64)approx_quotient * modulus;
+}
 
+/**
+ * @brief Compute the inverse of elem modulo a prime. Results are cached in a
+ * table shared by all threads.
+ * @param elem The element to invert, which should be nonzero modulo prime.
+ * @param prime The prime modulus.
+ * @return u64
+ */
 u64 inverse_mod_prime(const u64 elem, const u64 prime);
 
 } // namespace hehub
@@ -1,8 +1,16 @@
 #include "ntt.h"
+#include "concurrent_cache.h"
+#include "kernel_presets.h"
 #include "mod_arith.h"
 #include "permutation.h"
+#include "profiling.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cmath>
 #include <map>
+#include <tuple>
+#include <type_traits>
 
 namespace hehub {
 
@@ -38,13 +46,35 @@ u64 __get_2nth_unity_root(u64 modulus, u64 n) {
     return root;
 }
 
-struct NTTFactors {
-    NTTFactors(u64 modulus, size_t log_dimension, bool for_inverse = false) {
-        const size_t log_modulus = (u64)(log2(modulus) + 0.5);
-        if (log_modulus > 59) {
-            throw std::invalid_argument(
-                "NTT not supporting primes with bit size > 59 currently.");
-        }
+/// The bound of the primes for the NTT on a word, i.e. the larger primes are
+/// handled by the butterflies keeping the values in [0, 4 * modulus).
+template <typename Word>
+constexpr Word NTT_MODULUS_BOUND = (Word)1 << (sizeof(Word) * 8 - 2);
+
+inline size_t __log_modulus(const u64 modulus) {
+    return (u64)(log2(modulus) + 0.5);
+}
+
+template <typename Word> inline bool __ntt_values_growing(const Word modulus) {
+    return __log_modulus(modulus) <= NTT_MAX_GROWING_LOG_MODULUS<Word>;
+}
+
+template <typename Word> inline void __check_ntt_modulus(const Word modulus) {
+    if (modulus >= NTT_MODULUS_BOUND<Word>) {
+        throw std::invalid_argument(
+            "NTT not supporting primes with bit size > " +
+            std::to_string(sizeof(Word) * 8 - 2) + " currently.");
+    }
+}
+
+/// The factor for Harvey's multiplication, i.e. floor(w * 2^bits / q).
+template <typename Word> inline Word __harvey(const Word w, const Word modulus) {
+    return ((DoubleWord<Word>)w << (sizeof(Word) * 8)) / modulus;
+}
+
+template <typename Word> struct NTTFactors {
+    NTTFactors(Word modulus, size_t log_dimension, bool for_inverse = false) {
+        __check_ntt_modulus(modulus);
         size_t dimension = 1 << log_dimension;
 
         const u64 root_of_2nth = __get_2nth_unity_root(modulus, dimension);
@@ -54,7 +84,7 @@ struct NTTFactors {
             for (size_t i = 0; i < dimension; i++) {
                 seq[i] = __pow_mod(modulus, root_of_2nth,
                                    __bit_rev_naive_16(i, log_dimension));
-                seq_harvey[i] = ((u128)seq[i] << 64) / modulus;
+                seq_harvey[i] = harvey(seq[i], modulus);
             }
         } else {
             seq.resize(dimension * 2);
@@ -69,19 +99,19 @@ struct NTTFactors {
                     seq[idx] =
                         __pow_mod(modulus, root_of_2nth_inv,
                                   __bit_rev_naive_16(i, l) * power_index_factor);
-                    seq_harvey[idx] = ((u128)seq[idx] << 64) / modulus;
+                    seq_harvey[idx] = harvey(seq[idx], modulus);
                 }
             }
-            const u64 dimension_inv = modulus - ((modulus - 1) >> log_dimension);
-            const u64 dimension_inv_harvey =
-                ((u128)dimension_inv << 64) / modulus;
+            const Word dimension_inv =
+                modulus - ((modulus - 1) >> log_dimension);
+            const Word dimension_inv_harvey = harvey(dimension_inv, modulus);
             for (size_t i = 0; i < dimension; i++) {
-                auto temp = __pow_mod(modulus, root_of_2nth_inv, i);
+                Word temp = __pow_mod(modulus, root_of_2nth_inv, i);
                 auto idx = i + dimension;
                 seq[idx] = mul_mod_harvey_lazy(modulus, temp, dimension_inv,
                                                dimension_inv_harvey);
                 seq[idx] -= (seq[idx] >= modulus) ? modulus : 0;
-                seq_harvey[idx] = ((u128)seq[idx] << 64) / modulus;
+                seq_harvey[idx] = harvey(seq[idx], modulus);
             }
 
             shuffled_indices.resize(dimension);
@@ -97,136 +127,858 @@ struct NTTFactors {
 
     ~NTTFactors() {}
 
-    std::vector<u64> seq;
+    static Word harvey(const Word w, const Word modulus) {
+        return __harvey(w, modulus);
+    }
 
-    std::vector<u64> seq_harvey;
+    std::vector<Word> seq;
+
+    std::vector<Word> seq_harvey;
 
     std::vector<size_t> shuffled_indices;
 };
 
-std::map<std::pair<u64, u64>, NTTFactors> &ntt_factors_cache() {
-    static std::map<std::pair<u64, u64>, NTTFactors> global_ntt_factors_cache;
+template <typename Word>
+using NTTFactorsCache =
+    ConcurrentCache<std::pair<u64, u64>, NTTFactors<Word>>;
+
+template <typename Word> NTTFactorsCache<Word> &ntt_factors_cache() {
+    static NTTFactorsCache<Word> global_ntt_factors_cache;
     return global_ntt_factors_cache;
 }
 
-std::map<std::pair<u64, u64>, NTTFactors> &intt_factors_cache() {
-    static std::map<std::pair<u64, u64>, NTTFactors> global_intt_factors_cache;
+template <typename Word> NTTFactorsCache<Word> &intt_factors_cache() {
+    static NTTFactorsCache<Word> global_intt_factors_cache;
     return global_intt_factors_cache;
 }
 
+template <typename Word>
 inline const auto &
-__find_or_create_ntt_factors(const u64 modulus, const size_t log_dimension,
+__find_or_create_ntt_factors(const Word modulus, const size_t log_dimension,
                              const bool for_inverse = false) {
-    if (!for_inverse) {
-        auto it =
-            ntt_factors_cache().find(std::make_pair(modulus, log_dimension));
-        if (it == ntt_factors_cache().end()) {
-            ntt_factors_cache().insert(
-                std::make_pair(std::make_pair(modulus, log_dimension),
-                               NTTFactors(modulus, log_dimension)));
-            it =
-                ntt_factors_cache().find(std::make_pair(modulus, log_dimension));
-        }
-        return it->second;
-    } else {
-        auto it =
-            intt_factors_cache().find(std::make_pair(modulus, log_dimension));
-        if (it == intt_factors_cache().end()) {
-            intt_factors_cache().insert(
-                std::make_pair(std::make_pair(modulus, log_dimension),
-                               NTTFactors(modulus, log_dimension, true)));
-            it = intt_factors_cache().find(
-                std::make_pair(modulus, log_dimension));
+    auto &cache = for_inverse ? intt_factors_cache<Word>()
+                              : ntt_factors_cache<Word>();
+    return cache.find_or_create(std::make_pair(modulus, log_dimension), [&]() {
+        return NTTFactors<Word>(modulus, log_dimension, for_inverse);
+    });
+}
+
+/**
+ * The factors of both the NTT and the INTT in the compact storage, which are
+ * the first half of NTTFactors::seq, i.e. seq[i] = psi^bitrev(i) for i < N/2.
+ * The factors of the last NTT level are generated as seq[N/2 + i] = psi *
+ * seq[i], and the INTT takes the Gentleman-Sande butterflies on the values in
+ * the order of the NTT outputs, whose factors at the level of m blocks are
+ * 1 / seq[m + i] = -seq[2m - 1 - i], hence no index table is needed.
+ */
+template <typename Word> struct CompactNTTFactors {
+    CompactNTTFactors(Word modulus, size_t log_dimension) {
+        __check_ntt_modulus(modulus);
+        const size_t dimension = 1ULL << log_dimension;
+
+        const Word root_of_2nth = __get_2nth_unity_root(modulus, dimension);
+        seq.resize(dimension / 2);
+        seq_harvey.resize(dimension / 2);
+        for (size_t i = 0; i < dimension / 2; i++) {
+            seq[i] = __pow_mod(modulus, root_of_2nth,
+                               __bit_rev_naive_16(i, log_dimension));
+            seq_harvey[i] = __harvey(seq[i], modulus);
         }
-        return it->second;
+        psi = root_of_2nth;
+        psi_harvey = __harvey(psi, modulus);
+
+        dimension_inv = modulus - ((modulus - 1) >> log_dimension);
+        dimension_inv_harvey = __harvey(dimension_inv, modulus);
+        last_factor = (u128)__pow_mod(modulus, root_of_2nth, dimension / 2) *
+                      dimension_inv % modulus;
+        last_factor_harvey = __harvey(last_factor, modulus);
     }
+
+    std::vector<Word> seq;
+
+    std::vector<Word> seq_harvey;
+
+    Word psi;
+
+    Word psi_harvey;
+
+    /// 1 / N, which the INTT multiplies in its last level.
+    Word dimension_inv;
+
+    Word dimension_inv_harvey;
+
+    /// The factor of the last INTT level, i.e. psi^(N/2) / N.
+    Word last_factor;
+
+    Word last_factor_harvey;
+};
+
+template <typename Word>
+using CompactNTTFactorsCache =
+    ConcurrentCache<std::pair<u64, u64>, CompactNTTFactors<Word>>;
+
+template <typename Word>
+CompactNTTFactorsCache<Word> &compact_ntt_factors_cache() {
+    static CompactNTTFactorsCache<Word> global_compact_ntt_factors_cache;
+    return global_compact_ntt_factors_cache;
 }
 
-void ntt_negacyclic_inplace_lazy(const size_t log_dimension, const u64 modulus,
-                                 u64 coeffs[]) {
+template <typename Word>
+inline const auto &
+__find_or_create_compact_ntt_factors(const Word modulus,
+                                     const size_t log_dimension) {
+    return compact_ntt_factors_cache<Word>().find_or_create(
+        std::make_pair(modulus, log_dimension), [&]() {
+            return CompactNTTFactors<Word>(modulus, log_dimension);
+        });
+}
+
+static std::atomic<NTTFactorStorage> __ntt_factor_storage{
+    NTTFactorStorage::full};
+
+void set_ntt_factor_storage(NTTFactorStorage storage) {
+    __ntt_factor_storage.store(storage, std::memory_order_relaxed);
+}
+
+NTTFactorStorage ntt_factor_storage() {
+    return __ntt_factor_storage.load(std::memory_order_relaxed);
+}
+
+inline bool __compact_ntt_factors() {
+    return ntt_factor_storage() == NTTFactorStorage::compact;
+}
+
+size_t ntt_factor_bytes(const size_t log_dimension,
+                        const NTTFactorStorage storage) {
     const size_t dimension = 1ULL << log_dimension;
-    // generate or read from cache
-    const auto &ntt_factors =
-        __find_or_create_ntt_factors(modulus, log_dimension);
+    if (storage == NTTFactorStorage::compact) {
+        return dimension * sizeof(u64) + 6 * sizeof(u64);
+    }
+    // seq and seq_harvey of N words for the NTT and of 2N words for the INTT,
+    // and the shuffled indices
+    return 6 * dimension * sizeof(u64) + dimension * sizeof(size_t);
+}
 
+/// The butterflies of the NTT (or of the INTT on shuffled values), where idx
+/// is the index of the first factor. If not Growing, the inputs of each
+/// butterfly are reduced to keep the values in [0, 4 * modulus), which is
+/// required by the primes larger than NTT_MAX_GROWING_LOG_MODULUS bits.
+template <bool Growing, typename Word>
+inline void __butterflies(const size_t log_dimension, const Word modulus,
+                          const NTTFactors<Word> &factors, size_t idx,
+                          Word data[]) {
+    const size_t dimension = 1ULL << log_dimension;
+    const Word modulus_doubled = 2 * modulus;
     size_t level, start, data_step, h, l;
-    size_t idx = 1;
-    u64 temp, zeta, zeta_harvey;
+    Word temp, zeta, zeta_harvey;
     for (level = 1, data_step = dimension; level <= log_dimension;
          level++, data_step >>= 1) {
         auto gap = data_step / 2;
         for (start = 0; start < dimension; start += data_step, idx++) {
-            zeta = ntt_factors.seq[idx];
-            zeta_harvey = ntt_factors.seq_harvey[idx];
+            zeta = factors.seq[idx];
+            zeta_harvey = factors.seq_harvey[idx];
             for (l = start; l < start + gap; l++) {
                 h = l + gap;
-                temp =
-                    mul_mod_harvey_lazy(modulus, coeffs[h], zeta, zeta_harvey);
-                coeffs[h] = coeffs[l] + 2 * modulus - temp;
-                coeffs[l] = coeffs[l] + temp;
+                Word low = data[l];
+                if (!Growing) {
+                    low -= modulus_doubled & -(Word)(low >= modulus_doubled);
+                }
+                temp = mul_mod_harvey_lazy(modulus, data[h], zeta, zeta_harvey);
+                data[h] = low + modulus_doubled - temp;
+                data[l] = low + temp;
             }
         }
     }
+}
 
-    const u64 log_modulus = (u64)(log2(modulus) + 0.5);
-    const u64 div_fix = (modulus >= (1ULL << log_modulus)) ? 1 : 0;
+/// The NTT butterflies with the compact factors, see __butterflies(), where
+/// the factors of the last level are applied by two multiplications.
+template <bool Growing, typename Word>
+inline void __compact_butterflies(const size_t log_dimension, const Word modulus,
+                                  const CompactNTTFactors<Word> &factors,
+                                  Word data[]) {
+    const size_t half = (1ULL << log_dimension) / 2;
+    const Word modulus_doubled = 2 * modulus;
+    const auto seq = factors.seq.data();
+    const auto seq_harvey = factors.seq_harvey.data();
+    for (size_t m = 1, gap = half; m < half; m *= 2, gap /= 2) {
+        for (size_t i = 0; i < m; i++) {
+            const auto zeta = seq[m + i];
+            const auto zeta_harvey = seq_harvey[m + i];
+            const auto low = data + 2 * gap * i;
+            const auto high = low + gap;
+            for (size_t j = 0; j < gap; j++) {
+                Word low_value = low[j];
+                if (!Growing) {
+                    low_value -=
+                        modulus_doubled & -(Word)(low_value >= modulus_doubled);
+                }
+                auto temp =
+                    mul_mod_harvey_lazy(modulus, high[j], zeta, zeta_harvey);
+                high[j] = low_value + modulus_doubled - temp;
+                low[j] = low_value + temp;
+            }
+        }
+    }
+
+    // the last level, whose factors are psi * seq[i]
+    for (size_t i = 0; i < half; i++) {
+        Word low_value = data[2 * i];
+        if (!Growing) {
+            low_value -= modulus_doubled & -(Word)(low_value >= modulus_doubled);
+        }
+        auto temp = mul_mod_harvey_lazy(modulus, data[2 * i + 1], seq[i],
+                                        seq_harvey[i]);
+        temp = mul_mod_harvey_lazy(modulus, temp, factors.psi,
+                                   factors.psi_harvey);
+        data[2 * i + 1] = low_value + modulus_doubled - temp;
+        data[2 * i] = low_value + temp;
+    }
+}
+
+/// The INTT with the compact factors, taking the Gentleman-Sande butterflies
+/// (a, b) -> (a + b, (b - a) * seq[2m - 1 - i]), which keep the values in
+/// [0, 2 * modulus) for the inputs in [0, 2 * modulus).
+template <typename Word>
+inline void __intt_negacyclic_inplace_lazy_compact(const size_t log_dimension,
+                                                   const Word modulus,
+                                                   Word values[]) {
+    const auto &factors =
+        __find_or_create_compact_ntt_factors(modulus, log_dimension);
+    const size_t half = (1ULL << log_dimension) / 2;
+    const Word modulus_doubled = 2 * modulus;
+    const auto seq = factors.seq.data();
+    const auto seq_harvey = factors.seq_harvey.data();
+
+    // the first level, whose factors are those of the last NTT level
+    if (half > 1) {
+        for (size_t i = 0; i < half; i++) {
+            const Word low = values[2 * i];
+            const Word high = values[2 * i + 1];
+            Word sum = low + high;
+            sum -= modulus_doubled & -(Word)(sum >= modulus_doubled);
+            const auto idx = half - 1 - i;
+            auto temp = mul_mod_harvey_lazy(modulus, high + modulus_doubled - low,
+                                            seq[idx], seq_harvey[idx]);
+            values[2 * i + 1] = mul_mod_harvey_lazy(modulus, temp, factors.psi,
+                                                    factors.psi_harvey);
+            values[2 * i] = sum;
+        }
+    }
+
+    for (size_t m = half / 2, gap = 2; m > 1; m /= 2, gap *= 2) {
+        for (size_t i = 0; i < m; i++) {
+            const auto zeta = seq[2 * m - 1 - i];
+            const auto zeta_harvey = seq_harvey[2 * m - 1 - i];
+            const auto low = values + 2 * gap * i;
+            const auto high = low + gap;
+            for (size_t j = 0; j < gap; j++) {
+                Word sum = low[j] + high[j];
+                sum -= modulus_doubled & -(Word)(sum >= modulus_doubled);
+                high[j] = mul_mod_harvey_lazy(
+                    modulus, high[j] + modulus_doubled - low[j], zeta,
+                    zeta_harvey);
+                low[j] = sum;
+            }
+        }
+    }
+
+    // the last level, where 1 / N is multiplied
+    for (size_t j = 0; j < half; j++) {
+        const Word low = values[j];
+        const Word high = values[j + half];
+        values[j] = mul_mod_harvey_lazy(modulus, low + high,
+                                        factors.dimension_inv,
+                                        factors.dimension_inv_harvey);
+        values[j + half] = mul_mod_harvey_lazy(
+            modulus, high + modulus_doubled - low, factors.last_factor,
+            factors.last_factor_harvey);
+    }
+}
+
+template <typename Word>
+inline void __ntt_negacyclic_inplace_lazy(const size_t log_dimension,
+                                          const Word modulus, Word coeffs[]) {
+    const size_t dimension = 1ULL << log_dimension;
+    HEHUB_PROFILE_SCOPE(ntt, dimension * sizeof(Word));
+    // generate or read from cache
+    if constexpr (std::is_same_v<Word, u64>) {
+        if (auto preset = __find_preset_kernels(dimension, modulus)) {
+            preset->ntt(*preset, coeffs);
+            return;
+        }
+    }
+    auto butterflies = [&](auto growing) {
+        if (__compact_ntt_factors()) {
+            __compact_butterflies<decltype(growing)::value>(
+                log_dimension, modulus,
+                __find_or_create_compact_ntt_factors(modulus, log_dimension),
+                coeffs);
+        } else {
+            __butterflies<decltype(growing)::value>(
+                log_dimension, modulus,
+                __find_or_create_ntt_factors(modulus, log_dimension), 1,
+                coeffs);
+        }
+    };
+
+    if (!__ntt_values_growing(modulus)) {
+        butterflies(std::false_type());
+        const Word modulus_doubled = 2 * modulus;
+        for (size_t i = 0; i < dimension; i++) {
+            coeffs[i] -= (coeffs[i] >= modulus_doubled) ? modulus_doubled : 0;
+        }
+        return;
+    }
+
+    butterflies(std::true_type());
+
+    const Word log_modulus = __log_modulus(modulus);
+    const Word div_fix = (modulus >= ((Word)1 << log_modulus)) ? 1 : 0;
     for (size_t i = 0; i < dimension; i++) {
         coeffs[i] -= ((coeffs[i] >> log_modulus) - div_fix) * modulus;
     }
 }
 
-void intt_negacyclic_inplace_lazy(const size_t log_dimension, const u64 modulus,
-                                  u64 values[]) {
+void ntt_negacyclic_inplace_lazy(const size_t log_dimension, const u64 modulus,
+                                 u64 coeffs[]) {
+    __ntt_negacyclic_inplace_lazy(log_dimension, modulus, coeffs);
+}
+
+void ntt_negacyclic_inplace_lazy(const size_t log_dimension, const u32 modulus,
+                                 u32 coeffs[]) {
+    __ntt_negacyclic_inplace_lazy(log_dimension, modulus, coeffs);
+}
+
+template <typename Word>
+inline void __intt_negacyclic_inplace_lazy(const size_t log_dimension,
+                                           const Word modulus, Word values[]) {
     const size_t dimension = 1ULL << log_dimension;
+    HEHUB_PROFILE_SCOPE(intt, dimension * sizeof(Word));
     // generate or read from cache
+    if constexpr (std::is_same_v<Word, u64>) {
+        if (auto preset = __find_preset_kernels(dimension, modulus)) {
+            preset->intt(*preset, values);
+            return;
+        }
+    }
+    if (__compact_ntt_factors()) {
+        __intt_negacyclic_inplace_lazy_compact(log_dimension, modulus, values);
+        return;
+    }
     const auto &intt_factors =
         __find_or_create_ntt_factors(modulus, log_dimension, true);
 
-    u64 values_shuffled[dimension];
+    Word values_shuffled[dimension];
     const auto &shuffled_indices = intt_factors.shuffled_indices;
     for (size_t i = 0; i < dimension; i++) {
         values_shuffled[i] = values[shuffled_indices[i]];
     }
 
-    size_t level, start, data_step, h, l;
-    size_t idx = 0;
-    u64 temp, zeta, zeta_harvey;
-    for (level = 1, data_step = dimension; level <= log_dimension;
-         level++, data_step >>= 1) {
-        auto gap = data_step / 2;
-        for (start = 0; start < dimension; start += data_step, idx++) {
-            zeta = intt_factors.seq[idx];
-            zeta_harvey = intt_factors.seq_harvey[idx];
-            for (l = start; l < start + gap; l++) {
-                h = l + gap;
-                temp = mul_mod_harvey_lazy(modulus, values_shuffled[h], zeta,
-                                           zeta_harvey);
-                values_shuffled[h] = values_shuffled[l] + 2 * modulus - temp;
-                values_shuffled[l] = values_shuffled[l] + temp;
+    const bool growing = __ntt_values_growing(modulus);
+    if (growing) {
+        __butterflies<true>(log_dimension, modulus, intt_factors, 0,
+                            values_shuffled);
+    } else {
+        __butterflies<false>(log_dimension, modulus, intt_factors, 0,
+                             values_shuffled);
+    }
+
+    for (size_t i = 0; i < dimension; i++) {
+        values[i] = values_shuffled[shuffled_indices[i]];
+    }
+
+    // the factors of the last step follow those of the butterflies, which
+    // take any word as the input
+    const Word log_modulus = __log_modulus(modulus);
+    const Word div_fix = (modulus >= ((Word)1 << log_modulus)) ? 1 : 0;
+    size_t idx = dimension;
+    for (size_t i = 0; i < dimension; i++, idx++) {
+        if (growing) {
+            values[i] -= ((values[i] >> log_modulus) - div_fix) * modulus;
+        }
+        values[i] =
+            mul_mod_harvey_lazy(modulus, values[i], intt_factors.seq[idx],
+                                intt_factors.seq_harvey[idx]);
+    }
+}
+
+void intt_negacyclic_inplace_lazy(const size_t log_dimension, const u64 modulus,
+                                  u64 values[]) {
+    __intt_negacyclic_inplace_lazy(log_dimension, modulus, values);
+}
+
+void intt_negacyclic_inplace_lazy(const size_t log_dimension, const u32 modulus,
+                                  u32 values[]) {
+    __intt_negacyclic_inplace_lazy(log_dimension, modulus, values);
+}
+
+/**
+ * The butterflies of the NTT (or of the INTT on shuffled values) skipping the
+ * zeros and the unneeded outputs, where idx is the index of the first factor.
+ * The input is nonzero only in [0, nonzero_block) and at the multiples of the
+ * stride, both being powers of 2 with stride <= nonzero_block, and only the
+ * outputs in [output_begin, output_end) are computed.
+ *
+ * The levels with gap >= nonzero_block only copy the block [0, nonzero_block)
+ * to the others, as the high inputs are zero. Likewise the levels with gap <
+ * stride only copy the values at the multiples of the stride to the others.
+ * A block of a level affects only the outputs inside it, hence the blocks
+ * outside the output range are skipped.
+ */
+template <bool Growing, typename Word>
+inline void __sparse_butterflies(const size_t log_dimension, const Word modulus,
+                                 const NTTFactors<Word> &factors,
+                                 const size_t idx, const size_t nonzero_block,
+                                 const size_t stride, const size_t output_begin,
+                                 const size_t output_end, Word data[]) {
+    const size_t dimension = 1ULL << log_dimension;
+    const Word modulus_doubled = 2 * modulus;
+    auto block_needed = [&](size_t start, size_t block_size) {
+        return start < output_end && start + block_size > output_begin;
+    };
+
+    for (size_t start = nonzero_block; start < dimension;
+         start += nonzero_block) {
+        if (block_needed(start, nonzero_block)) {
+            std::copy(data, data + nonzero_block, data + start);
+        }
+    }
+
+    for (size_t data_step = nonzero_block; data_step > stride;
+         data_step >>= 1) {
+        const auto gap = data_step / 2;
+        // the factors of this level start after those of the block count
+        const auto level_idx = idx + dimension / data_step - 1;
+        for (size_t start = 0; start < dimension; start += data_step) {
+            if (!block_needed(start, data_step)) {
+                continue;
+            }
+            const auto zeta = factors.seq[level_idx + start / data_step];
+            const auto zeta_harvey =
+                factors.seq_harvey[level_idx + start / data_step];
+            for (size_t l = start; l < start + gap; l += stride) {
+                auto h = l + gap;
+                Word low = data[l];
+                if (!Growing) {
+                    low -= modulus_doubled & -(Word)(low >= modulus_doubled);
+                }
+                auto temp =
+                    mul_mod_harvey_lazy(modulus, data[h], zeta, zeta_harvey);
+                data[h] = low + modulus_doubled - temp;
+                data[l] = low + temp;
+            }
+        }
+    }
+
+    if (stride > 1) {
+        for (size_t start = 0; start < dimension; start += stride) {
+            if (block_needed(start, stride)) {
+                std::fill(data + start + 1, data + start + stride, data[start]);
             }
         }
     }
+}
+
+inline size_t __ceil_pow2(size_t n) {
+    size_t pow2 = 1;
+    while (pow2 < n) {
+        pow2 <<= 1;
+    }
+    return pow2;
+}
+
+template <typename Word>
+void __ntt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                          const Word modulus, Word coeffs[],
+                                          size_t nonzero_block, size_t stride,
+                                          const size_t output_begin,
+                                          const size_t output_end) {
+    const size_t dimension = 1ULL << log_dimension;
+    if (stride == 0 || (stride & (stride - 1)) != 0 || stride > dimension) {
+        throw std::invalid_argument("The stride should be a power of 2 not "
+                                    "greater than the dimension.");
+    }
+    if (output_begin >= output_end || output_end > dimension) {
+        throw std::invalid_argument("Invalid range of the needed outputs.");
+    }
+    nonzero_block = std::min(std::max(__ceil_pow2(nonzero_block), stride),
+                             dimension);
+    if (__compact_ntt_factors()) {
+        ntt_negacyclic_inplace_lazy(log_dimension, modulus, coeffs);
+        return;
+    }
+
+    HEHUB_PROFILE_SCOPE(ntt, dimension * sizeof(Word));
+    const auto &ntt_factors =
+        __find_or_create_ntt_factors(modulus, log_dimension);
+
+    if (!__ntt_values_growing(modulus)) {
+        __sparse_butterflies<false>(log_dimension, modulus, ntt_factors, 1,
+                                    nonzero_block, stride, output_begin,
+                                    output_end, coeffs);
+        const Word modulus_doubled = 2 * modulus;
+        for (size_t i = output_begin; i < output_end; i++) {
+            coeffs[i] -= (coeffs[i] >= modulus_doubled) ? modulus_doubled : 0;
+        }
+        return;
+    }
+
+    __sparse_butterflies<true>(log_dimension, modulus, ntt_factors, 1,
+                               nonzero_block, stride, output_begin, output_end,
+                               coeffs);
+    const Word log_modulus = __log_modulus(modulus);
+    const Word div_fix = (modulus >= (1ULL << log_modulus)) ? 1 : 0;
+    for (size_t i = output_begin; i < output_end; i++) {
+        coeffs[i] -= ((coeffs[i] >> log_modulus) - div_fix) * modulus;
+    }
+}
+
+void ntt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                        const u64 modulus, u64 coeffs[],
+                                        const size_t nonzero_count,
+                                        const size_t stride) {
+    __ntt_negacyclic_inplace_lazy_sparse(log_dimension, modulus, coeffs,
+                                         nonzero_count, stride, 0,
+                                         1ULL << log_dimension);
+}
+
+void ntt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                        const u32 modulus, u32 coeffs[],
+                                        const size_t nonzero_count,
+                                        const size_t stride) {
+    __ntt_negacyclic_inplace_lazy_sparse(log_dimension, modulus, coeffs,
+                                         nonzero_count, stride, 0,
+                                         1ULL << log_dimension);
+}
+
+void ntt_negacyclic_inplace_lazy_truncated(const size_t log_dimension,
+                                           const u64 modulus, u64 coeffs[],
+                                           const size_t output_begin,
+                                           const size_t output_count) {
+    const size_t dimension = 1ULL << log_dimension;
+    __ntt_negacyclic_inplace_lazy_sparse(log_dimension, modulus, coeffs,
+                                         dimension, 1, output_begin,
+                                         output_begin + output_count);
+}
+
+void ntt_negacyclic_inplace_lazy_truncated(const size_t log_dimension,
+                                           const u32 modulus, u32 coeffs[],
+                                           const size_t output_begin,
+                                           const size_t output_count) {
+    const size_t dimension = 1ULL << log_dimension;
+    __ntt_negacyclic_inplace_lazy_sparse(log_dimension, modulus, coeffs,
+                                         dimension, 1, output_begin,
+                                         output_begin + output_count);
+}
+
+template <typename Word>
+void __intt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                           const Word modulus, Word values[],
+                                           const size_t nonzero_count) {
+    const size_t dimension = 1ULL << log_dimension;
+    if (nonzero_count == 0 || nonzero_count > dimension) {
+        throw std::invalid_argument("Invalid number of nonzero values.");
+    }
+    if (__compact_ntt_factors()) {
+        intt_negacyclic_inplace_lazy(log_dimension, modulus, values);
+        return;
+    }
+    HEHUB_PROFILE_SCOPE(intt, dimension * sizeof(Word));
+    const auto &intt_factors =
+        __find_or_create_ntt_factors(modulus, log_dimension, true);
+
+    // The values in [0, 2^k) are shuffled to the multiples of 2^(n - k).
+    const auto stride = dimension / __ceil_pow2(nonzero_count);
+    // per-thread scratch, as the largest dimensions do not fit on the stack
+    thread_local std::vector<Word> scratch;
+    scratch.resize(dimension);
+    const auto values_shuffled = scratch.data();
+    const auto &shuffled_indices = intt_factors.shuffled_indices;
+    for (size_t i = 0; i < dimension; i += stride) {
+        values_shuffled[i] = values[shuffled_indices[i]];
+    }
+
+    const bool growing = __ntt_values_growing(modulus);
+    if (growing) {
+        __sparse_butterflies<true>(log_dimension, modulus, intt_factors, 0,
+                                   dimension, stride, 0, dimension,
+                                   values_shuffled);
+    } else {
+        __sparse_butterflies<false>(log_dimension, modulus, intt_factors, 0,
+                                    dimension, stride, 0, dimension,
+                                    values_shuffled);
+    }
 
     for (size_t i = 0; i < dimension; i++) {
         values[i] = values_shuffled[shuffled_indices[i]];
     }
 
-    const u64 log_modulus = (u64)(log2(modulus) + 0.5);
-    const u64 div_fix = (modulus >= (1ULL << log_modulus)) ? 1 : 0;
-    idx++;
+    const Word log_modulus = __log_modulus(modulus);
+    const Word div_fix = (modulus >= (1ULL << log_modulus)) ? 1 : 0;
+    size_t idx = dimension;
     for (size_t i = 0; i < dimension; i++, idx++) {
-        values[i] -= ((values[i] >> log_modulus) - div_fix) * modulus;
+        if (growing) {
+            values[i] -= ((values[i] >> log_modulus) - div_fix) * modulus;
+        }
         values[i] =
             mul_mod_harvey_lazy(modulus, values[i], intt_factors.seq[idx],
                                 intt_factors.seq_harvey[idx]);
     }
 }
 
+void intt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                         const u64 modulus, u64 values[],
+                                         const size_t nonzero_count) {
+    __intt_negacyclic_inplace_lazy_sparse(log_dimension, modulus, values,
+                                          nonzero_count);
+}
+
+void intt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                         const u32 modulus, u32 values[],
+                                         const size_t nonzero_count) {
+    __intt_negacyclic_inplace_lazy_sparse(log_dimension, modulus, values,
+                                          nonzero_count);
+}
+
+/// The NTT factors of several moduli interleaved, i.e. the factors of the same
+/// index are stored contiguously for the W lanes, where the moduli fill the
+/// first lanes and the last one is repeated in the rest.
+template <size_t W> struct InterleavedNTTFactors {
+    InterleavedNTTFactors(const std::vector<u64> &lane_moduli,
+                          size_t log_dimension, bool for_inverse) {
+        std::array<const NTTFactors<u64> *, W> lane_factors;
+        for (size_t lane = 0; lane < W; lane++) {
+            moduli[lane] = lane_moduli[std::min(lane, lane_moduli.size() - 1)];
+            log_moduli[lane] = (u64)(log2(moduli[lane]) + 0.5);
+            div_fix[lane] = (moduli[lane] >= (1ULL << log_moduli[lane])) ? 1 : 0;
+            lane_factors[lane] = &__find_or_create_ntt_factors<u64>(
+                moduli[lane], log_dimension, for_inverse);
+        }
+
+        const auto factor_count = lane_factors[0]->seq.size();
+        seq.resize(factor_count * W);
+        seq_harvey.resize(factor_count * W);
+        for (size_t i = 0; i < factor_count; i++) {
+            for (size_t lane = 0; lane < W; lane++) {
+                seq[i * W + lane] = lane_factors[lane]->seq[i];
+                seq_harvey[i * W + lane] = lane_factors[lane]->seq_harvey[i];
+            }
+        }
+        shuffled_indices = lane_factors[0]->shuffled_indices;
+    }
+
+    std::array<u64, W> moduli;
+
+    std::array<u64, W> log_moduli;
+
+    std::array<u64, W> div_fix;
+
+    std::vector<u64> seq;
+
+    std::vector<u64> seq_harvey;
+
+    std::vector<size_t> shuffled_indices;
+};
+
+template <size_t W>
+const InterleavedNTTFactors<W> &
+__find_or_create_interleaved_factors(const size_t log_dimension,
+                                     const size_t component_count,
+                                     const u64 moduli[],
+                                     const bool for_inverse) {
+    static ConcurrentCache<std::tuple<std::vector<u64>, size_t, bool>,
+                           InterleavedNTTFactors<W>>
+        cache;
+    std::vector<u64> lane_moduli(moduli, moduli + component_count);
+    return cache.find_or_create(
+        std::make_tuple(lane_moduli, log_dimension, for_inverse), [&]() {
+            return InterleavedNTTFactors<W>(lane_moduli, log_dimension,
+                                            for_inverse);
+        });
+}
+
+/// The butterflies of the NTT (or of the INTT on shuffled values) over data
+/// interleaved in W lanes, where idx is the index of the first factor.
+template <size_t W>
+inline void __butterflies_interleaved(const size_t log_dimension,
+                                      const InterleavedNTTFactors<W> &factors,
+                                      size_t idx, u64 data[]) {
+    const size_t dimension = 1ULL << log_dimension;
+    const auto &moduli = factors.moduli;
+    for (size_t data_step = dimension; data_step > 1; data_step >>= 1) {
+        auto gap = data_step / 2;
+        for (size_t start = 0; start < dimension; start += data_step, idx++) {
+            const auto zeta = &factors.seq[idx * W];
+            const auto zeta_harvey = &factors.seq_harvey[idx * W];
+            for (size_t l = start; l < start + gap; l++) {
+                auto low = &data[l * W];
+                auto high = &data[(l + gap) * W];
+                for (size_t lane = 0; lane < W; lane++) {
+                    auto temp = mul_mod_harvey_lazy(moduli[lane], high[lane],
+                                                    zeta[lane],
+                                                    zeta_harvey[lane]);
+                    high[lane] = low[lane] + 2 * moduli[lane] - temp;
+                    low[lane] = low[lane] + temp;
+                }
+            }
+        }
+    }
+}
+
+template <size_t W>
+void __ntt_negacyclic_inplace_lazy_interleaved(const size_t log_dimension,
+                                               const size_t component_count,
+                                               const u64 moduli[],
+                                               u64 *coeffs[]) {
+    const size_t dimension = 1ULL << log_dimension;
+    const auto &factors = __find_or_create_interleaved_factors<W>(
+        log_dimension, component_count, moduli, false);
+
+    std::vector<u64> data(dimension * W, 0);
+    for (size_t k = 0; k < component_count; k++) {
+        for (size_t i = 0; i < dimension; i++) {
+            data[i * W + k] = coeffs[k][i];
+        }
+    }
+
+    __butterflies_interleaved(log_dimension, factors, 1, data.data());
+
+    for (size_t k = 0; k < component_count; k++) {
+        const auto modulus = factors.moduli[k];
+        const auto log_modulus = factors.log_moduli[k];
+        const auto div_fix = factors.div_fix[k];
+        for (size_t i = 0; i < dimension; i++) {
+            auto coeff = data[i * W + k];
+            coeffs[k][i] = coeff - ((coeff >> log_modulus) - div_fix) * modulus;
+        }
+    }
+}
+
+template <size_t W>
+void __intt_negacyclic_inplace_lazy_interleaved(const size_t log_dimension,
+                                                const size_t component_count,
+                                                const u64 moduli[],
+                                                u64 *values[]) {
+    const size_t dimension = 1ULL << log_dimension;
+    const auto &factors = __find_or_create_interleaved_factors<W>(
+        log_dimension, component_count, moduli, true);
+    const auto &shuffled_indices = factors.shuffled_indices;
+
+    std::vector<u64> data(dimension * W, 0);
+    for (size_t k = 0; k < component_count; k++) {
+        for (size_t i = 0; i < dimension; i++) {
+            data[i * W + k] = values[k][shuffled_indices[i]];
+        }
+    }
+
+    __butterflies_interleaved(log_dimension, factors, 0, data.data());
+
+    // the factors of the last step follow those of the butterflies
+    const auto last_factors = &factors.seq[dimension * W];
+    const auto last_factors_harvey = &factors.seq_harvey[dimension * W];
+    for (size_t k = 0; k < component_count; k++) {
+        const auto modulus = factors.moduli[k];
+        const auto log_modulus = factors.log_moduli[k];
+        const auto div_fix = factors.div_fix[k];
+        for (size_t i = 0; i < dimension; i++) {
+            auto value = data[shuffled_indices[i] * W + k];
+            value -= ((value >> log_modulus) - div_fix) * modulus;
+            values[k][i] =
+                mul_mod_harvey_lazy(modulus, value, last_factors[i * W + k],
+                                    last_factors_harvey[i * W + k]);
+        }
+    }
+}
+
+void ntt_negacyclic_inplace_lazy(const size_t log_dimension,
+                                 const size_t component_count,
+                                 const u64 moduli[], u64 *coeffs[]) {
+    if (component_count == 0 || component_count > NTT_INTERLEAVING_WIDTH) {
+        throw std::invalid_argument("Invalid number of components to "
+                                    "transform at once.");
+    }
+    // the interleaved butterflies let the values grow and take the full
+    // factors, and the presets are specialized for one component
+    if (component_count == 1 || __compact_ntt_factors() ||
+        !std::all_of(moduli, moduli + component_count,
+                     __ntt_values_growing<u64>) ||
+        __find_preset_kernels(1ULL << log_dimension, moduli[0])) {
+        for (size_t k = 0; k < component_count; k++) {
+            ntt_negacyclic_inplace_lazy(log_dimension, moduli[k], coeffs[k]);
+        }
+        return;
+    }
+    // counted as one NTT per component
+    HEHUB_PROFILE_SCOPE(ntt, (1ULL << log_dimension) * sizeof(u64));
+#ifdef HEHUB_PROFILE
+    for (size_t k = 1; k < component_count; k++) {
+        HEHUB_PROFILE_COUNT(ntt, (1ULL << log_dimension) * sizeof(u64));
+    }
+#endif
+
+    if (component_count <= 4) {
+        __ntt_negacyclic_inplace_lazy_interleaved<4>(
+            log_dimension, component_count, moduli, coeffs);
+    } else {
+        __ntt_negacyclic_inplace_lazy_interleaved<8>(
+            log_dimension, component_count, moduli, coeffs);
+    }
+}
+
+void intt_negacyclic_inplace_lazy(const size_t log_dimension,
+                                  const size_t component_count,
+                                  const u64 moduli[], u64 *values[]) {
+    if (component_count == 0 || component_count > NTT_INTERLEAVING_WIDTH) {
+        throw std::invalid_argument("Invalid number of components to "
+                                    "transform at once.");
+    }
+    // the interleaved butterflies let the values grow and take the full
+    // factors, and the presets are specialized for one component
+    if (component_count == 1 || __compact_ntt_factors() ||
+        !std::all_of(moduli, moduli + component_count,
+                     __ntt_values_growing<u64>) ||
+        __find_preset_kernels(1ULL << log_dimension, moduli[0])) {
+        for (size_t k = 0; k < component_count; k++) {
+            intt_negacyclic_inplace_lazy(log_dimension, moduli[k], values[k]);
+        }
+        return;
+    }
+    // counted as one INTT per component
+    HEHUB_PROFILE_SCOPE(intt, (1ULL << log_dimension) * sizeof(u64));
+#ifdef HEHUB_PROFILE
+    for (size_t k = 1; k < component_count; k++) {
+        HEHUB_PROFILE_COUNT(intt, (1ULL << log_dimension) * sizeof(u64));
+    }
+#endif
+
+    if (component_count <= 4) {
+        __intt_negacyclic_inplace_lazy_interleaved<4>(
+            log_dimension, component_count, moduli, values);
+    } else {
+        __intt_negacyclic_inplace_lazy_interleaved<8>(
+            log_dimension, component_count, moduli, values);
+    }
+}
+
+NTTFactorTables __ntt_factor_tables(const u64 modulus,
+                                    const size_t log_dimension,
+                                    const bool for_inverse) {
+    const auto &factors =
+        __find_or_create_ntt_factors(modulus, log_dimension, for_inverse);
+    return NTTFactorTables{factors.seq.data(), factors.seq_harvey.data(),
+                           factors.shuffled_indices.data()};
+}
+
 void cache_ntt_factors_strict(const u64 log_dimension,
                               const std::vector<u64> &moduli) {
     for (auto modulus : moduli) {
-        __find_or_create_ntt_factors(modulus, log_dimension);
-        __find_or_create_ntt_factors(modulus, log_dimension, true);
+        if (__compact_ntt_factors()) {
+            __find_or_create_compact_ntt_factors<u64>(modulus, log_dimension);
+            continue;
+        }
+        __find_or_create_ntt_factors<u64>(modulus, log_dimension);
+        __find_or_create_ntt_factors<u64>(modulus, log_dimension, true);
     }
 }
 
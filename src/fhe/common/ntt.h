@@ -13,6 +13,8 @@
 #include "mod_arith.h"
 #include "range/v3/view/zip.hpp"
 #include "rns.h"
+#include "task_runtime.h"
+#include "tracing.h"
 #include "type_defs.h"
 #include <cmath>
 #include <stdexcept>
@@ -20,6 +22,12 @@
 
 namespace hehub {
 
+/// @brief The largest bit size of the primes for which the NTT butterflies
+/// leave the values growing by 2 * modulus per level, as the final correction
+/// assumes them to be less than 32 * modulus.
+template <typename Word>
+constexpr size_t NTT_MAX_GROWING_LOG_MODULUS = sizeof(Word) * 8 - 5;
+
 /**
  * @brief The function carries out forward NTT operation inplace, the input and
  * output of which is an element of the negacyclic ring Z_q[X]/(X^n + 1) where q
@@ -27,27 +35,154 @@ namespace hehub {
  * polynomial in coefficient form. The output values are left in [0, 2*modulus).
  * @param[in] log_dimension The log value of the length of the polynomial, i.e.
  * the number of coefficients.
- * @param[in] modulus The modulus q.
+ * @param[in] modulus The modulus q, which is less than 2^62. The primes of more
+ * than 59 bits take the butterflies reducing the values at each level, which
+ * are slower.
  * @param[inout] coeffs The polynomial in coefficient form.
  */
 void ntt_negacyclic_inplace_lazy(const size_t log_dimension, const u64 modulus,
                                  u64 coeffs[]);
 
+/// @brief The forward NTT on 32-bit words, for the primes less than 2^30,
+/// which gives the same values as that on 64-bit words modulo q.
+void ntt_negacyclic_inplace_lazy(const size_t log_dimension, const u32 modulus,
+                                 u32 coeffs[]);
+
+/**
+ * @brief Carry out the forward NTT of a polynomial which is mostly zero,
+ * skipping the butterflies whose inputs are all zero. The results are the
+ * same as those of the full NTT modulo q.
+ * @param[in] log_dimension The log value of the length of the polynomial.
+ * @param[in] modulus The modulus q.
+ * @param[inout] coeffs The polynomial in coefficient form.
+ * @param[in] nonzero_count The coefficients at and after this index are zero.
+ * @param[in] stride Only the coefficients at the multiples of stride, a power
+ * of 2, are nonzero, e.g. N / 2n for a polynomial of X^(N / 2n).
+ */
+void ntt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                        const u64 modulus, u64 coeffs[],
+                                        const size_t nonzero_count,
+                                        const size_t stride = 1);
+
+/// @brief The sparse forward NTT on 32-bit words, for the primes less than
+/// 2^30.
+void ntt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                        const u32 modulus, u32 coeffs[],
+                                        const size_t nonzero_count,
+                                        const size_t stride = 1);
+
+/**
+ * @brief Carry out the forward NTT computing only a range of the output
+ * values, which skips the butterflies of the trailing levels not leading to
+ * them. The other values are left unspecified.
+ * @param[in] log_dimension The log value of the length of the polynomial.
+ * @param[in] modulus The modulus q.
+ * @param[inout] coeffs The polynomial in coefficient form.
+ * @param[in] output_begin The first output value needed.
+ * @param[in] output_count The number of output values needed.
+ */
+void ntt_negacyclic_inplace_lazy_truncated(const size_t log_dimension,
+                                           const u64 modulus, u64 coeffs[],
+                                           const size_t output_begin,
+                                           const size_t output_count);
+
+/// @brief The truncated forward NTT on 32-bit words, for the primes less than
+/// 2^30.
+void ntt_negacyclic_inplace_lazy_truncated(const size_t log_dimension,
+                                           const u32 modulus, u32 coeffs[],
+                                           const size_t output_begin,
+                                           const size_t output_count);
+
+/// The largest log dimension for which the NTTs of RNS polynomials are done
+/// on several components at once, since the butterflies of the last levels
+/// are too few per component to fill the vector units.
+const size_t NTT_INTERLEAVING_MAX_LOG_DIMENSION = 11;
+
+/// The maximum number of components transformed at once.
+const size_t NTT_INTERLEAVING_WIDTH = 8;
+
+/**
+ * @brief Carry out the forward NTT of several components at once, which gives
+ * the same results as transforming them one by one. The components are
+ * interleaved so that each butterfly is computed for all of them in a loop
+ * over the moduli, whose length does not depend on the level.
+ * @param[in] log_dimension The log value of the length of the polynomials.
+ * @param[in] component_count The number of components, which is at most
+ * NTT_INTERLEAVING_WIDTH.
+ * @param[in] moduli The moduli of the components.
+ * @param[inout] coeffs The components in coefficient form.
+ */
+void ntt_negacyclic_inplace_lazy(const size_t log_dimension,
+                                 const size_t component_count,
+                                 const u64 moduli[], u64 *coeffs[]);
+
+/// @brief Run func(begin, count) on the groups of components to transform at
+/// once, in parallel.
+template <typename Func>
+inline void __for_each_component_group(const size_t component_count,
+                                       Func func) {
+    const auto group_count = (component_count + NTT_INTERLEAVING_WIDTH - 1) /
+                             NTT_INTERLEAVING_WIDTH;
+    parallel_for(0, group_count, [&](size_t group_idx) {
+        auto begin = group_idx * NTT_INTERLEAVING_WIDTH;
+        func(begin, std::min(NTT_INTERLEAVING_WIDTH, component_count - begin));
+    });
+}
+
+/**
+ * @brief The forward NTT of the components in a view, which leaves the
+ * representation form of the polynomial to the caller.
+ * @param[inout] view The components in coefficient form.
+ */
+inline void ntt_negacyclic_inplace_lazy(RnsPolyView view) {
+    HEHUB_TRACE_SPAN("NTT");
+    const auto component_count = view.component_count();
+    const auto log_dimension = view.log_dimension();
+    const auto moduli = view.moduli();
+
+    if (log_dimension <= NTT_INTERLEAVING_MAX_LOG_DIMENSION &&
+        component_count > 1) {
+        __for_each_component_group(component_count, [&](size_t begin,
+                                                        size_t count) {
+            u64 *coeffs[NTT_INTERLEAVING_WIDTH];
+            for (size_t k = 0; k < count; k++) {
+                coeffs[k] = view[begin + k];
+            }
+            ntt_negacyclic_inplace_lazy(log_dimension, count, moduli + begin,
+                                        coeffs);
+        });
+    } else {
+        parallel_for(0, component_count, [&](size_t k) {
+            ntt_negacyclic_inplace_lazy(log_dimension, moduli[k], view[k]);
+        });
+    }
+}
+
 /**
  * @brief TODO
  *
  * @param[inout] rns_poly
  */
 inline void ntt_negacyclic_inplace_lazy(RnsPolynomial &rns_poly) {
-    const auto component_count = rns_poly.component_count();
-    const auto log_dimension = rns_poly.log_dimension();
-    const auto &moduli = rns_poly.modulus_vec();
-
-    for (auto [component, modulus] : ranges::views::zip(rns_poly, moduli)) {
-        ntt_negacyclic_inplace_lazy(log_dimension, modulus, component.data());
-    }
+    ntt_negacyclic_inplace_lazy(RnsPolyView(rns_poly));
+    rns_poly.rep_form = PolyRepForm::value;
+    rns_poly.value_bound = PolyValueBound::two_q;
+}
 
+/**
+ * @brief The forward NTT of a polynomial on 32-bit words, whose components are
+ * transformed one by one, as the interleaved butterflies take 64-bit words.
+ * @param[inout] rns_poly
+ */
+inline void ntt_negacyclic_inplace_lazy(RnsPolynomial32 &rns_poly) {
+    HEHUB_TRACE_SPAN("NTT");
+    parallel_for(0, rns_poly.component_count(), [&](size_t k) {
+        ntt_negacyclic_inplace_lazy(rns_poly.log_dimension(),
+                                    (u32)rns_poly.modulus_at(k),
+                                    rns_poly[k].data());
+    });
     rns_poly.rep_form = PolyRepForm::value;
+    rns_poly.value_bound = PolyValueBound::two_q;
 }
 
 /**
@@ -64,21 +199,95 @@ inline void ntt_negacyclic_inplace_lazy(RnsPolynomial &rns_poly) {
 void intt_negacyclic_inplace_lazy(const size_t log_dimension, const u64 modulus,
                                   u64 values[]);
 
+/// @brief The inverse NTT on 32-bit words, for the primes less than 2^30.
+void intt_negacyclic_inplace_lazy(const size_t log_dimension, const u32 modulus,
+                                  u32 values[]);
+
+/**
+ * @brief Carry out the inverse NTT of values which are nonzero only in a
+ * prefix, e.g. a few SIMD slots, skipping the butterflies whose inputs are all
+ * zero. The results are the same as those of the full inverse NTT modulo q.
+ * @param[in] log_dimension The log value of the length of the polynomial.
+ * @param[in] modulus The modulus q.
+ * @param[inout] values The values evaluated from the polynomial.
+ * @param[in] nonzero_count The values at and after this index are zero.
+ */
+void intt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                         const u64 modulus, u64 values[],
+                                         const size_t nonzero_count);
+
+/// @brief The sparse inverse NTT on 32-bit words, for the primes less than
+/// 2^30.
+void intt_negacyclic_inplace_lazy_sparse(const size_t log_dimension,
+                                         const u32 modulus, u32 values[],
+                                         const size_t nonzero_count);
+
+/**
+ * @brief Carry out the inverse NTT of several components at once, see the
+ * forward one.
+ * @param[in] log_dimension The log value of the length of the polynomials.
+ * @param[in] component_count The number of components, which is at most
+ * NTT_INTERLEAVING_WIDTH.
+ * @param[in] moduli The moduli of the components.
+ * @param[inout] values The components in value form.
+ */
+void intt_negacyclic_inplace_lazy(const size_t log_dimension,
+                                  const size_t component_count,
+                                  const u64 moduli[], u64 *values[]);
+
+/**
+ * @brief The inverse NTT of the components in a view, which leaves the
+ * representation form of the polynomial to the caller.
+ * @param[inout] view The components in value form.
+ */
+inline void intt_negacyclic_inplace_lazy(RnsPolyView view) {
+    HEHUB_TRACE_SPAN("INTT");
+    const auto component_count = view.component_count();
+    const auto log_dimension = view.log_dimension();
+    const auto moduli = view.moduli();
+
+    if (log_dimension <= NTT_INTERLEAVING_MAX_LOG_DIMENSION &&
+        component_count > 1) {
+        __for_each_component_group(component_count, [&](size_t begin,
+                                                        size_t count) {
+            u64 *values[NTT_INTERLEAVING_WIDTH];
+            for (size_t k = 0; k < count; k++) {
+                values[k] = view[begin + k];
+            }
+            intt_negacyclic_inplace_lazy(log_dimension, count, moduli + begin,
+                                         values);
+        });
+    } else {
+        parallel_for(0, component_count, [&](size_t k) {
+            intt_negacyclic_inplace_lazy(log_dimension, moduli[k], view[k]);
+        });
+    }
+}
+
 /**
  * @brief TODO
  *
  * @param[inout] rns_poly
  */
 inline void intt_negacyclic_inplace_lazy(RnsPolynomial &rns_poly) {
-    const auto component_count = rns_poly.component_count();
-    const auto log_dimension = rns_poly.log_dimension();
-    const auto &moduli = rns_poly.modulus_vec();
-
-    for (auto [component, modulus] : ranges::views::zip(rns_poly, moduli)) {
-        intt_negacyclic_inplace_lazy(log_dimension, modulus, component.data());
-    }
+    intt_negacyclic_inplace_lazy(RnsPolyView(rns_poly));
+    rns_poly.rep_form = PolyRepForm::coeff;
+    rns_poly.value_bound = PolyValueBound::two_q;
+}
 
+/**
+ * @brief The inverse NTT of a polynomial on 32-bit words, see the forward one.
+ * @param[inout] rns_poly
+ */
+inline void intt_negacyclic_inplace_lazy(RnsPolynomial32 &rns_poly) {
+    HEHUB_TRACE_SPAN("INTT");
+    parallel_for(0, rns_poly.component_count(), [&](size_t k) {
+        intt_negacyclic_inplace_lazy(rns_poly.log_dimension(),
+                                     (u32)rns_poly.modulus_at(k),
+                                     rns_poly[k].data());
+    });
     rns_poly.rep_form = PolyRepForm::coeff;
+    rns_poly.value_bound = PolyValueBound::two_q;
 }
 
 /**
@@ -91,6 +300,35 @@ inline void intt_negacyclic_inplace(RnsPolynomial &rns_poly) {
     reduce_strict(rns_poly);
 }
 
+/// @brief How the NTT factors of each modulus and dimension are stored.
+enum class NTTFactorStorage {
+    /// Separate tables for the NTT and the INTT, 7 words per coefficient.
+    full,
+    /// A table of 1 word per coefficient shared by the NTT and the INTT, which
+    /// takes an extra multiplication per butterfly in the last level.
+    compact,
+};
+
+/**
+ * @brief Choose the storage of the NTT factors used by the transforms from now
+ * on, e.g. the compact one for many primes at a large dimension, whose full
+ * tables would not fit in the cache. The results of either storage are the
+ * same modulo q, so it can be switched at any time, while the tables created
+ * already are kept. The transforms of several components at once, the sparse
+ * ones and the kernel presets take the full tables, hence in the compact
+ * storage they fall back to the dense transforms of one component, except
+ * the presets.
+ * @param storage The storage, which is full by default.
+ */
+void set_ntt_factor_storage(NTTFactorStorage storage);
+
+NTTFactorStorage ntt_factor_storage();
+
+/// @brief The bytes of the factors of both the NTT and the INTT of one modulus
+/// in a storage.
+size_t ntt_factor_bytes(const size_t log_dimension,
+                        const NTTFactorStorage storage);
+
 /**
  * @brief Create the NTT factors for all the input moduli immediately, which
  * will be used in the process of NTT and INTT. N.B., this functionality is
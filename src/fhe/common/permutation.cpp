@@ -1,5 +1,7 @@
 #include "permutation.h"
+#include "profiling.h"
 #include "range/v3/view/zip.hpp"
+#include <algorithm>
 
 using namespace std;
 using namespace ranges::views;
@@ -33,9 +35,17 @@ RnsPolynomial cycle(const RnsPolynomial &poly_ntt, const size_t step) {
     const auto len = poly_ntt.dimension();
     const auto loglen = poly_ntt.log_dimension();
     const auto components = poly_ntt.component_count();
+    HEHUB_PROFILE_SCOPE(automorphism, len * components * sizeof(u64));
     RnsPolynomial cycled(len, components, poly_ntt.modulus_vec());
     cycled.rep_form = PolyRepForm::value;
 
+    vector<u64 *> cycled_comps;
+    vector<const u64 *> poly_comps;
+    for (size_t k = 0; k < components; k++) {
+        cycled_comps.push_back(cycled[k].data());
+        poly_comps.push_back(poly_ntt[k].data());
+    }
+
     auto mask = (1 << (loglen + 1)) - 1; // for fast modulo 2*len
     auto &root_indices = root_index_factors();
     auto index_factor = root_indices[step] & mask;
@@ -47,9 +57,9 @@ RnsPolynomial cycle(const RnsPolynomial &poly_ntt, const size_t step) {
         auto to_position = __bit_rev_naive_16((new_root_index - 1) / 2, loglen);
 
         for (size_t k = 0; k < components; k++) {
-            cycled[k][to_position] = poly_ntt[k][from_position];
-            cycled[k][len - 1 - to_position] =
-                poly_ntt[k][len - 1 - from_position];
+            cycled_comps[k][to_position] = poly_comps[k][from_position];
+            cycled_comps[k][len - 1 - to_position] =
+                poly_comps[k][len - 1 - from_position];
         }
     }
 
@@ -63,12 +73,12 @@ RnsPolynomial involution(const RnsPolynomial &poly_ntt) {
 
     const auto len = poly_ntt.dimension();
     const auto components = poly_ntt.component_count();
+    HEHUB_PROFILE_SCOPE(automorphism, len * components * sizeof(u64));
     RnsPolynomial involution(len, components, poly_ntt.modulus_vec());
     involution.rep_form = PolyRepForm::value;
     for (auto [new_component, old_component] : zip(involution, poly_ntt)) {
-        for (size_t i = 0; i < len; i++) {
-            new_component[i] = old_component[len - 1 - i];
-        }
+        std::reverse_copy(old_component.begin(), old_component.end(),
+                          new_component.begin());
     }
 
     return involution;
@@ -189,6 +189,27 @@ const std::vector<std::vector<u64>> prime_lists{
      576460752289923073, 576460752289529857, 576460752289005569,
      576460752288940033, 576460752286253057, 576460752284418049,
      576460752280158209, 576460752279764993, 576460752279306241,
-     576460752273801217, 576460752272228353}};
+     576460752273801217, 576460752272228353},
+    {1152921504606584833, 1152921504598720513, 1152921504597016577,
+     1152921504595968001, 1152921504595640321, 1152921504593412097,
+     1152921504592822273, 1152921504592429057, 1152921504589938689,
+     1152921504586530817, 1152921504585547777, 1152921504583647233,
+     1152921504581877761, 1152921504581419009, 1152921504580894721,
+     1152921504578666497, 1152921504578273281, 1152921504577748993,
+     1152921504577486849, 1152921504575979521},
+    {2305843009211662337, 2305843009211596801, 2305843009211400193,
+     2305843009210023937, 2305843009208713217, 2305843009208123393,
+     2305843009207468033, 2305843009202159617, 2305843009201242113,
+     2305843009200586753, 2305843009197506561, 2305843009196916737,
+     2305843009195868161, 2305843009195671553, 2305843009195343873,
+     2305843009191936001, 2305843009188462593, 2305843009188003841,
+     2305843009187414017, 2305843009186430977},
+    {4611686018427322369, 4611686018425815041, 4611686018423390209,
+     4611686018423062529, 4611686018422669313, 4611686018421293057,
+     4611686018418147329, 4611686018416115713, 4611686018413166593,
+     4611686018408316929, 4611686018408120321, 4611686018407661569,
+     4611686018407137281, 4611686018406940673, 4611686018406678529,
+     4611686018405498881, 4611686018405367809, 4611686018401566721,
+     4611686018400059393, 4611686018399993857}};
 
 } // namespace hehub
@@ -0,0 +1,89 @@
+#include "profiling.h"
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+namespace hehub {
+
+const char *profile_category_name(ProfileCategory category) {
+    static const char *names[PROFILE_CATEGORY_COUNT]{
+        "ntt",          "intt",     "key_switch", "rescale",
+        "automorphism", "sampling", "allocation"};
+    return names[(size_t)category];
+}
+
+string ProfileReport::to_string() const {
+    stringstream summary;
+    summary << fixed << setprecision(3);
+    bool first = true;
+    for (size_t i = 0; i < PROFILE_CATEGORY_COUNT; i++) {
+        const auto &entry = entries[i];
+        if (entry.count == 0) {
+            continue;
+        }
+        summary << (first ? "" : ", ")
+                << profile_category_name((ProfileCategory)i) << "="
+                << entry.count << " (" << entry.nanoseconds / 1e6 << " ms, "
+                << entry.bytes << " B)";
+        first = false;
+    }
+    return summary.str();
+}
+
+struct ProfileScope::Counters {
+    struct AtomicEntry {
+        atomic<u64> count = 0;
+        atomic<u64> nanoseconds = 0;
+        atomic<u64> bytes = 0;
+    };
+
+    array<AtomicEntry, PROFILE_CATEGORY_COUNT> entries;
+
+    /// The counters of the enclosing scope, which are also added to.
+    shared_ptr<Counters> parent;
+};
+
+static thread_local shared_ptr<ProfileScope::Counters> current_counters;
+
+ProfileScope::ProfileScope() : counters_(make_shared<Counters>()) {
+    counters_->parent = current_counters;
+    previous_ = exchange(counters_);
+}
+
+ProfileScope::~ProfileScope() { exchange(move(previous_)); }
+
+ProfileReport ProfileScope::report() const {
+    ProfileReport report;
+    for (size_t i = 0; i < PROFILE_CATEGORY_COUNT; i++) {
+        report.entries[i].count = counters_->entries[i].count;
+        report.entries[i].nanoseconds = counters_->entries[i].nanoseconds;
+        report.entries[i].bytes = counters_->entries[i].bytes;
+    }
+    return report;
+}
+
+shared_ptr<ProfileScope::Counters> ProfileScope::current() {
+    return current_counters;
+}
+
+shared_ptr<ProfileScope::Counters>
+ProfileScope::exchange(shared_ptr<Counters> counters) {
+    current_counters.swap(counters);
+    return counters;
+}
+
+bool profile_active() { return current_counters != nullptr; }
+
+void profile_record(ProfileCategory category, u64 nanoseconds, u64 bytes) {
+    for (auto counters = current_counters.get(); counters;
+         counters = counters->parent.get()) {
+        auto &entry = counters->entries[(size_t)category];
+        entry.count.fetch_add(1, memory_order_relaxed);
+        entry.nanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+        entry.bytes.fetch_add(bytes, memory_order_relaxed);
+    }
+}
+
+} // namespace hehub
@@ -0,0 +1,178 @@
+/**
+ * @file profiling.h
+ * @brief Counters of the costly primitives (NTT, key switching, rescaling,
+ * etc.), which are collected by ProfileScope objects on the calling thread and
+ * the tasks it spawns. The counting is compiled in only if HEHUB_PROFILE is
+ * defined, otherwise the reports are always empty.
+ *
+ */
+#pragma once
+
+#include "type_defs.h"
+#include <array>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace hehub {
+
+/// @brief The kinds of work counted by the profiler.
+enum class ProfileCategory {
+    /// NTT of one RNS component.
+    ntt,
+    /// Inverse NTT of one RNS component.
+    intt,
+    /// Multiplication of a decomposed polynomial with a key switching key,
+    /// where the bytes are those of the key rows used.
+    key_switch,
+    /// Dropping one prime by CKKS rescaling or BGV modulus switching.
+    rescale,
+    /// Automorphism of a polynomial, i.e. cycle() or involution().
+    automorphism,
+    /// Sampling of a random polynomial.
+    sampling,
+    /// Allocation of a component array, which counts no time.
+    allocation
+};
+
+const size_t PROFILE_CATEGORY_COUNT = 7;
+
+/// @brief The name of a category, e.g. "key_switch".
+const char *profile_category_name(ProfileCategory category);
+
+/// @brief The number of calls, the time spent and the bytes processed in one
+/// category.
+struct ProfileEntry {
+    u64 count = 0;
+
+    u64 nanoseconds = 0;
+
+    u64 bytes = 0;
+};
+
+/**
+ * @brief The breakdown of a profiled piece of work by category. The times are
+ * inclusive, e.g. the NTTs inside a key switching are counted in both, and are
+ * summed over threads.
+ */
+struct ProfileReport {
+    std::array<ProfileEntry, PROFILE_CATEGORY_COUNT> entries;
+
+    inline const ProfileEntry &operator[](ProfileCategory category) const {
+        return entries[(size_t)category];
+    }
+
+    /// @brief A one-line summary of the non-empty categories for logging,
+    /// e.g. "ntt=12 (0.210 ms, 393216 B), key_switch=1 (0.530 ms, ...)".
+    std::string to_string() const;
+};
+
+/**
+ * @brief Collect the counters of the work done on this thread while the
+ * object is alive, including the tasks spawned meanwhile on the task runtime.
+ * The scopes can be nested, in which case the outer scopes also count the
+ * work in the inner ones.
+ */
+class ProfileScope {
+public:
+    ProfileScope();
+
+    ProfileScope(const ProfileScope &) = delete;
+
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+    ~ProfileScope();
+
+    /// @brief The counters collected so far.
+    ProfileReport report() const;
+
+    /// The counters shared by a scope and the tasks working for it.
+    struct Counters;
+
+    /// @brief The counters which the work on this thread goes to, or nullptr
+    /// if there is no active scope.
+    static std::shared_ptr<Counters> current();
+
+    /// @brief Make the work on this thread go to the counters, until the
+    /// returned previous counters are restored by another call.
+    static std::shared_ptr<Counters>
+    exchange(std::shared_ptr<Counters> counters);
+
+private:
+    std::shared_ptr<Counters> counters_;
+
+    std::shared_ptr<Counters> previous_;
+};
+
+/// @brief Add to the counters of the active scopes on this thread.
+void profile_record(ProfileCategory category, u64 nanoseconds, u64 bytes);
+
+/// @brief Whether there is an active scope on this thread.
+bool profile_active();
+
+/// @brief Count a call and its time till the end of the enclosing block.
+class ProfileTimer {
+public:
+    ProfileTimer(ProfileCategory category, u64 bytes = 0)
+        : category_(category), bytes_(bytes), active_(profile_active()) {
+        if (active_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~ProfileTimer() {
+        if (active_) {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            profile_record(
+                category_,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count(),
+                bytes_);
+        }
+    }
+
+private:
+    ProfileCategory category_;
+
+    u64 bytes_;
+
+    bool active_;
+
+    std::chrono::steady_clock::time_point start_;
+};
+
+#ifdef HEHUB_PROFILE
+
+/// @brief Wrap a task so that its work goes to the scopes active where the
+/// task is created.
+template <typename Func> auto profile_bind(Func &&func) {
+    return [counters = ProfileScope::current(),
+            func = std::forward<Func>(func)]() {
+        auto previous = ProfileScope::exchange(counters);
+        struct Restore {
+            std::shared_ptr<ProfileScope::Counters> previous;
+            ~Restore() { ProfileScope::exchange(std::move(previous)); }
+        } restore{std::move(previous)};
+        return func();
+    };
+}
+
+#define HEHUB_PROFILE_SCOPE(category, bytes)                                   \
+    ::hehub::ProfileTimer __profile_timer(::hehub::ProfileCategory::category,  \
+                                          bytes)
+#define HEHUB_PROFILE_COUNT(category, bytes)                                   \
+    ::hehub::profile_record(::hehub::ProfileCategory::category, 0, bytes)
+
+#else
+
+template <typename Func> std::decay_t<Func> profile_bind(Func &&func) {
+    return std::forward<Func>(func);
+}
+
+#define HEHUB_PROFILE_SCOPE(category, bytes) ((void)0)
+#define HEHUB_PROFILE_COUNT(category, bytes) ((void)0)
+
+#endif
+
+} // namespace hehub
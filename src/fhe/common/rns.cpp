@@ -1,14 +1,28 @@
 #include "rns.h"
 #include "mod_arith.h"
 #include "range/v3/view/zip.hpp"
+#include <algorithm>
 #include <cmath>
 
 using namespace ranges::views;
 
 namespace hehub {
 
-RnsIntVec::RnsIntVec(const size_t dimension, const size_t components,
-                     const std::vector<u64> &moduli)
+/// Check that the moduli fit in the words of a vector.
+template <typename Word>
+static void __check_moduli_fit(const std::vector<u64> &moduli, size_t count) {
+    for (size_t k = 0; k < count; k++) {
+        if (moduli[k] >= WORD_MODULUS_BOUND<Word>) {
+            throw std::invalid_argument(
+                "Modulus too large for the words of RnsIntVec.");
+        }
+    }
+}
+
+template <typename Word>
+BasicRnsIntVec<Word>::BasicRnsIntVec(const size_t dimension,
+                                     const size_t components,
+                                     const std::vector<u64> &moduli)
     : dimension_(dimension), components_(components),
       log_dimension_(std::log2(dimension) + 0.5) {
 
@@ -21,21 +35,25 @@ RnsIntVec::RnsIntVec(const size_t dimension, const size_t components,
         throw std::invalid_argument(
             "No matching number of moduli provided to create RnsIntVec.");
     }
+    __check_moduli_fit<Word>(moduli, component_count());
     moduli_.assign(moduli.begin(), moduli.begin() + component_count());
     for (auto &component : components_) {
         component = ComponentData(dimension_);
     }
 }
 
-RnsIntVec::RnsIntVec(const RnsIntVec::Params &params)
-    : RnsIntVec(params.dimension, params.component_count, params.moduli) {}
+template <typename Word>
+BasicRnsIntVec<Word>::BasicRnsIntVec(const Params &params)
+    : BasicRnsIntVec(params.dimension, params.component_count, params.moduli) {}
 
-void RnsIntVec::add_components(const std::vector<u64> &new_moduli,
-                               size_t adding) {
+template <typename Word>
+void BasicRnsIntVec<Word>::add_components(const std::vector<u64> &new_moduli,
+                                          size_t adding) {
     if (new_moduli.size() < adding) {
         throw std::invalid_argument(
             "No matching number of moduli provided to add components.");
     }
+    __check_moduli_fit<Word>(new_moduli, adding);
 
     auto orig_size = components_.size();
     moduli_.insert(moduli_.end(), new_moduli.begin(), new_moduli.end());
@@ -45,7 +63,8 @@ void RnsIntVec::add_components(const std::vector<u64> &new_moduli,
     }
 }
 
-void RnsIntVec::remove_components(size_t removing) {
+template <typename Word>
+void BasicRnsIntVec<Word>::remove_components(size_t removing) {
     if (component_count() < removing) {
         throw std::invalid_argument(
             "Trying to remove components more than existing.");
@@ -55,69 +74,103 @@ void RnsIntVec::remove_components(size_t removing) {
     components_.erase(components_.end() - removing, components_.end());
 }
 
-const RnsIntVec &operator+=(RnsIntVec &self, const RnsIntVec &b) {
+template class BasicRnsIntVec<u64>;
+template class BasicRnsIntVec<u32>;
+
+/// Check that b can be added to or subtracted from self.
+template <typename Word>
+static void __check_addition_operands(const BasicRnsIntVec<Word> &self,
+                                      const BasicRnsIntVec<Word> &b) {
     if (self.dimension() != b.dimension()) {
         throw std::invalid_argument("Operands' poly len mismatch.");
     }
-    auto dimension = self.dimension();
     if (b.component_count() < self.component_count()) {
         throw std::invalid_argument(
             "Operand b contains less components than self.");
     }
-    auto components = self.component_count();
     auto moduli(self.modulus_vec()), b_moduli(b.modulus_vec());
-    b_moduli.resize(components);
+    b_moduli.resize(self.component_count());
     if (moduli != b_moduli) {
         throw std::invalid_argument("Operands' moduli mismatch.");
     }
+}
+
+template <typename Word>
+const BasicRnsIntVec<Word> &operator+=(BasicRnsIntVec<Word> &self,
+                                       const BasicRnsIntVec<Word> &b) {
+    __check_addition_operands(self, b);
+    auto dimension = self.dimension();
+    auto components = self.component_count();
 
-    auto moduli_doubled(std::move(moduli));
-    for (auto &m : moduli_doubled) {
-        m *= 2;
-    }
     for (size_t k = 0; k < components; k++) {
+        const Word modulus_doubled = 2 * self.modulus_at(k);
+        auto self_k = self[k].data();
+        auto b_k = b[k].data();
         for (size_t i = 0; i < dimension; i++) {
-            self[k][i] += b[k][i];
-            self[k][i] -=
-                (self[k][i] >= moduli_doubled[k]) ? moduli_doubled[k] : 0;
+            self_k[i] += b_k[i];
+            self_k[i] -= (self_k[i] >= modulus_doubled) ? modulus_doubled : 0;
         }
     }
 
     return self;
 }
 
-const RnsIntVec &operator-=(RnsIntVec &self, const RnsIntVec &b) {
-    if (self.dimension() != b.dimension()) {
-        throw std::invalid_argument("Operands' poly len mismatch.");
-    }
+template <typename Word>
+const BasicRnsIntVec<Word> &operator-=(BasicRnsIntVec<Word> &self,
+                                       const BasicRnsIntVec<Word> &b) {
+    __check_addition_operands(self, b);
     auto dimension = self.dimension();
-    if (b.component_count() < self.component_count()) {
-        throw std::invalid_argument(
-            "Operand b contains less components than self.");
-    }
     auto components = self.component_count();
-    auto moduli(self.modulus_vec()), b_moduli(b.modulus_vec());
-    b_moduli.resize(components);
-    if (moduli != b_moduli) {
-        throw std::invalid_argument("Operands' moduli mismatch.");
+
+    for (size_t k = 0; k < components; k++) {
+        const Word modulus_doubled = 2 * self.modulus_at(k);
+        auto self_k = self[k].data();
+        auto b_k = b[k].data();
+        for (size_t i = 0; i < dimension; i++) {
+            self_k[i] += modulus_doubled - b_k[i];
+            self_k[i] -= (self_k[i] >= modulus_doubled) ? modulus_doubled : 0;
+        }
     }
 
-    auto moduli_doubled(std::move(moduli));
-    for (auto &m : moduli_doubled) {
-        m *= 2;
+    return self;
+}
+
+template <typename Word>
+const BasicRnsIntVec<Word> &add_inplace_lazy(BasicRnsIntVec<Word> &self,
+                                             const BasicRnsIntVec<Word> &b) {
+    __check_addition_operands(self, b);
+    auto dimension = self.dimension();
+    for (size_t k = 0; k < self.component_count(); k++) {
+        auto self_k = self[k].data();
+        auto b_k = b[k].data();
+        for (size_t i = 0; i < dimension; i++) {
+            self_k[i] += b_k[i];
+        }
     }
-    for (size_t k = 0; k < components; k++) {
+
+    return self;
+}
+
+template <typename Word>
+const BasicRnsIntVec<Word> &sub_inplace_lazy(BasicRnsIntVec<Word> &self,
+                                             const BasicRnsIntVec<Word> &b) {
+    __check_addition_operands(self, b);
+    auto dimension = self.dimension();
+    for (size_t k = 0; k < self.component_count(); k++) {
+        const Word modulus = self.modulus_at(k);
+        auto self_k = self[k].data();
+        auto b_k = b[k].data();
         for (size_t i = 0; i < dimension; i++) {
-            self[k][i] += moduli_doubled[k] - b[k][i];
-            self[k][i] -=
-                (self[k][i] >= moduli_doubled[k]) ? moduli_doubled[k] : 0;
+            self_k[i] += modulus - b_k[i];
         }
     }
 
     return self;
 }
 
-RnsIntVec operator*(const RnsIntVec &a, const RnsIntVec &b) {
+template <typename Word>
+BasicRnsIntVec<Word> operator*(const BasicRnsIntVec<Word> &a,
+                               const BasicRnsIntVec<Word> &b) {
     if (a.dimension() != b.dimension()) {
         throw std::invalid_argument("Operands' poly len mismatch.");
     }
@@ -130,48 +183,129 @@ RnsIntVec operator*(const RnsIntVec &a, const RnsIntVec &b) {
         throw std::invalid_argument("Operands' moduli mismatch.");
     }
 
-    RnsIntVec result(RnsIntVec::Params{dimension, components, moduli});
+    BasicRnsIntVec<Word> result(RnsIntVecParams{dimension, components, moduli});
     for (size_t k = 0; k < components; k++) {
-        batched_mul_mod_hybrid_lazy(moduli[k], dimension, a[k].data(),
+        batched_mul_mod_hybrid_lazy((Word)moduli[k], dimension, a[k].data(),
                                     b[k].data(), result[k].data());
     }
 
     return result;
 }
 
-const RnsIntVec &operator*=(RnsIntVec &self, const u64 small_scalar) {
+/// Multiply a component by a scalar in [0, modulus) with Harvey's method.
+template <typename Word>
+static void __mul_scalar_inplace(const Word modulus, const Word scalar,
+                                 SmartArray<Word> &component) {
+    const Word scalar_harvey =
+        ((DoubleWord<Word>)scalar << (sizeof(Word) * 8)) / modulus;
+    for (auto &coeff : component) {
+        coeff = mul_mod_harvey_lazy(modulus, coeff, scalar, scalar_harvey);
+    }
+}
+
+template <typename Word>
+const BasicRnsIntVec<Word> &operator*=(BasicRnsIntVec<Word> &self,
+                                       const u64 small_scalar) {
     for (size_t k = 0; k < self.component_count(); k++) {
-        auto curr_mod = self.moduli_[k];
+        auto curr_mod = self.modulus_at(k);
         auto scalar_reduced = small_scalar % curr_mod; // need opt?
-        auto scalar_harvey = ((u128)scalar_reduced << 64) / curr_mod;
-        for (auto &coeff : self[k]) {
-            coeff = mul_mod_harvey_lazy(curr_mod, coeff, scalar_reduced,
-                                        scalar_harvey);
-        }
+        __mul_scalar_inplace<Word>(curr_mod, scalar_reduced, self[k]);
     }
     return self;
 }
 
-const RnsIntVec &operator*=(RnsIntVec &self,
-                            const std::vector<u64> &rns_scalar) {
+template <typename Word>
+const BasicRnsIntVec<Word> &operator*=(BasicRnsIntVec<Word> &self,
+                                       const std::vector<u64> &rns_scalar) {
     if (rns_scalar.size() != self.component_count()) {
         throw std::invalid_argument("Numbers of RNS component mismatch.");
     }
 
     for (size_t k = 0; k < self.component_count(); k++) {
-        auto curr_mod = self.moduli_[k];
+        auto curr_mod = self.modulus_at(k);
         auto scalar_reduced = rns_scalar[k] % curr_mod; // need opt?
-        auto scalar_harvey = ((u128)scalar_reduced << 64) / curr_mod;
-        for (auto &coeff : self[k]) {
-            coeff = mul_mod_harvey_lazy(curr_mod, coeff, scalar_reduced,
-                                        scalar_harvey);
-        }
+        __mul_scalar_inplace<Word>(curr_mod, scalar_reduced, self[k]);
     }
     return self;
 }
 
+#define HEHUB_INSTANTIATE_RNS_OPERATORS(Word)                                  \
+    template const BasicRnsIntVec<Word> &operator+=(                           \
+        BasicRnsIntVec<Word> &, const BasicRnsIntVec<Word> &);                 \
+    template const BasicRnsIntVec<Word> &operator-=(                           \
+        BasicRnsIntVec<Word> &, const BasicRnsIntVec<Word> &);                 \
+    template const BasicRnsIntVec<Word> &add_inplace_lazy(                     \
+        BasicRnsIntVec<Word> &, const BasicRnsIntVec<Word> &);                 \
+    template const BasicRnsIntVec<Word> &sub_inplace_lazy(                     \
+        BasicRnsIntVec<Word> &, const BasicRnsIntVec<Word> &);                 \
+    template BasicRnsIntVec<Word> operator*(const BasicRnsIntVec<Word> &,      \
+                                            const BasicRnsIntVec<Word> &);     \
+    template const BasicRnsIntVec<Word> &operator*=(BasicRnsIntVec<Word> &,    \
+                                                    const u64);                \
+    template const BasicRnsIntVec<Word> &operator*=(BasicRnsIntVec<Word> &,    \
+                                                    const std::vector<u64> &);
+
+HEHUB_INSTANTIATE_RNS_OPERATORS(u64)
+HEHUB_INSTANTIATE_RNS_OPERATORS(u32)
+
+static void __check_view_operands(const RnsPolyView &self,
+                                  const RnsPolyConstView &b) {
+    if (self.dimension() != b.dimension()) {
+        throw std::invalid_argument("Operands' poly len mismatch.");
+    }
+    if (self.component_count() != b.component_count() ||
+        !std::equal(self.moduli(), self.moduli() + self.component_count(),
+                    b.moduli())) {
+        throw std::invalid_argument("Operands' moduli mismatch.");
+    }
+}
+
+void add_inplace(RnsPolyView self, RnsPolyConstView b) {
+    __check_view_operands(self, b);
+    const auto dimension = self.dimension();
+    for (size_t k = 0; k < self.component_count(); k++) {
+        const auto modulus_doubled = 2 * self.modulus_at(k);
+        auto self_k = self[k];
+        auto b_k = b[k];
+        for (size_t i = 0; i < dimension; i++) {
+            self_k[i] += b_k[i];
+            self_k[i] -= (self_k[i] >= modulus_doubled) ? modulus_doubled : 0;
+        }
+    }
+}
+
+void sub_inplace(RnsPolyView self, RnsPolyConstView b) {
+    __check_view_operands(self, b);
+    const auto dimension = self.dimension();
+    for (size_t k = 0; k < self.component_count(); k++) {
+        const auto modulus_doubled = 2 * self.modulus_at(k);
+        auto self_k = self[k];
+        auto b_k = b[k];
+        for (size_t i = 0; i < dimension; i++) {
+            self_k[i] += modulus_doubled - b_k[i];
+            self_k[i] -= (self_k[i] >= modulus_doubled) ? modulus_doubled : 0;
+        }
+    }
+}
+
+void mul_inplace(RnsPolyView self, RnsPolyConstView b) {
+    __check_view_operands(self, b);
+    if (self.rep_form() == PolyRepForm::coeff ||
+        b.rep_form() == PolyRepForm::coeff) {
+        throw std::invalid_argument("Operands are in coefficient form.");
+    }
+    const auto dimension = self.dimension();
+    for (size_t k = 0; k < self.component_count(); k++) {
+        auto self_k = self[k];
+        batched_mul_mod_hybrid_lazy(self.modulus_at(k), dimension, self_k,
+                                    b[k], self_k);
+    }
+}
+
 #ifdef HEHUB_DEBUG_FHE
-std::ostream &operator<<(std::ostream &out, const RnsIntVec &rns_poly) {
+template <typename Word>
+std::ostream &operator<<(std::ostream &out,
+                         const BasicRnsIntVec<Word> &rns_poly) {
     auto component_count = rns_poly.component_count();
     auto dimension = rns_poly.dimension();
     auto &moduli = rns_poly.modulus_vec();
@@ -187,6 +321,9 @@ std::ostream &operator<<(std::ostream &out, const RnsIntVec &rns_poly) {
 
     return out;
 }
+
+template std::ostream &operator<<(std::ostream &, const BasicRnsIntVec<u64> &);
+template std::ostream &operator<<(std::ostream &, const BasicRnsIntVec<u32> &);
 #endif
 
 } // namespace hehub
@@ -7,41 +7,85 @@
 
 #include "allocator.h"
 #include "type_defs.h"
+#include <algorithm>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 
 namespace hehub {
 
-class RnsIntVec {
-public:
-    struct Params {
-        size_t dimension = 0;
+/// @brief The parameters of an RNS integer vector, i.e. the dimension and the
+/// moduli of the components, which are shared by all the word types.
+struct RnsIntVecParams {
+    size_t dimension = 0;
 
-        size_t component_count;
+    size_t component_count;
 
-        std::vector<u64> moduli;
-    };
+    std::vector<u64> moduli;
+};
 
-    using ComponentData = SmartArray<u64>;
+/// @brief The representation form of a polynomial, coefficients or values.
+enum class PolyRepForm { coeff, value };
+
+/// @brief An upper bound of the values, i.e. [0, q) or [0, 2q) for the modulus
+/// q of each component.
+enum class PolyValueBound { q, two_q };
+
+/// @brief The bound of the moduli of the components stored in a word type, so
+/// that the lazy values in [0, 2q) and their sums fit in the words.
+template <typename Word>
+constexpr u64 WORD_MODULUS_BOUND = (u64)1 << (sizeof(Word) * 8 - 2);
+
+/// @brief Whether the components of a parameter set fit in a word type, e.g.
+/// the moduli less than 2^30 whose components take 32-bit words, which halves
+/// the memory traffic of the kernels.
+template <typename Word>
+inline bool moduli_fit_words(const RnsIntVecParams &params) {
+    return std::all_of(params.moduli.begin(),
+                       params.moduli.begin() + params.component_count,
+                       [](u64 modulus) {
+                           return modulus < WORD_MODULUS_BOUND<Word>;
+                       });
+}
 
-    enum class RepForm { coeff, value };
+/**
+ * @brief A vector of integers in RNS, i.e. its components modulo each modulus,
+ * whose values are stored in words of the type Word. The moduli are kept in
+ * 64 bits whatever the word type.
+ */
+template <typename Word = u64> class BasicRnsIntVec {
+public:
+    using Params = RnsIntVecParams;
+
+    using ComponentData = SmartArray<Word>;
 
-    RnsIntVec() {}
+    BasicRnsIntVec() {}
 
-    RnsIntVec(const size_t dimension, const size_t components,
-              const std::vector<u64> &moduli);
+    BasicRnsIntVec(const size_t dimension, const size_t components,
+                   const std::vector<u64> &moduli);
 
-    RnsIntVec(const Params &params);
+    BasicRnsIntVec(const Params &params);
 
-    RnsIntVec(const RnsIntVec &other) = default;
+    BasicRnsIntVec(const BasicRnsIntVec &other) = default;
 
-    RnsIntVec(RnsIntVec &&other) = default;
+    BasicRnsIntVec(BasicRnsIntVec &&other) = default;
+
+    /// @brief Copy the values of a vector on another word type, whose moduli
+    /// should fit in the words of this one.
+    template <typename OtherWord>
+    explicit BasicRnsIntVec(const BasicRnsIntVec<OtherWord> &other)
+        : BasicRnsIntVec(other.params()) {
+        for (size_t k = 0; k < components_.size(); k++) {
+            std::copy(other[k].begin(), other[k].end(),
+                      components_[k].begin());
+        }
+    }
 
-    RnsIntVec &operator=(const RnsIntVec &other) = default;
+    BasicRnsIntVec &operator=(const BasicRnsIntVec &other) = default;
 
-    RnsIntVec &operator=(RnsIntVec &&other) = default;
+    BasicRnsIntVec &operator=(BasicRnsIntVec &&other) = default;
 
-    inline const bool operator==(const RnsIntVec &other) const {
+    inline const bool operator==(const BasicRnsIntVec &other) const {
         return log_dimension_ == other.log_dimension_ &&
                dimension_ == other.dimension_ && moduli_ == other.moduli_ &&
                components_ == other.components_;
@@ -87,158 +131,352 @@ public:
 
     void remove_components(size_t removing = 1);
 
-    friend const RnsIntVec &operator+=(RnsIntVec &self, const RnsIntVec &b);
+private:
+    size_t log_dimension_ = 0;
 
-    friend RnsIntVec operator+(const RnsIntVec &a, const RnsIntVec &b);
+    size_t dimension_ = 0;
 
-    friend const RnsIntVec &operator-=(RnsIntVec &self, const RnsIntVec &b);
+    std::vector<ComponentData> components_;
 
-    friend RnsIntVec operator-(const RnsIntVec &a, const RnsIntVec &b);
+    std::vector<u64> moduli_;
+};
+
+template <typename Word = u64>
+class BasicRnsPolynomial : public BasicRnsIntVec<Word> {
+public:
+    using BasicRnsIntVec<Word>::BasicRnsIntVec;
 
-    friend const RnsIntVec &operator*=(RnsIntVec &self, const RnsIntVec &b);
+    using RepForm = PolyRepForm;
 
-    friend RnsIntVec operator*(const RnsIntVec &a, const RnsIntVec &b);
+    using ValueBound = PolyValueBound;
 
-    friend const RnsIntVec &operator*=(RnsIntVec &self, const u64 small_scalar);
+    BasicRnsPolynomial(BasicRnsIntVec<Word> &&rns_int_vec)
+        : BasicRnsIntVec<Word>(rns_int_vec) {}
 
-    friend const RnsIntVec &operator*=(RnsIntVec &self,
-                                       const std::vector<u64> &rns_scalar);
+    /// @brief Copy a polynomial on another word type, with its representation
+    /// form and value bound.
+    template <typename OtherWord>
+    explicit BasicRnsPolynomial(const BasicRnsPolynomial<OtherWord> &other)
+        : BasicRnsIntVec<Word>(other), rep_form(other.rep_form),
+          value_bound(other.value_bound) {}
+
+    /// Representation form of the polynomial, default being coefficients.
+    /// This is set to be publicly visible in order to enable possible tweaks.
+    RepForm rep_form = RepForm::coeff;
+
+    /// The bound of the values, by which the reductions to [0, q) are skipped
+    /// if the values are already reduced. It defaults to [0, 2q), the output
+    /// range of the lazy kernels, and is set by the operators and the kernels
+    /// taking an RnsPolynomial. Code writing the components directly should
+    /// set it as well if it may break a bound of [0, q).
+    ValueBound value_bound = ValueBound::two_q;
+};
+
+using RnsIntVec = BasicRnsIntVec<u64>;
+
+using RnsPolynomial = BasicRnsPolynomial<u64>;
+
+/// The vectors and polynomials on 32-bit words, for the moduli less than 2^30.
+using RnsIntVec32 = BasicRnsIntVec<u32>;
+
+using RnsPolynomial32 = BasicRnsPolynomial<u32>;
+
+using RnsPolyParams = RnsIntVecParams;
+
+/**
+ * @brief A read-only view of a range of the components of an RnsPolynomial,
+ * i.e. the dimension, the components and their moduli, without copying them.
+ * The view is valid as long as the polynomial keeps its components.
+ */
+class RnsPolyConstView {
+public:
+    /// A view of all the components.
+    RnsPolyConstView(const RnsPolynomial &poly)
+        : RnsPolyConstView(poly, 0, poly.component_count()) {}
+
+    /// A view of the components [begin, begin + count).
+    RnsPolyConstView(const RnsPolynomial &poly, size_t begin, size_t count)
+        : components_(poly.components().data() + begin),
+          moduli_(poly.modulus_vec().data() + begin), count_(count),
+          dimension_(poly.dimension()), log_dimension_(poly.log_dimension()),
+          rep_form_(poly.rep_form) {
+        if (begin + count > poly.component_count()) {
+            throw std::invalid_argument("Components out of range.");
+        }
+    }
+
+    inline size_t component_count() const { return count_; }
+
+    inline size_t dimension() const { return dimension_; }
+
+    inline size_t log_dimension() const { return log_dimension_; }
+
+    inline u64 modulus_at(size_t k) const { return moduli_[k]; }
+
+    inline const u64 *moduli() const { return moduli_; }
+
+    inline PolyRepForm rep_form() const { return rep_form_; }
+
+    inline const u64 *operator[](size_t k) const {
+        return components_[k].data();
+    }
+
+    /// @brief A view of the components [begin, begin + count) of this view.
+    inline RnsPolyConstView subview(size_t begin, size_t count) const {
+        if (begin + count > count_) {
+            throw std::invalid_argument("Components out of range.");
+        }
+        auto sub = *this;
+        sub.components_ += begin;
+        sub.moduli_ += begin;
+        sub.count_ = count;
+        return sub;
+    }
 
 private:
-    size_t log_dimension_ = 0;
+    friend class RnsPolyView;
+
+    RnsPolyConstView() {}
+
+    const RnsIntVec::ComponentData *components_ = nullptr;
+
+    const u64 *moduli_ = nullptr;
+
+    size_t count_ = 0;
 
     size_t dimension_ = 0;
 
-    std::vector<ComponentData> components_;
+    size_t log_dimension_ = 0;
 
-    std::vector<u64> moduli_;
+    PolyRepForm rep_form_ = PolyRepForm::coeff;
 };
 
-class RnsPolynomial : public RnsIntVec {
+/**
+ * @brief A mutable view of a range of the components of an RnsPolynomial, see
+ * RnsPolyConstView. The operations through a view leave the representation
+ * form and the value bound of the polynomial to the caller.
+ */
+class RnsPolyView {
 public:
-    using RnsIntVec::RnsIntVec;
+    /// A view of all the components.
+    RnsPolyView(RnsPolynomial &poly)
+        : RnsPolyView(poly, 0, poly.component_count()) {}
+
+    /// A view of the components [begin, begin + count).
+    RnsPolyView(RnsPolynomial &poly, size_t begin, size_t count)
+        : components_(poly.components().data() + begin),
+          moduli_(poly.modulus_vec().data() + begin), count_(count),
+          dimension_(poly.dimension()), log_dimension_(poly.log_dimension()),
+          rep_form_(poly.rep_form) {
+        if (begin + count > poly.component_count()) {
+            throw std::invalid_argument("Components out of range.");
+        }
+    }
 
-    enum class RepForm { coeff, value };
+    inline operator RnsPolyConstView() const {
+        RnsPolyConstView view;
+        view.components_ = components_;
+        view.moduli_ = moduli_;
+        view.count_ = count_;
+        view.dimension_ = dimension_;
+        view.log_dimension_ = log_dimension_;
+        view.rep_form_ = rep_form_;
+        return view;
+    }
 
-    RnsPolynomial(RnsIntVec &&rns_int_vec) : RnsIntVec(rns_int_vec) {}
+    inline size_t component_count() const { return count_; }
 
-    friend void ntt_negacyclic_inplace_lazy(RnsPolynomial &);
+    inline size_t dimension() const { return dimension_; }
 
-    friend void intt_negacyclic_inplace_lazy(RnsPolynomial &);
+    inline size_t log_dimension() const { return log_dimension_; }
 
-    friend const RnsPolynomial &operator+=(RnsPolynomial &self,
-                                           const RnsPolynomial &b);
+    inline u64 modulus_at(size_t k) const { return moduli_[k]; }
 
-    friend RnsPolynomial operator+(const RnsPolynomial &a,
-                                   const RnsPolynomial &b);
+    inline const u64 *moduli() const { return moduli_; }
 
-    friend const RnsPolynomial &operator-=(RnsPolynomial &self,
-                                           const RnsPolynomial &b);
+    inline PolyRepForm rep_form() const { return rep_form_; }
 
-    friend RnsPolynomial operator-(const RnsPolynomial &a,
-                                   const RnsPolynomial &b);
+    /// The data of the k-th component, which is copied first if it is shared
+    /// with other polynomials.
+    inline u64 *operator[](size_t k) const { return components_[k].data(); }
 
-    friend const RnsPolynomial &operator*=(RnsPolynomial &self,
-                                           const RnsPolynomial &b);
+    /// @brief A view of the components [begin, begin + count) of this view.
+    inline RnsPolyView subview(size_t begin, size_t count) const {
+        if (begin + count > count_) {
+            throw std::invalid_argument("Components out of range.");
+        }
+        auto sub = *this;
+        sub.components_ += begin;
+        sub.moduli_ += begin;
+        sub.count_ = count;
+        return sub;
+    }
 
-    friend RnsPolynomial operator*(const RnsPolynomial &a,
-                                   const RnsPolynomial &b);
+private:
+    RnsIntVec::ComponentData *components_;
 
-    friend const RnsPolynomial &operator*=(RnsPolynomial &self,
-                                           const u64 small_scalar);
+    const u64 *moduli_;
 
-    friend const RnsPolynomial &operator*=(RnsPolynomial &self,
-                                           const std::vector<u64> &rns_scalar);
+    size_t count_;
 
-    /// Representation form of the polynomial, default being coefficients.
-    /// This is set to be publicly visible in order to enable possible tweaks.
-    RepForm rep_form = RepForm::coeff;
+    size_t dimension_;
+
+    size_t log_dimension_;
+
+    PolyRepForm rep_form_;
 };
 
-using RnsPolyParams = RnsPolynomial::Params;
+/// @brief self += b componentwise, for the values of both in [0, 2q), leaving
+/// those of the sum in [0, 2q).
+void add_inplace(RnsPolyView self, RnsPolyConstView b);
+
+/// @brief self -= b componentwise, for the values of both in [0, 2q), leaving
+/// those of the difference in [0, 2q).
+void sub_inplace(RnsPolyView self, RnsPolyConstView b);
 
-using PolyRepForm = RnsPolynomial::RepForm;
+/// @brief self *= b pointwise, for both in value form, leaving the values of
+/// the product in [0, 2q).
+void mul_inplace(RnsPolyView self, RnsPolyConstView b);
+
+/*
+ * The operators below are instantiated for the vectors and polynomials on
+ * 64-bit and 32-bit words. The scalars are given in 64 bits and reduced modulo
+ * each modulus.
+ */
 
-const RnsIntVec &operator+=(RnsIntVec &self, const RnsIntVec &b);
+template <typename Word>
+const BasicRnsIntVec<Word> &operator+=(BasicRnsIntVec<Word> &self,
+                                       const BasicRnsIntVec<Word> &b);
 
-inline RnsIntVec operator+(const RnsIntVec &a, const RnsIntVec &b) {
+template <typename Word>
+inline BasicRnsIntVec<Word> operator+(const BasicRnsIntVec<Word> &a,
+                                      const BasicRnsIntVec<Word> &b) {
     auto result(a);
     result += b;
     return result;
 }
 
-const RnsIntVec &operator-=(RnsIntVec &self, const RnsIntVec &b);
-
-inline RnsIntVec operator-(const RnsIntVec &a, const RnsIntVec &b) {
+template <typename Word>
+const BasicRnsIntVec<Word> &operator-=(BasicRnsIntVec<Word> &self,
+                                       const BasicRnsIntVec<Word> &b);
+
+/// @brief self += b without the correction, for the values of both operands in
+/// [0, q), leaving those of the sum in [0, 2q).
+template <typename Word>
+const BasicRnsIntVec<Word> &add_inplace_lazy(BasicRnsIntVec<Word> &self,
+                                             const BasicRnsIntVec<Word> &b);
+
+/// @brief self -= b without the correction, for the values of both operands in
+/// [0, q), leaving those of the difference in [0, 2q).
+template <typename Word>
+const BasicRnsIntVec<Word> &sub_inplace_lazy(BasicRnsIntVec<Word> &self,
+                                             const BasicRnsIntVec<Word> &b);
+
+template <typename Word>
+inline BasicRnsIntVec<Word> operator-(const BasicRnsIntVec<Word> &a,
+                                      const BasicRnsIntVec<Word> &b) {
     auto result(a);
     result -= b;
     return result;
 }
 
-RnsIntVec operator*(const RnsIntVec &a, const RnsIntVec &b);
+template <typename Word>
+BasicRnsIntVec<Word> operator*(const BasicRnsIntVec<Word> &a,
+                               const BasicRnsIntVec<Word> &b);
 
-inline const RnsIntVec &operator*=(RnsIntVec &self, const RnsIntVec &b) {
+template <typename Word>
+inline const BasicRnsIntVec<Word> &operator*=(BasicRnsIntVec<Word> &self,
+                                              const BasicRnsIntVec<Word> &b) {
     auto temp(self);
     return self = temp * b;
 }
 
-const RnsIntVec &operator*=(RnsIntVec &self, const u64 small_scalar);
+template <typename Word>
+const BasicRnsIntVec<Word> &operator*=(BasicRnsIntVec<Word> &self,
+                                       const u64 small_scalar);
 
-inline RnsIntVec operator*(const RnsIntVec &int_vec, const u64 small_scalar) {
+template <typename Word>
+inline BasicRnsIntVec<Word> operator*(const BasicRnsIntVec<Word> &int_vec,
+                                      const u64 small_scalar) {
     auto int_vec_copy(int_vec);
     int_vec_copy *= small_scalar;
     return int_vec_copy;
 }
 
-const RnsIntVec &operator*=(RnsIntVec &self,
-                            const std::vector<u64> &rns_scalar);
+template <typename Word>
+const BasicRnsIntVec<Word> &operator*=(BasicRnsIntVec<Word> &self,
+                                       const std::vector<u64> &rns_scalar);
 
-inline RnsIntVec operator*(const RnsIntVec &int_vec,
-                           const std::vector<u64> &rns_scalar) {
+template <typename Word>
+inline BasicRnsIntVec<Word> operator*(const BasicRnsIntVec<Word> &int_vec,
+                                      const std::vector<u64> &rns_scalar) {
     auto int_vec_copy(int_vec);
     int_vec_copy *= rns_scalar;
     return int_vec_copy;
 }
 
 #ifdef HEHUB_DEBUG_FHE
-std::ostream &operator<<(std::ostream &out, const RnsIntVec &rns_poly);
+template <typename Word>
+std::ostream &operator<<(std::ostream &out,
+                         const BasicRnsIntVec<Word> &rns_poly);
 #endif
 
-inline const RnsPolynomial &operator+=(RnsPolynomial &self,
-                                       const RnsPolynomial &b) {
+template <typename Word>
+inline const BasicRnsPolynomial<Word> &
+operator+=(BasicRnsPolynomial<Word> &self, const BasicRnsPolynomial<Word> &b) {
     if (self.rep_form != b.rep_form) {
         throw std::invalid_argument(
             "Operands are in different representation form.");
     }
 
-    self += (RnsIntVec &)b;
+    // the sum of two reduced operands is less than 2q without the correction
+    if (self.value_bound == PolyValueBound::q &&
+        b.value_bound == PolyValueBound::q) {
+        add_inplace_lazy(self, b);
+    } else {
+        self += (const BasicRnsIntVec<Word> &)b;
+    }
+    self.value_bound = PolyValueBound::two_q;
     return self;
 }
 
-inline RnsPolynomial operator+(const RnsPolynomial &a, const RnsPolynomial &b) {
+template <typename Word>
+inline BasicRnsPolynomial<Word> operator+(const BasicRnsPolynomial<Word> &a,
+                                          const BasicRnsPolynomial<Word> &b) {
     auto result(a);
     result += b;
     return result;
 }
 
-inline const RnsPolynomial &operator-=(RnsPolynomial &self,
-                                       const RnsPolynomial &b) {
+template <typename Word>
+inline const BasicRnsPolynomial<Word> &
+operator-=(BasicRnsPolynomial<Word> &self, const BasicRnsPolynomial<Word> &b) {
     if (self.rep_form != b.rep_form) {
         throw std::invalid_argument(
             "Operands are in different representation form.");
     }
 
-    self -= (const RnsIntVec &)b;
+    if (self.value_bound == PolyValueBound::q &&
+        b.value_bound == PolyValueBound::q) {
+        sub_inplace_lazy(self, b);
+    } else {
+        self -= (const BasicRnsIntVec<Word> &)b;
+    }
+    self.value_bound = PolyValueBound::two_q;
     return self;
 }
 
-inline RnsPolynomial operator-(const RnsPolynomial &a, const RnsPolynomial &b) {
+template <typename Word>
+inline BasicRnsPolynomial<Word> operator-(const BasicRnsPolynomial<Word> &a,
+                                          const BasicRnsPolynomial<Word> &b) {
     auto result(a);
     result -= b;
     return result;
 }
 
-inline RnsPolynomial operator*(const RnsPolynomial &a, const RnsPolynomial &b) {
+template <typename Word>
+inline BasicRnsPolynomial<Word> operator*(const BasicRnsPolynomial<Word> &a,
+                                          const BasicRnsPolynomial<Word> &b) {
     if (a.rep_form == PolyRepForm::coeff) {
         throw std::invalid_argument("Operand a is in coefficient form.");
     }
@@ -246,34 +484,43 @@ inline RnsPolynomial operator*(const RnsPolynomial &a, const RnsPolynomial &b) {
         throw std::invalid_argument("Operand b is in coefficient form.");
     }
 
-    RnsPolynomial result = (const RnsIntVec &)a * (const RnsIntVec &)b;
+    BasicRnsPolynomial<Word> result =
+        (const BasicRnsIntVec<Word> &)a * (const BasicRnsIntVec<Word> &)b;
     result.rep_form = PolyRepForm::value;
 
     return result;
 }
 
-inline const RnsPolynomial &operator*=(RnsPolynomial &self,
-                                       const RnsPolynomial &b) {
+template <typename Word>
+inline const BasicRnsPolynomial<Word> &
+operator*=(BasicRnsPolynomial<Word> &self, const BasicRnsPolynomial<Word> &b) {
     auto temp(self);
     return self = temp * b;
 }
 
-inline const RnsPolynomial &operator*=(RnsPolynomial &self,
-                                       const u64 small_scalar) {
-    RnsIntVec &self_ref = self;
+template <typename Word>
+inline const BasicRnsPolynomial<Word> &
+operator*=(BasicRnsPolynomial<Word> &self, const u64 small_scalar) {
+    BasicRnsIntVec<Word> &self_ref = self;
     self_ref *= small_scalar;
+    self.value_bound = PolyValueBound::two_q;
     return self;
 }
 
-inline const RnsPolynomial &operator*=(RnsPolynomial &self,
-                                       const std::vector<u64> &rns_scalar) {
-    RnsIntVec &self_ref = self;
+template <typename Word>
+inline const BasicRnsPolynomial<Word> &
+operator*=(BasicRnsPolynomial<Word> &self,
+           const std::vector<u64> &rns_scalar) {
+    BasicRnsIntVec<Word> &self_ref = self;
     self_ref *= rns_scalar;
+    self.value_bound = PolyValueBound::two_q;
     return self;
 }
 
-inline RnsPolynomial operator*(const RnsPolynomial &poly,
-                               const std::vector<u64> &rns_scalar) {
+template <typename Word>
+inline BasicRnsPolynomial<Word>
+operator*(const BasicRnsPolynomial<Word> &poly,
+          const std::vector<u64> &rns_scalar) {
     auto poly_copy(poly);
     poly_copy *= rns_scalar;
     return poly_copy;
@@ -9,7 +9,7 @@ using namespace ranges::views;
 namespace hehub {
 
 RnsPolynomial
-rns_base_transform_from_single(const RnsPolynomial &input_rns_poly,
+rns_base_transform_from_single(RnsPolyConstView input_rns_poly,
                                const std::vector<u64> &new_moduli) {
     auto old_modulus = input_rns_poly.modulus_at(0);
     auto half_old_modulus = old_modulus / 2;
@@ -17,14 +17,17 @@ rns_base_transform_from_single(const RnsPolynomial &input_rns_poly,
 
     RnsPolyParams output_dim{dimension, new_moduli.size(), new_moduli};
     RnsPolynomial result(output_dim);
-    auto &input_poly = input_rns_poly[0];
+    auto input_poly = input_rns_poly[0];
     for (auto [component, modulus] : zip(result, new_moduli)) {
         auto modulus_multiple = (old_modulus / modulus + 1) * modulus;
-        for (auto [component_coeff, input_coeff] : zip(component, input_poly)) {
+        auto component_data = component.data();
+        for (size_t i = 0; i < dimension; i++) {
+            auto input_coeff = input_poly[i];
             if (input_coeff < half_old_modulus) {
-                component_coeff = input_coeff;
+                component_data[i] = input_coeff;
             } else {
-                component_coeff = modulus_multiple - old_modulus + input_coeff;
+                component_data[i] =
+                    modulus_multiple - old_modulus + input_coeff;
             }
         }
 
@@ -36,13 +39,13 @@ rns_base_transform_from_single(const RnsPolynomial &input_rns_poly,
     return result;
 }
 
-RnsPolynomial rns_base_transform_to_single(const RnsPolynomial &input_rns_poly,
+RnsPolynomial rns_base_transform_to_single(RnsPolyConstView input_rns_poly,
                                            const u64 new_modulus) {
     auto dimension = input_rns_poly.dimension();
-    auto &old_moduli = input_rns_poly.modulus_vec();
+    auto old_moduli = input_rns_poly.moduli();
     RnsPolyParams params{dimension, 1, std::vector{new_modulus}};
     RnsPolynomial result(params);
-    auto &result_poly = result[0];
+    auto result_poly = result[0].data();
 
     // Check if the coefficients are smaller than each old modulus. If so then
     // their composed form is equivalent to any one component.
@@ -70,16 +73,16 @@ RnsPolynomial rns_base_transform_to_single(const RnsPolynomial &input_rns_poly,
     if (small_coeff) {
         u64 new_modulus_multiple =
             (first_old_mod / new_modulus + 1) * new_modulus;
-        for (auto [result_coeff, input_coeff] :
-             zip(result_poly, input_rns_poly[0])) {
+        for (size_t i = 0; i < dimension; i++) {
+            auto input_coeff = input_rns_poly[0][i];
             if (input_coeff < half_first_old_mod) {
-                result_coeff = input_coeff;
+                result_poly[i] = input_coeff;
             } else {
-                result_coeff =
+                result_poly[i] =
                     new_modulus_multiple - first_old_mod + input_coeff;
             }
         }
-        batched_barrett(new_modulus, dimension, result_poly.data());
+        batched_barrett(new_modulus, dimension, result_poly);
         return result;
     }
 
@@ -88,8 +91,8 @@ RnsPolynomial rns_base_transform_to_single(const RnsPolynomial &input_rns_poly,
     UBIntVec big_int_poly(input_rns_poly);
     auto big_int_new_modulus = UBInt(new_modulus);
     auto big_int_old_modulus = UBInt(1);
-    for (const auto &mod : input_rns_poly.modulus_vec()) {
-        big_int_old_modulus *= UBInt(mod);
+    for (size_t k = 0; k < input_rns_poly.component_count(); k++) {
+        big_int_old_modulus *= UBInt(old_moduli[k]);
     }
     auto half_big_int_old_modulus = big_int_old_modulus / UBInt(2);
     for (size_t i = 0; i < dimension; i++) {
@@ -114,6 +117,15 @@ RnsPolynomial rns_base_transform(RnsPolynomial input_rns_poly,
     // Reduce the coefficients strictly to avoid errors caused by redundant
     // multiples of original modulus
     reduce_strict(input_rns_poly);
+    return rns_base_transform(RnsPolyConstView(input_rns_poly), new_moduli);
+}
+
+RnsPolynomial rns_base_transform(RnsPolyConstView input_rns_poly,
+                                 const std::vector<u64> &new_moduli) {
+    if (input_rns_poly.rep_form() == PolyRepForm::value) {
+        throw std::logic_error("Trying to perform RNS base transformation "
+                               "on NTT values.");
+    }
 
     if (input_rns_poly.component_count() == 1) {
         return rns_base_transform_from_single(input_rns_poly, new_moduli);
@@ -15,4 +15,14 @@ namespace hehub {
 RnsPolynomial rns_base_transform(RnsPolynomial input_poly,
                                  const std::vector<u64> &new_moduli);
 
+/**
+ * @brief The RNS base transformation of the components in a view, which are
+ * not copied, hence their values should be reduced to [0, q) already.
+ * @param input_poly The components in coefficient form.
+ * @param new_moduli The new moduli.
+ * @return RnsPolynomial The polynomial under the new moduli.
+ */
+RnsPolynomial rns_base_transform(RnsPolyConstView input_poly,
+                                 const std::vector<u64> &new_moduli);
+
 } // namespace hehub
@@ -1,26 +1,49 @@
 #include "sampling.h"
 #include "ntt.h"
+#include "profiling.h"
 #include "range/v3/view/zip.hpp"
 #include "rns.h"
 #include "type_defs.h"
+#include <atomic>
 #include <random>
 
 using namespace ranges::views;
 
 namespace hehub {
 
-std::random_device rand_dvc;
-std::default_random_engine rand_engine;
-std::uniform_int_distribution rand_ternary((i8)-1, (i8)1);
+/// The finalizer of splitmix64, which maps consecutive inputs to seemingly
+/// unrelated outputs.
+static u64 __splitmix64(u64 x) {
+    x += 0x9e3779b97f4a7c15;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+/// Each thread owns an engine, so that sampling needs no synchronization. The
+/// engines are numbered by the order in which threads first sample, and each
+/// seed is mixed from the default seed and that number, so that the streams of
+/// different threads are neither shared nor simply shifted copies.
+static std::default_random_engine &rand_engine() {
+    static std::atomic<u64> engine_count = 0;
+    thread_local std::default_random_engine engine(__splitmix64(
+        __splitmix64(std::default_random_engine::default_seed) ^
+        engine_count++));
+    return engine;
+}
 
 RnsPolynomial get_rand_ternary_poly(const RnsPolyParams &params) {
+    HEHUB_PROFILE_SCOPE(sampling, params.dimension * params.component_count *
+                                      sizeof(u64));
     RnsPolynomial tern_poly(params);
     auto dimension = params.dimension;
 
     // Sampling.
+    auto &engine = rand_engine();
+    std::uniform_int_distribution rand_ternary((i8)-1, (i8)1);
     std::vector<i8> ternary_integers(dimension);
     for (auto &t : ternary_integers) {
-        t = rand_ternary(rand_engine);
+        t = rand_ternary(engine);
     }
 
     // Transform to RNS representation.
@@ -38,16 +61,19 @@ RnsPolynomial get_rand_ternary_poly(const RnsPolyParams &params) {
 
 RnsPolynomial get_rand_uniform_poly(const RnsPolyParams &params,
                                     PolyRepForm form) {
+    HEHUB_PROFILE_SCOPE(sampling, params.dimension * params.component_count *
+                                      sizeof(u64));
     auto dimension = params.dimension;
     RnsPolynomial rand_rns_poly(params);
 
     // Sampling.
+    auto &engine = rand_engine();
     for (auto [component, modulus] :
          zip(rand_rns_poly, rand_rns_poly.modulus_vec())) {
         std::uniform_int_distribution uni_mod((u64)0, modulus - 1);
         for (auto &coeff : component) {
             // here "coeff" can also mean NTT value
-            coeff = uni_mod(rand_engine);
+            coeff = uni_mod(engine);
         }
     }
 
@@ -59,6 +85,8 @@ RnsPolynomial get_rand_uniform_poly(const RnsPolyParams &params,
 
 RnsPolynomial get_rand_gaussian_poly(const RnsPolyParams &params,
                                      double std_dev) {
+    HEHUB_PROFILE_SCOPE(sampling, params.dimension * params.component_count *
+                                      sizeof(u64));
     auto dimension = params.dimension;
     RnsPolynomial gaussian_poly(params);
 
@@ -66,10 +94,11 @@ RnsPolynomial get_rand_gaussian_poly(const RnsPolyParams &params,
     std::normal_distribution<double> rand_gaussian(0, std_dev);
 
     // Sampling.
+    auto &engine = rand_engine();
     std::vector<double> gaussians(dimension);
     for (auto &g : gaussians) {
         do {
-            g = rand_gaussian(rand_engine);
+            g = rand_gaussian(engine);
         } while (std::abs(g) > bound);
     }
 
@@ -0,0 +1,265 @@
+#include "task_runtime.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace hehub {
+
+/// A thread pool in which each worker owns a task deque. A worker pops the
+/// latest task from its own deque, and steals the earliest one from others when
+/// its own deque is empty. Tasks submitted from a worker go to its own deque,
+/// which keeps nested tasks on the same thread when the others are busy.
+class WorkStealingPool : public Executor {
+public:
+    /// Create a pool for thread_count threads in total. The thread waiting for
+    /// a task group also runs tasks, hence only thread_count - 1 workers.
+    WorkStealingPool(size_t thread_count)
+        : thread_count_(thread_count), shared_(make_shared<Shared>()) {
+        auto worker_count = thread_count - 1;
+        for (size_t i = 0; i < worker_count; i++) {
+            shared_->queues.push_back(make_unique<TaskQueue>());
+        }
+        for (size_t i = 0; i < worker_count; i++) {
+            workers_.emplace_back([shared = shared_, i]() { work(shared, i); });
+        }
+    }
+
+    /// The workers finish the queued tasks before exiting. The pool may be
+    /// destroyed by one of its own workers, when a task holds the last
+    /// reference to it, in which case that worker exits by itself later.
+    ~WorkStealingPool() {
+        {
+            lock_guard lock(shared_->sleep_mutex);
+            shared_->stopping = true;
+        }
+        shared_->wake_up.notify_all();
+        for (auto &worker : workers_) {
+            if (worker.get_id() == this_thread::get_id()) {
+                worker.detach();
+            } else {
+                worker.join();
+            }
+        }
+    }
+
+    void submit(Task task) override {
+        auto &queues = shared_->queues;
+        size_t queue_idx;
+        if (current_pool_ == shared_.get()) {
+            queue_idx = current_worker_;
+        } else {
+            queue_idx = shared_->next_queue++ % queues.size();
+        }
+        // Count the task before publishing it, so that the decrement by the
+        // worker popping it never precedes the increment.
+        {
+            lock_guard lock(shared_->sleep_mutex);
+            shared_->queued_count++;
+        }
+        {
+            lock_guard lock(queues[queue_idx]->queue_mutex);
+            queues[queue_idx]->tasks.push_back(move(task));
+        }
+        shared_->wake_up.notify_one();
+    }
+
+    size_t concurrency() const override { return thread_count_; }
+
+private:
+    struct TaskQueue {
+        mutex queue_mutex;
+        deque<Task> tasks;
+    };
+
+    /// The state shared by the pool and its workers, which outlives the pool
+    /// until all the workers exit.
+    struct Shared {
+        vector<unique_ptr<TaskQueue>> queues;
+
+        atomic<size_t> next_queue = 0;
+
+        /// The number of tasks in all the queues, including the ones being
+        /// pushed, which is only increased while holding sleep_mutex so that
+        /// no wake-up is lost.
+        atomic<size_t> queued_count = 0;
+
+        mutex sleep_mutex;
+
+        condition_variable wake_up;
+
+        bool stopping = false;
+
+        bool try_pop(size_t worker_idx, Task &task) {
+            {
+                auto &own = *queues[worker_idx];
+                lock_guard lock(own.queue_mutex);
+                if (!own.tasks.empty()) {
+                    task = move(own.tasks.back());
+                    own.tasks.pop_back();
+                    return true;
+                }
+            }
+            for (size_t i = 1; i < queues.size(); i++) {
+                auto &victim = *queues[(worker_idx + i) % queues.size()];
+                lock_guard lock(victim.queue_mutex);
+                if (!victim.tasks.empty()) {
+                    task = move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    static void work(shared_ptr<Shared> shared, size_t worker_idx) {
+        current_pool_ = shared.get();
+        current_worker_ = worker_idx;
+        Task task;
+        while (true) {
+            if (shared->try_pop(worker_idx, task)) {
+                shared->queued_count--;
+                task();
+                task = nullptr;
+                continue;
+            }
+            unique_lock lock(shared->sleep_mutex);
+            shared->wake_up.wait(lock, [&shared]() {
+                return shared->stopping || shared->queued_count > 0;
+            });
+            if (shared->stopping && shared->queued_count == 0) {
+                current_pool_ = nullptr;
+                return;
+            }
+        }
+    }
+
+    const size_t thread_count_;
+
+    shared_ptr<Shared> shared_;
+
+    vector<thread> workers_;
+
+    static thread_local Shared *current_pool_;
+
+    static thread_local size_t current_worker_;
+};
+
+thread_local WorkStealingPool::Shared *WorkStealingPool::current_pool_ =
+    nullptr;
+thread_local size_t WorkStealingPool::current_worker_ = 0;
+
+/// The executor in use, or nullptr if the operations run sequentially.
+static shared_ptr<Executor> &global_executor() {
+    static shared_ptr<Executor> executor;
+    return executor;
+}
+
+void set_thread_count(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = max(thread::hardware_concurrency(), 1U);
+    }
+    shared_ptr<Executor> pool;
+    if (thread_count > 1) {
+        pool = make_shared<WorkStealingPool>(thread_count);
+    }
+    set_executor(move(pool));
+}
+
+size_t get_thread_count() {
+    auto executor = get_executor();
+    return executor ? executor->concurrency() : 1;
+}
+
+void set_executor(shared_ptr<Executor> executor) {
+    atomic_store(&global_executor(), move(executor));
+}
+
+shared_ptr<Executor> get_executor() { return atomic_load(&global_executor()); }
+
+struct TaskGroup::State {
+    mutex state_mutex;
+
+    condition_variable all_done;
+
+    /// The tasks not started yet, which are taken either by the runners
+    /// submitted to the executor or by the waiting thread.
+    deque<Executor::Task> pending;
+
+    size_t unfinished = 0;
+
+    exception_ptr error;
+
+    /// Run one of the pending tasks, returning false if there is none.
+    bool run_one() {
+        Executor::Task task;
+        {
+            lock_guard lock(state_mutex);
+            if (pending.empty()) {
+                return false;
+            }
+            task = move(pending.front());
+            pending.pop_front();
+        }
+
+        exception_ptr task_error;
+        try {
+            task();
+        } catch (...) {
+            task_error = current_exception();
+        }
+
+        lock_guard lock(state_mutex);
+        if (task_error && !error) {
+            error = task_error;
+        }
+        if (--unfinished == 0) {
+            all_done.notify_all();
+        }
+        return true;
+    }
+};
+
+TaskGroup::TaskGroup()
+    : executor_(get_executor()), state_(make_shared<State>()) {}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void TaskGroup::spawn(Executor::Task task) {
+    {
+        lock_guard lock(state_->state_mutex);
+        state_->pending.push_back(trace_bind(profile_bind(move(task))));
+        state_->unfinished++;
+    }
+    if (executor_) {
+        executor_->submit([state = state_]() { state->run_one(); });
+    } else {
+        state_->run_one();
+    }
+}
+
+void TaskGroup::wait() {
+    while (state_->run_one()) {
+    }
+
+    unique_lock lock(state_->state_mutex);
+    state_->all_done.wait(lock, [this]() { return state_->unfinished == 0; });
+    if (state_->error) {
+        auto error = state_->error;
+        state_->error = nullptr;
+        rethrow_exception(error);
+    }
+}
+
+} // namespace hehub
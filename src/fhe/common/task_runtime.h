@@ -0,0 +1,316 @@
+/**
+ * @file task_runtime.h
+ * @brief A small task runtime on which the independent parts of HE operations
+ * (e.g. the RNS components of a polynomial, the rotations in a linear map, or
+ * the ciphertexts in a batch) are run in parallel.
+ *
+ */
+#pragma once
+
+#include "profiling.h"
+#include "tracing.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace hehub {
+
+/**
+ * @brief The interface of an executor which runs tasks submitted by the
+ * library. By default a built-in work-stealing thread pool is used, and an
+ * external executor can be plugged in via set_executor.
+ */
+class Executor {
+public:
+    using Task = std::function<void()>;
+
+    virtual ~Executor() = default;
+
+    /// @brief Run the task asynchronously. Tasks never wait for other tasks
+    /// still in the queue, so any scheduling order is deadlock-free.
+    virtual void submit(Task task) = 0;
+
+    /// @brief The number of threads on which tasks can run simultaneously,
+    /// including the thread which is waiting for them.
+    virtual size_t concurrency() const = 0;
+};
+
+/**
+ * @brief Set the number of threads used by the built-in thread pool, and
+ * switch back to the built-in pool if an external executor was set. The
+ * default is 1, in which case all the operations run on the calling thread.
+ * This should not be called while operations are running.
+ * @param thread_count The number of threads, or 0 for the number of hardware
+ * threads.
+ */
+void set_thread_count(size_t thread_count);
+
+/**
+ * @brief Get the number of threads operations are run on, as set by
+ * set_thread_count or reported by the external executor.
+ * @return size_t
+ */
+size_t get_thread_count();
+
+/**
+ * @brief Run all the tasks of the library on an external executor instead of
+ * the built-in thread pool.
+ * @param executor The external executor, or nullptr to switch back to the
+ * built-in thread pool.
+ */
+void set_executor(std::shared_ptr<Executor> executor);
+
+/**
+ * @brief Get the executor currently in use.
+ * @return The executor, or nullptr if the operations run sequentially.
+ */
+std::shared_ptr<Executor> get_executor();
+
+/**
+ * @brief A group of tasks which are spawned onto the current executor and
+ * joined together. A thread waiting for the group runs the tasks not started
+ * yet by itself, so groups can be nested (e.g. a parallel NTT inside a
+ * parallel key switching) without exhausting the threads.
+ */
+class TaskGroup {
+public:
+    TaskGroup();
+
+    TaskGroup(const TaskGroup &) = delete;
+
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    /// @brief Wait for the unfinished tasks. Exceptions thrown by them are
+    /// discarded, hence call wait() explicitly to observe them.
+    ~TaskGroup();
+
+    /// @brief Spawn a task, which is run immediately if there is no executor.
+    void spawn(Executor::Task task);
+
+    /// @brief Wait for all the spawned tasks to finish, and rethrow the first
+    /// exception thrown by them, if any.
+    void wait();
+
+private:
+    struct State;
+
+    std::shared_ptr<Executor> executor_;
+
+    std::shared_ptr<State> state_;
+};
+
+/**
+ * @brief Call func(i) for each i in [begin, end) in parallel. The range is
+ * split into at most as many contiguous chunks as the thread count, each with
+ * at least grain indices.
+ * @param begin The first index.
+ * @param end The index past the last one.
+ * @param func The function to call on each index.
+ * @param grain The minimum number of indices handled by one task.
+ */
+template <typename Func>
+void parallel_for(size_t begin, size_t end, Func &&func, size_t grain = 1) {
+    if (end <= begin) {
+        return;
+    }
+    grain = std::max(grain, (size_t)1);
+    auto total = end - begin;
+    auto max_chunks = (total + grain - 1) / grain;
+    auto chunk_count = std::min(max_chunks, get_thread_count());
+    if (chunk_count <= 1) {
+        for (auto i = begin; i < end; i++) {
+            func(i);
+        }
+        return;
+    }
+
+    TaskGroup group;
+    for (size_t c = 0; c < chunk_count; c++) {
+        auto chunk_begin = begin + total * c / chunk_count;
+        auto chunk_end = begin + total * (c + 1) / chunk_count;
+        group.spawn([&func, chunk_begin, chunk_end]() {
+            for (auto i = chunk_begin; i < chunk_end; i++) {
+                func(i);
+            }
+        });
+    }
+    group.wait();
+}
+
+template <typename T> class Future;
+
+template <typename Func>
+Future<std::invoke_result_t<Func>> run_async(Func &&func);
+
+/**
+ * @brief The result of an asynchronous task, which is available once the task
+ * finishes. A future can be copied and shared, and dependent tasks can be
+ * chained by then() without blocking the calling thread.
+ * @tparam T The type of the result, which cannot be void.
+ * @note Blocking on a future (by wait() or get()) from inside a task may
+ * deadlock when all the threads are blocked, so use then() instead there.
+ */
+template <typename T> class Future {
+public:
+    Future() {}
+
+    /// @brief Whether the future refers to a task.
+    bool valid() const { return state_ != nullptr; }
+
+    /// @brief Whether the task has finished, i.e. get() will not block.
+    bool ready() const {
+        check_valid();
+        std::lock_guard lock(state_->mutex);
+        return state_->done;
+    }
+
+    /// @brief Block until the task finishes.
+    void wait() const {
+        check_valid();
+        std::unique_lock lock(state_->mutex);
+        state_->done_cv.wait(lock, [this]() { return state_->done; });
+    }
+
+    /// @brief Block until the task finishes, and get the result or rethrow
+    /// the exception thrown by the task.
+    const T &get() const {
+        wait();
+        if (state_->error) {
+            std::rethrow_exception(state_->error);
+        }
+        return *state_->value;
+    }
+
+    /**
+     * @brief Schedule func(result) to run on the executor once this task
+     * finishes. If this task throws, func is skipped and the exception is
+     * passed on to the returned future.
+     * @param func The function to call on the result.
+     * @return The future of the result of func.
+     */
+    template <typename Func>
+    Future<std::invoke_result_t<Func, const T &>> then(Func &&func) const {
+        check_valid();
+        using U = std::invoke_result_t<Func, const T &>;
+        auto next = std::make_shared<typename Future<U>::State>();
+        auto executor = get_executor();
+        auto body = trace_bind(profile_bind(
+            [prev = state_, next, func = std::forward<Func>(func)]() {
+                if (prev->error) {
+                    next->set_error(prev->error);
+                } else {
+                    next->fulfill([&]() { return func(*prev->value); });
+                }
+            }));
+        state_->on_done([executor, body = std::move(body)]() {
+            if (executor) {
+                executor->submit(body);
+            } else {
+                body();
+            }
+        });
+        return Future<U>(next);
+    }
+
+private:
+    template <typename U> friend class Future;
+
+    template <typename Func>
+    friend Future<std::invoke_result_t<Func>> run_async(Func &&func);
+
+    struct State {
+        std::mutex mutex;
+
+        std::condition_variable done_cv;
+
+        bool done = false;
+
+        std::optional<T> value;
+
+        std::exception_ptr error;
+
+        /// The callbacks to run when the task finishes.
+        std::vector<std::function<void()>> continuations;
+
+        template <typename Func> void fulfill(Func &&func) {
+            try {
+                value.emplace(func());
+            } catch (...) {
+                error = std::current_exception();
+            }
+            finish();
+        }
+
+        void set_error(std::exception_ptr task_error) {
+            error = task_error;
+            finish();
+        }
+
+        void finish() {
+            std::vector<std::function<void()>> callbacks;
+            {
+                std::lock_guard lock(mutex);
+                done = true;
+                callbacks.swap(continuations);
+            }
+            done_cv.notify_all();
+            for (auto &callback : callbacks) {
+                callback();
+            }
+        }
+
+        void on_done(std::function<void()> callback) {
+            {
+                std::lock_guard lock(mutex);
+                if (!done) {
+                    continuations.push_back(std::move(callback));
+                    return;
+                }
+            }
+            callback();
+        }
+    };
+
+    explicit Future(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+    /// Throw if the future was default-constructed and refers to no task.
+    void check_valid() const {
+        if (!state_) {
+            throw std::logic_error("Future does not refer to a task.");
+        }
+    }
+
+    std::shared_ptr<State> state_;
+};
+
+/**
+ * @brief Run func() asynchronously on the executor. If the operations run
+ * sequentially (i.e. the thread count is 1 and no executor is set), func is
+ * run before returning.
+ * @param func The function to run, which is copied into the task.
+ * @return The future of the result of func.
+ */
+template <typename Func>
+Future<std::invoke_result_t<Func>> run_async(Func &&func) {
+    using T = std::invoke_result_t<Func>;
+    auto state = std::make_shared<typename Future<T>::State>();
+    auto body =
+        trace_bind(profile_bind([state, func = std::forward<Func>(func)]() {
+            state->fulfill(func);
+        }));
+    if (auto executor = get_executor()) {
+        executor->submit(body);
+    } else {
+        body();
+    }
+    return Future<T>(state);
+}
+
+} // namespace hehub
@@ -0,0 +1,170 @@
+#include "tracing.h"
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace hehub {
+
+atomic<bool> __trace_enabled = false;
+
+namespace {
+
+i64 __now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+               chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+struct TraceEvent {
+    const char *name;
+
+    char phase;
+
+    u64 timestamp;
+};
+
+/// The events recorded by one thread, which are kept after the thread exits
+/// until flushed.
+struct ThreadBuffer {
+    mutex buffer_mutex;
+
+    vector<TraceEvent> events;
+
+    size_t tid;
+};
+
+struct TraceRegistry {
+    mutex registry_mutex;
+
+    vector<shared_ptr<ThreadBuffer>> buffers;
+
+    /// The options, which may be read by other threads when tracing starts.
+    atomic<size_t> sample_period = 1;
+
+    atomic<size_t> max_events = 0;
+
+    /// The start time in nanoseconds, from which the timestamps count.
+    atomic<i64> epoch = 0;
+
+    /// The number of top-level operations seen, for sampling.
+    atomic<size_t> operation_count = 0;
+
+    /// The number of events in all the buffers.
+    atomic<size_t> event_count = 0;
+};
+
+TraceRegistry &registry() {
+    static TraceRegistry global_registry;
+    return global_registry;
+}
+
+ThreadBuffer &thread_buffer() {
+    thread_local shared_ptr<ThreadBuffer> buffer = []() {
+        auto &reg = registry();
+        auto new_buffer = make_shared<ThreadBuffer>();
+        lock_guard lock(reg.registry_mutex);
+        new_buffer->tid = reg.buffers.size() + 1;
+        reg.buffers.push_back(new_buffer);
+        return new_buffer;
+    }();
+    return *buffer;
+}
+
+thread_local TraceSpan::Context thread_context;
+
+void record(const char *name, char phase) {
+    auto &reg = registry();
+    auto timestamp = __now_ns() - reg.epoch.load(memory_order_relaxed);
+    auto &buffer = thread_buffer();
+    {
+        lock_guard lock(buffer.buffer_mutex);
+        buffer.events.push_back(TraceEvent{name, phase, (u64)timestamp});
+    }
+    reg.event_count.fetch_add(1, memory_order_relaxed);
+}
+
+} // namespace
+
+void trace_start(const TraceOptions &options) {
+    auto &reg = registry();
+    {
+        lock_guard lock(reg.registry_mutex);
+        for (auto &buffer : reg.buffers) {
+            lock_guard buffer_lock(buffer->buffer_mutex);
+            buffer->events.clear();
+        }
+        reg.sample_period = max(options.sample_period, (size_t)1);
+        reg.max_events = options.max_events;
+        reg.epoch = __now_ns();
+        reg.operation_count = 0;
+        reg.event_count = 0;
+    }
+    __trace_enabled = true;
+}
+
+void trace_stop() { __trace_enabled = false; }
+
+size_t trace_flush(ostream &out) {
+    auto &reg = registry();
+    lock_guard lock(reg.registry_mutex);
+    out << "{\"traceEvents\":[";
+    size_t written = 0;
+    for (auto &buffer : reg.buffers) {
+        vector<TraceEvent> events;
+        {
+            lock_guard buffer_lock(buffer->buffer_mutex);
+            events.swap(buffer->events);
+        }
+        for (auto &event : events) {
+            out << (written++ ? ",\n" : "\n") << "{\"name\":\"" << event.name
+                << "\",\"ph\":\"" << event.phase
+                << "\",\"ts\":" << event.timestamp / 1000 << "."
+                << to_string(1000 + event.timestamp % 1000).substr(1)
+                << ",\"pid\":1,\"tid\":" << buffer->tid << "}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    reg.event_count.fetch_sub(min(written, reg.event_count.load()));
+    return written;
+}
+
+size_t trace_flush(const string &path) {
+    ofstream out(path);
+    return trace_flush(out);
+}
+
+void TraceSpan::begin() {
+    auto &reg = registry();
+    if (thread_context.depth == 0) {
+        auto index = reg.operation_count.fetch_add(1, memory_order_relaxed);
+        thread_context.sampled =
+            index % reg.sample_period == 0 &&
+            reg.event_count.load(memory_order_relaxed) < reg.max_events;
+    }
+    thread_context.depth++;
+    entered_ = true;
+    if (thread_context.sampled) {
+        record(name_, 'B');
+        recorded_ = true;
+    }
+}
+
+void TraceSpan::end() {
+    thread_context.depth--;
+    if (recorded_) {
+        record(name_, 'E');
+    }
+}
+
+TraceSpan::Context TraceSpan::current_context() { return thread_context; }
+
+TraceSpan::Context TraceSpan::exchange_context(Context context) {
+    swap(thread_context, context);
+    return context;
+}
+
+} // namespace hehub
@@ -0,0 +1,137 @@
+/**
+ * @file tracing.h
+ * @brief Timeline tracing of the HE operations and their internal phases
+ * (ModUp, NTT, key MAC, ModDown, rescaling), written in the Chrome trace event
+ * format which can be viewed in chrome://tracing or Perfetto. The events are
+ * compiled in only if HEHUB_TRACE is defined, and recorded only between
+ * trace_start() and trace_stop().
+ *
+ */
+#pragma once
+
+#include "type_defs.h"
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <utility>
+
+namespace hehub {
+
+struct TraceOptions {
+    /// Trace one in this many top-level operations, where the phases and the
+    /// parallel tasks of an operation follow its choice. The default traces
+    /// everything.
+    size_t sample_period = 1;
+
+    /// The buffer capacity in events, beyond which new operations are not
+    /// traced until the buffer is flushed.
+    size_t max_events = 1 << 20;
+};
+
+/// @brief Start recording events, discarding the events not flushed.
+void trace_start(const TraceOptions &options = TraceOptions());
+
+/// @brief Stop recording events. The recorded ones are kept until flushed.
+void trace_stop();
+
+/**
+ * @brief Write the recorded events as a Chrome trace JSON object and clear
+ * the buffer. This can be called while tracing, e.g. periodically.
+ * @param out The output stream.
+ * @return The number of events written.
+ */
+size_t trace_flush(std::ostream &out);
+
+/// @brief Write the recorded events to a file, see trace_flush(std::ostream&).
+size_t trace_flush(const std::string &path);
+
+extern std::atomic<bool> __trace_enabled;
+
+/// @brief Whether events are being recorded.
+inline bool trace_enabled() {
+    return __trace_enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Record a begin event when created and the matching end event when
+ * destroyed, on the current thread. Use HEHUB_TRACE_SPAN instead, which is
+ * compiled out when tracing is disabled.
+ */
+class TraceSpan {
+public:
+    /// @param name A string literal, which is referred to by the event.
+    explicit TraceSpan(const char *name) : name_(name) {
+        if (trace_enabled()) {
+            begin();
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    ~TraceSpan() {
+        if (entered_) {
+            end();
+        }
+    }
+
+    /// The tracing state of a thread, which is passed on to the tasks it
+    /// spawns.
+    struct Context {
+        /// The nesting depth of the spans, where 0 means the thread is not
+        /// inside any operation.
+        size_t depth = 0;
+
+        /// Whether the operation is sampled.
+        bool sampled = false;
+    };
+
+    static Context current_context();
+
+    /// @brief Set the tracing state of this thread, returning the previous
+    /// one.
+    static Context exchange_context(Context context);
+
+private:
+    void begin();
+
+    void end();
+
+    const char *name_;
+
+    /// Whether the span is counted in the nesting depth of the thread.
+    bool entered_ = false;
+
+    /// Whether the begin event is recorded, hence the end event should be.
+    bool recorded_ = false;
+};
+
+#ifdef HEHUB_TRACE
+
+/// @brief Wrap a task so that it follows the sampling decision of the
+/// operation during which it is created.
+template <typename Func> auto trace_bind(Func &&func) {
+    return [context = TraceSpan::current_context(),
+            func = std::forward<Func>(func)]() {
+        struct Restore {
+            TraceSpan::Context previous;
+            ~Restore() { TraceSpan::exchange_context(previous); }
+        } restore{TraceSpan::exchange_context(context)};
+        return func();
+    };
+}
+
+#define HEHUB_TRACE_SPAN(name) ::hehub::TraceSpan __trace_span(name)
+
+#else
+
+template <typename Func> std::decay_t<Func> trace_bind(Func &&func) {
+    return std::forward<Func>(func);
+}
+
+#define HEHUB_TRACE_SPAN(name) ((void)0)
+
+#endif
+
+} // namespace hehub
@@ -21,6 +21,13 @@ using u32 = __uint32_t;
 using u64 = __uint64_t;
 using u128 = __uint128_t;
 
+/// @brief The unsigned integer type twice as wide as a word, which holds the
+/// products of words.
+template <typename Word> struct DoubleWordOf;
+template <> struct DoubleWordOf<u32> { using type = u64; };
+template <> struct DoubleWordOf<u64> { using type = u128; };
+template <typename Word> using DoubleWord = typename DoubleWordOf<Word>::type;
+
 using cc_double = std::complex<double>;
 using cc_long_double = std::complex<long double>;
 
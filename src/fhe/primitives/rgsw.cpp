@@ -1,7 +1,11 @@
 #include "rgsw.h"
 #include "fhe/common/mod_arith.h"
 #include "fhe/common/ntt.h"
+#include "fhe/common/profiling.h"
+#include "fhe/common/task_runtime.h"
+#include "fhe/common/tracing.h"
 #include "range/v3/view/zip.hpp"
+#include <algorithm>
 
 using namespace std;
 using namespace ranges::views;
@@ -54,45 +58,23 @@ RgswCt rgsw_encrypt_montgomery(const RlwePt &pt_ntt, const RlweSk &sk,
     return rgsw;
 }
 
-RlweCt ext_prod_montgomery(const RlwePt &pt, const RgswCt &rgsw) {
+vector<RnsPolynomial> ext_prod_decompose(const RlwePt &pt,
+                                         const u64 additional_mod) {
+    HEHUB_TRACE_SPAN("ModUp");
     const auto &moduli = pt.modulus_vec();
-    if (rgsw.empty()) {
-        throw invalid_argument("Empty RGSW ciphertext.");
-    }
-
-    auto extended_moduli = rgsw[0][0].modulus_vec();
     const auto original_components = pt.component_count();
     const auto extended_components = original_components + 1;
-    if (extended_moduli.size() < extended_components) {
-        throw invalid_argument("Invalid component number in RGSW ciphertext.");
-    }
-    extended_moduli.resize(extended_components);
-    *extended_moduli.rbegin() = *rgsw[0][0].modulus_vec().crbegin();
-    for (auto [modulus_rgsw, modulus_pt] : zip(extended_moduli, moduli)) {
-        if (modulus_rgsw != modulus_pt) {
-            throw invalid_argument("Moduli mismatch.");
-        }
-    }
-
     const auto dimension = pt.dimension();
     const auto log_dimension = pt.log_dimension();
-    for (auto &rlwe_sample : rgsw) {
-        for (auto &poly : rlwe_sample) {
-            if (poly.dimension() != dimension) {
-                throw invalid_argument("Polynomial lengths mismatch.");
-            }
-            if (poly.component_count() != extended_components ||
-                poly.modulus_vec() != extended_moduli) {
-                throw invalid_argument("Inconsistent RGSW ciphertext.");
-            }
-        }
-    }
+    auto extended_moduli = moduli;
+    extended_moduli.push_back(additional_mod);
 
     // The decomposed pt, which forms the component matrix
     vector<RnsPolynomial> decomposed(original_components);
     RnsPolyParams extended_params{dimension, extended_components, extended_moduli};
     for (auto &rns_poly : decomposed) {
         rns_poly = RnsPolynomial(extended_params);
+        rns_poly.rep_form = PolyRepForm::value;
     }
 
     // The components on the diagonal are reserved
@@ -105,8 +87,9 @@ RlweCt ext_prod_montgomery(const RlwePt &pt, const RgswCt &rgsw) {
     reduce_strict(pt_intt);
 
     // Copy the components not on the diagonal
-    for (size_t poly_idx = 0; poly_idx < original_components; poly_idx++) {
-        for (int compo_idx = 0; compo_idx < extended_components; compo_idx++) {
+    parallel_for(0, original_components, [&](size_t poly_idx) {
+        for (size_t compo_idx = 0; compo_idx < extended_components;
+             compo_idx++) {
             if (compo_idx == poly_idx) {
                 continue;
             }
@@ -116,43 +99,132 @@ RlweCt ext_prod_montgomery(const RlwePt &pt, const RgswCt &rgsw) {
                                         extended_moduli[compo_idx],
                                         decomposed[poly_idx][compo_idx].data());
         }
+    });
+
+    return decomposed;
+}
+
+RlweCt ext_prod_montgomery(const vector<RnsPolynomial> &decomposed,
+                           const RgswCt &rgsw) {
+    if (rgsw.empty()) {
+        throw invalid_argument("Empty RGSW ciphertext.");
+    }
+    if (decomposed.empty()) {
+        throw invalid_argument("Empty decomposition.");
     }
 
+    // The RGSW ciphertext may be created for more moduli than the decomposed
+    // pt, in which case only the rows and components for the moduli of pt and
+    // the additional modulus are used.
+    const auto &extended_moduli = decomposed[0].modulus_vec();
+    const auto original_components = decomposed.size();
+    const auto extended_components = original_components + 1;
+    const auto dimension = decomposed[0].dimension();
+    const auto &rgsw_moduli = rgsw[0][0].modulus_vec();
+    const auto rgsw_components = rgsw_moduli.size();
+    if (rgsw.size() < original_components ||
+        rgsw_components < extended_components) {
+        throw invalid_argument("Invalid component number in RGSW ciphertext.");
+    }
+    for (size_t k = 0; k < original_components; k++) {
+        if (rgsw_moduli[k] != extended_moduli[k]) {
+            throw invalid_argument("Moduli mismatch.");
+        }
+    }
+    if (rgsw_moduli.back() != extended_moduli.back()) {
+        throw invalid_argument("Moduli mismatch.");
+    }
+    for (auto &rns_poly : decomposed) {
+        if (rns_poly.dimension() != dimension ||
+            rns_poly.modulus_vec() != extended_moduli) {
+            throw invalid_argument("Inconsistent decomposition.");
+        }
+    }
+    for (size_t poly_idx = 0; poly_idx < original_components; poly_idx++) {
+        for (auto &poly : rgsw[poly_idx]) {
+            if (poly.dimension() != dimension) {
+                throw invalid_argument("Polynomial lengths mismatch.");
+            }
+            if (poly.modulus_vec() != rgsw_moduli) {
+                throw invalid_argument("Inconsistent RGSW ciphertext.");
+            }
+        }
+    }
+
+    HEHUB_TRACE_SPAN("KeyMAC");
+    // the key material touched, i.e. two polynomials per row
+    HEHUB_PROFILE_SCOPE(key_switch, original_components * 2 *
+                                        extended_components * dimension *
+                                        sizeof(u64));
+
+    RnsPolyParams extended_params{dimension, extended_components,
+                                  extended_moduli};
     RlweCt ct_tilde{RnsPolynomial(extended_params),
                     RnsPolynomial(extended_params)};
-    u128 temp_sum[dimension];
 
-    // Multiply the matrices with the RGSW
-    for (auto half : {0, 1}) {
-        // modulo original moduli part
-        for (int k = 0; k < original_components; k++) {
-            fill(temp_sum, temp_sum + dimension, (u128)0);
-            for (int poly_idx = 0; poly_idx < original_components; poly_idx++) {
-                for (int i = 0; i < dimension; i++) {
-                    temp_sum[i] += (u128)decomposed[poly_idx][k][i] *
-                                   rgsw[poly_idx][half][k][i];
+    // Multiply the matrices with the RGSW, where each of the two halves and
+    // each component (modulo the original moduli or the new modulus) is an
+    // independent task.
+    parallel_for(0, 2 * extended_components, [&](size_t task_idx) {
+        auto half = task_idx / extended_components;
+        auto k = task_idx % extended_components;
+        auto rgsw_k = k == original_components ? rgsw_components - 1 : k;
+        const auto modulus = extended_moduli[k];
+        const auto modulus_doubled = 2 * modulus;
+        auto result = ct_tilde[half][k].data();
+
+        // The products are less than 4q^2 as both factors are in [0, 2q),
+        // hence summing less than 2^62 / q of them keeps the Montgomery
+        // reduction within u128 and its result in [0, 2q). The reduction is
+        // linear, so the partial sums are reduced and added.
+        const size_t chunk_size = ((1ULL << 62) - 1) / modulus;
+        vector<u128> temp_sum(dimension);
+        vector<u64> reduced(dimension);
+        for (size_t chunk_begin = 0; chunk_begin < original_components;
+             chunk_begin += chunk_size) {
+            auto chunk_end =
+                min(chunk_begin + chunk_size, original_components);
+            fill(temp_sum.begin(), temp_sum.end(), 0);
+            for (size_t poly_idx = chunk_begin; poly_idx < chunk_end;
+                 poly_idx++) {
+                const auto decomposed_comp = decomposed[poly_idx][k].data();
+                const auto rgsw_comp = rgsw[poly_idx][half][rgsw_k].data();
+                for (size_t i = 0; i < dimension; i++) {
+                    temp_sum[i] += (u128)decomposed_comp[i] * rgsw_comp[i];
                 }
             }
-            batched_montgomery_128_lazy(moduli[k], dimension, temp_sum,
-                                        ct_tilde[half][k].data());
-        }
-
-        // modulo new modulus part
-        fill(temp_sum, temp_sum + dimension, (u128)0);
-        for (int poly_idx = 0; poly_idx < original_components; poly_idx++) {
-            for (int i = 0; i < dimension; i++) {
-                temp_sum[i] += (u128)(*decomposed[poly_idx].last())[i] *
-                               (*rgsw[poly_idx][half].last())[i];
+            if (chunk_begin == 0) {
+                batched_montgomery_128_lazy(modulus, dimension,
+                                            temp_sum.data(), result);
+                continue;
+            }
+            batched_montgomery_128_lazy(modulus, dimension, temp_sum.data(),
+                                        reduced.data());
+            for (size_t i = 0; i < dimension; i++) {
+                result[i] += reduced[i];
+                result[i] -=
+                    (result[i] >= modulus_doubled) ? modulus_doubled : 0;
             }
         }
-        batched_montgomery_128_lazy(*extended_moduli.crbegin(), dimension,
-                                    temp_sum, ct_tilde[half].last()->data());
+    });
 
-        // Set as NTT value form
+    // Set as NTT value form
+    for (auto half : {0, 1}) {
         ct_tilde[half].rep_form = PolyRepForm::value;
     }
 
     return ct_tilde;
 }
 
+RlweCt ext_prod_montgomery(const RlwePt &pt, const RgswCt &rgsw) {
+    if (rgsw.empty()) {
+        throw invalid_argument("Empty RGSW ciphertext.");
+    }
+    if (pt.dimension() != rgsw[0][0].dimension()) {
+        throw invalid_argument("Polynomial lengths mismatch.");
+    }
+    auto additional_mod = rgsw[0][0].modulus_vec().back();
+    return ext_prod_montgomery(ext_prod_decompose(pt, additional_mod), rgsw);
+}
+
 } // namespace hehub
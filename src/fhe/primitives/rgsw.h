@@ -41,6 +41,30 @@ RgswCt rgsw_encrypt(const RlwePt &pt_ntt, const RlweSk &sk,
 RgswCt rgsw_encrypt_montgomery(const RlwePt &pt_ntt, const RlweSk &sk, 
                                const std::vector<std::vector<u64>> &decomp_basis);
 
+/**
+ * @brief Decompose a polynomial into its RNS components, each lifted to the
+ * moduli of the polynomial together with an additional modulus and
+ * transformed to NTT form. This is the first half of ext_prod_montgomery, and
+ * the result can be shared by several external products with the same input
+ * (e.g. rotations of one ciphertext by different steps).
+ * @param pt The polynomial in NTT form.
+ * @param additional_mod The additional modulus of the RGSW ciphertexts.
+ * @return The decomposed polynomials, one for each component of pt.
+ */
+std::vector<RnsPolynomial> ext_prod_decompose(const RlwePt &pt,
+                                              const u64 additional_mod);
+
+/**
+ * @brief Multiply a decomposed polynomial with an RGSW ciphertext, which is
+ * the second half of ext_prod_montgomery. The RGSW ciphertext may be created
+ * under more moduli than the polynomial, i.e. at a higher level.
+ * @param decomposed The output of ext_prod_decompose.
+ * @param rgsw The RGSW ciphertext in Montgomery form.
+ * @return RlweCt
+ */
+RlweCt ext_prod_montgomery(const std::vector<RnsPolynomial> &decomposed,
+                           const RgswCt &rgsw);
+
 /**
  * @brief TODO
  *
@@ -2,7 +2,10 @@
 #include "fhe/common/mod_arith.h"
 #include "fhe/common/ntt.h"
 #include "fhe/common/primelists.h"
+#include "fhe/common/profiling.h"
 #include "fhe/common/sampling.h"
+#include "fhe/common/task_runtime.h"
+#include <algorithm>
 
 namespace hehub {
 
@@ -28,6 +31,22 @@ RlweParams create_params(size_t dimension, std::vector<int> moduli_bits) {
     return params;
 }
 
+size_t max_modulus_bits(size_t dimension, SecurityLevel level) {
+    static const std::vector<size_t> dimensions{1024, 2048,  4096,
+                                                8192, 16384, 32768};
+    static const std::vector<std::vector<size_t>> max_bits{
+        {27, 54, 109, 218, 438, 881},
+        {19, 37, 75, 152, 305, 611},
+        {14, 29, 58, 118, 237, 476}};
+
+    for (size_t i = 0; i < dimensions.size(); i++) {
+        if (dimensions[i] == dimension) {
+            return max_bits[(size_t)level][i];
+        }
+    }
+    throw std::invalid_argument("No security estimate for this dimension.");
+}
+
 RlweSk::RlweSk(const RlweParams &params)
     : RnsPolynomial(get_rand_ternary_poly(params)) {}
 
@@ -70,9 +89,32 @@ RlweCt encrypt_core(const RlwePt &pt, const RlweSk &sk) {
     return RlweCt{std::move(c0), std::move(c1)};
 }
 
-RlwePt decrypt_core(const RlweCt &ct, const RlweSk &sk) {
+RlwePt decrypt_core(const RlweCt &ct, const RlweSk &sk,
+                    size_t component_count) {
     auto &[c0, c1] = ct;
-    auto pt = c0 + c1 * sk;
+    if (component_count == 0) {
+        component_count = c0.component_count();
+    }
+    if (component_count > c0.component_count()) {
+        throw std::invalid_argument(
+            "Cannot decrypt with more components than the ciphertext has.");
+    }
+    if (component_count > sk.component_count()) {
+        throw std::invalid_argument("Secret key has too few components.");
+    }
+
+    // Only the first components of c0 + c1 * sk are computed.
+    const auto dimension = c0.dimension();
+    RlwePt pt(dimension, component_count, c0.modulus_vec());
+    for (size_t k = 0; k < component_count; k++) {
+        if (sk.modulus_at(k) != c0.modulus_at(k)) {
+            throw std::invalid_argument("Secret key moduli mismatch.");
+        }
+        batched_mul_mod_hybrid_lazy(c0.modulus_at(k), dimension, c1[k].data(),
+                                    sk[k].data(), pt[k].data());
+    }
+    pt.rep_form = PolyRepForm::value;
+    pt += c0;
 
     // the obtained plaintext is now in NTT value representation
     intt_negacyclic_inplace_lazy(pt);
@@ -80,6 +122,46 @@ RlwePt decrypt_core(const RlweCt &ct, const RlweSk &sk) {
     return pt;
 }
 
+/// Whether the centered values of the first component are congruent to those
+/// of the second one, which holds if and only if the first component alone
+/// represents the polynomial, provided that the coefficients are less than
+/// q_0 * q_1 / 2 in magnitude. The values should be reduced to [0, q).
+static bool __first_component_suffices(const RlwePt &pt) {
+    const auto first_mod = pt.modulus_at(0);
+    const auto second_mod = pt.modulus_at(1);
+    const auto half_first_mod = first_mod / 2;
+    const u64 one_harvey = ((u128)1 << 64) / second_mod;
+    const auto &first = pt[0];
+    const auto &second = pt[1];
+    bool congruent = true;
+    for (size_t i = 0; i < pt.dimension(); i++) {
+        const bool negative = first[i] > half_first_mod;
+        const u64 abs_value = negative ? first_mod - first[i] : first[i];
+        u64 lifted = mul_mod_harvey_lazy(second_mod, abs_value, 1, one_harvey);
+        lifted -= (lifted >= second_mod) ? second_mod : 0;
+        lifted = (negative && lifted != 0) ? second_mod - lifted : lifted;
+        congruent &= lifted == second[i];
+    }
+    return congruent;
+}
+
+RlwePt decrypt_core_minimal(const RlweCt &ct, const RlweSk &sk) {
+    const auto components = ct[0].component_count();
+    if (components == 1) {
+        return decrypt_core(ct, sk);
+    }
+
+    // The second component checks whether the first one suffices, otherwise
+    // the decryption is redone with all the components.
+    auto pt = decrypt_core(ct, sk, 2);
+    if (__first_component_suffices(pt)) {
+        pt.remove_components();
+        pt.value_bound = PolyValueBound::q;
+        return pt;
+    }
+    return components == 2 ? pt : decrypt_core(ct, sk);
+}
+
 RlweCt add(const RlweCt &ct1, const RlweCt &ct2) {
     return RlweCt{ct1[0] + ct2[0], ct1[1] + ct2[1]};
 }
@@ -100,4 +182,426 @@ RlweCt mult_plain_core(const RlweCt &ct, const RlwePt &pt) {
     return RlweCt{ct[0] * pt, ct[1] * pt};
 }
 
+/// Check that the polynomials of a ciphertext have the same primes.
+static void __check_ct_form(const RlweCt &ct) {
+    if (ct[0].modulus_vec() != ct[1].modulus_vec()) {
+        throw std::invalid_argument(
+            "Ill-formed ciphertext: modulus sets mismatch.");
+    }
+    if (ct[0].dimension() != ct[1].dimension()) {
+        throw std::invalid_argument(
+            "Ill-formed ciphertext: polynomial lengths mismatch.");
+    }
+    if (ct[0].component_count() != ct[1].component_count()) {
+        throw std::invalid_argument(
+            "Ill-formed ciphertext: component numbers mismatch.");
+    }
+}
+
+void tensor_product(const RlweCt &ct1, const RlweCt &ct2,
+                    std::array<RnsPolynomial, 3> &ct_prod) {
+    __check_ct_form(ct1);
+    __check_ct_form(ct2);
+    for (auto ct : {&ct1, &ct2}) {
+        if ((*ct)[0].rep_form == PolyRepForm::coeff ||
+            (*ct)[1].rep_form == PolyRepForm::coeff) {
+            throw std::invalid_argument("Operand is in coefficient form.");
+        }
+    }
+    if (ct1[0].dimension() != ct2[0].dimension()) {
+        throw std::invalid_argument("Operands' poly len mismatch.");
+    }
+    const auto dimension = ct1[0].dimension();
+    const auto components =
+        std::min(ct1[0].component_count(), ct2[0].component_count());
+    auto moduli(ct1[0].modulus_vec()), moduli2(ct2[0].modulus_vec());
+    moduli.resize(components);
+    moduli2.resize(components);
+    if (moduli != moduli2) {
+        throw std::invalid_argument("Operands' moduli mismatch.");
+    }
+
+    for (auto &rns_poly : ct_prod) {
+        if (rns_poly.dimension() != dimension ||
+            rns_poly.modulus_vec() != moduli) {
+            rns_poly = RnsPolynomial(RnsPolyParams{dimension, components, moduli});
+        }
+        rns_poly.rep_form = PolyRepForm::value;
+        rns_poly.value_bound = PolyValueBound::two_q;
+    }
+    parallel_for(0, components, [&](size_t k) {
+        batched_tensor_mul_mod_hybrid_lazy(
+            moduli[k], dimension, ct1[0][k].data(), ct1[1][k].data(),
+            ct2[0][k].data(), ct2[1][k].data(), ct_prod[0][k].data(),
+            ct_prod[1][k].data(), ct_prod[2][k].data());
+    });
+}
+
+RlweCt linear_combination_core(
+    const std::vector<std::reference_wrapper<const RlweCt>> &cts,
+    const std::vector<u64> &rns_weights) {
+    if (cts.empty()) {
+        throw std::invalid_argument("No ciphertexts to combine.");
+    }
+    const RlweCt &first = cts[0];
+    for (const RlweCt &ct : cts) {
+        __check_ct_form(ct);
+        if (ct[0].dimension() != first[0].dimension() ||
+            ct[0].modulus_vec() != first[0].modulus_vec()) {
+            throw std::invalid_argument(
+                "The ciphertexts to combine have different primes.");
+        }
+    }
+    const auto &moduli = first[0].modulus_vec();
+    const auto dimension = first[0].dimension();
+    const auto component_count = first[0].component_count();
+    const auto ct_count = cts.size();
+    if (rns_weights.size() != ct_count * component_count) {
+        throw std::invalid_argument("Numbers of the weights mismatch.");
+    }
+
+    RnsPolyParams params{dimension, component_count, moduli};
+    RlweCt result{RnsPolynomial(params), RnsPolynomial(params)};
+    for (auto &rns_poly : result) {
+        rns_poly.rep_form = PolyRepForm::value;
+        rns_poly.value_bound = PolyValueBound::two_q;
+    }
+
+    parallel_for(0, 2 * component_count, [&](size_t task_idx) {
+        const auto poly_idx = task_idx / component_count;
+        const auto k = task_idx % component_count;
+        std::vector<const u64 *> in_vecs(ct_count);
+        std::vector<u64> weights(ct_count);
+        for (size_t j = 0; j < ct_count; j++) {
+            const RlweCt &ct = cts[j];
+            in_vecs[j] = ct[poly_idx][k].data();
+            weights[j] = rns_weights[j * component_count + k];
+        }
+        batched_linear_combination_lazy(moduli[k], dimension, ct_count,
+                                        in_vecs.data(), weights.data(),
+                                        result[poly_idx][k].data());
+    });
+
+    return result;
+}
+
+void CtAccumulator::add(const RlweCt &ct) {
+    __check_ct_form(ct);
+    if (count_ == 0) {
+        sum_ = ct;
+        const auto &moduli = ct[0].modulus_vec();
+        pending_.assign(moduli.size(), 0);
+        capacity_.resize(moduli.size());
+        for (size_t k = 0; k < moduli.size(); k++) {
+            // a reduced sum in [0, 2q) plus the values in [0, 2q) added
+            capacity_[k] = (u64)(-1) / (2 * moduli[k]) - 1;
+        }
+        count_ = 1;
+        return;
+    }
+    if (ct[0].dimension() != sum_[0].dimension() ||
+        ct[0].modulus_vec() != sum_[0].modulus_vec()) {
+        throw std::invalid_argument(
+            "The ciphertext mismatches the primes of the sum.");
+    }
+
+    const auto dimension = sum_[0].dimension();
+    const auto &moduli = sum_[0].modulus_vec();
+    for (size_t k = 0; k < moduli.size(); k++) {
+        if (pending_[k] == capacity_[k]) {
+            for (auto &rns_poly : sum_) {
+                batched_barrett_lazy(moduli[k], dimension, rns_poly[k].data());
+            }
+            pending_[k] = 0;
+        }
+        for (size_t poly_idx = 0; poly_idx < 2; poly_idx++) {
+            auto sum_comp = sum_[poly_idx][k].data();
+            const auto comp = ct[poly_idx][k].data();
+            for (size_t i = 0; i < dimension; i++) {
+                sum_comp[i] += comp[i];
+            }
+        }
+        pending_[k]++;
+    }
+    count_++;
+}
+
+RlweCt CtAccumulator::result() const {
+    if (count_ == 0) {
+        throw std::logic_error("No ciphertexts accumulated.");
+    }
+    auto result = sum_;
+    const auto dimension = result[0].dimension();
+    const auto &moduli = result[0].modulus_vec();
+    for (auto &rns_poly : result) {
+        for (size_t k = 0; k < moduli.size(); k++) {
+            if (pending_[k]) {
+                batched_barrett_lazy(moduli[k], dimension, rns_poly[k].data());
+            }
+        }
+        rns_poly.value_bound = PolyValueBound::two_q;
+    }
+    return result;
+}
+
+/**
+ * Drop the last d primes p_0, ..., p_{d-1} of ct, i.e. divide it by their
+ * product M with rounding. If the addends are given, the last prime is the
+ * special one P, which is excluded from the plaintext factor of BGV, and
+ * P * addend is added to the polynomial before the division, where an addend
+ * is modulo all the primes of ct but P.
+ *
+ * The remainder [c]_M is found in the mixed radix y_0 + y_1 p_0 + ... +
+ * y_{d-1} p_0 ... p_{d-2} by Garner's algorithm, which is centered by a
+ * lexicographic comparison with (M - 1) / 2, whose digits are (p_j - 1) / 2.
+ */
+static void
+__drop_last_primes(RlweCt &ct, const size_t drop_count,
+                   const u64 plain_modulus,
+                   const std::array<const RnsPolynomial *, 2> &addends) {
+    __check_ct_form(ct);
+    const auto ct_mod_count = ct[0].component_count();
+    if (drop_count >= ct_mod_count) {
+        throw std::invalid_argument("Unable to drop all the primes.");
+    }
+    const bool with_addends = addends[0] || addends[1];
+    for (auto addend : addends) {
+        if (addend && (addend->dimension() != ct[0].dimension() ||
+                       addend->component_count() != ct_mod_count - 1 ||
+                       !std::equal(addend->modulus_vec().begin(),
+                                   addend->modulus_vec().end(),
+                                   ct[0].modulus_vec().begin()))) {
+            throw std::invalid_argument(
+                "The addend mismatches the primes of the ciphertext.");
+        }
+    }
+
+    const auto ct_moduli = ct[0].modulus_vec();
+    const auto dimension = ct[0].dimension();
+    const auto log_dimension = ct[0].log_dimension();
+    const auto remaining_count = ct_mod_count - drop_count;
+    HEHUB_PROFILE_SCOPE(rescale, 2 * ct_mod_count * dimension * sizeof(u64));
+    const auto dropped = ct_moduli.data() + remaining_count;
+    const auto special_mod = ct_moduli.back();
+    auto harvey = [](u64 factor, u64 modulus) {
+        return (u64)(((u128)factor << 64) / modulus);
+    };
+
+    // The constants of the dropped primes, where the prefix products are
+    // p_0 ... p_{l-1} modulo p_j for the Garner digits.
+    std::vector<u64> halves(drop_count);
+    std::vector<u64> inv_t(drop_count, 1);
+    std::vector<u64> special_reduced(drop_count);
+    std::vector<std::vector<u64>> prefix(drop_count);
+    std::vector<u64> inv_prefix(drop_count);
+    for (size_t j = 0; j < drop_count; j++) {
+        const auto p_j = dropped[j];
+        halves[j] = p_j / 2;
+        if (plain_modulus) {
+            inv_t[j] = inverse_mod_prime(plain_modulus % p_j, p_j);
+        }
+        special_reduced[j] = special_mod % p_j;
+        prefix[j].resize(j + 1);
+        prefix[j][0] = 1;
+        for (size_t l = 1; l <= j; l++) {
+            prefix[j][l] = (u128)prefix[j][l - 1] * (dropped[l - 1] % p_j) % p_j;
+        }
+        inv_prefix[j] = inverse_mod_prime(prefix[j][j], p_j);
+    }
+
+    // The digit y_j is lifted modulo q_i as y_j * p_0 ... p_{j-1} * s, where s
+    // is 1 or t, and the correction added for a remainder >= M / 2 centers it.
+    // The result is multiplied by M^{-1}, and by the plaintext factor M / P or
+    // M modulo t for BGV, which keeps the plaintext.
+    u64 plain_factor = 1;
+    if (plain_modulus) {
+        for (size_t j = 0; j < drop_count - (with_addends ? 1 : 0); j++) {
+            plain_factor =
+                (u128)plain_factor * (dropped[j] % plain_modulus) % plain_modulus;
+        }
+    }
+    std::vector<std::vector<u64>> weights(remaining_count);
+    std::vector<u64> corrections(remaining_count);
+    std::vector<u64> result_factors(remaining_count);
+    for (size_t k = 0; k < remaining_count; k++) {
+        const auto q_i = ct_moduli[k];
+        const u64 lift_factor = plain_modulus ? plain_modulus % q_i : 1;
+        u64 weight = lift_factor;
+        u64 product = 1;
+        weights[k].resize(drop_count);
+        for (size_t j = 0; j < drop_count; j++) {
+            weights[k][j] = weight;
+            weight = (u128)weight * (dropped[j] % q_i) % q_i;
+            product = (u128)product * (dropped[j] % q_i) % q_i;
+        }
+        corrections[k] = q_i - weight;
+        result_factors[k] =
+            (u128)inverse_mod_prime(product, q_i) * (plain_factor % q_i) % q_i;
+    }
+
+    // the dropped components in coefficient form, reduced strictly
+    parallel_for(0, 2 * drop_count, [&](size_t task_idx) {
+        const auto poly_idx = task_idx / drop_count;
+        const auto j = task_idx % drop_count;
+        const auto p_j = dropped[j];
+        const u64 p_j_doubled = 2 * p_j;
+        auto comp = ct[poly_idx][remaining_count + j].data();
+        const auto addend = addends[poly_idx];
+        if (addend && remaining_count + j < ct_mod_count - 1) {
+            const auto add_comp = (*addend)[remaining_count + j].data();
+            const auto factor_harvey = harvey(special_reduced[j], p_j);
+            for (size_t i = 0; i < dimension; i++) {
+                u64 sum = comp[i] + mul_mod_harvey_lazy(p_j, add_comp[i],
+                                                        special_reduced[j],
+                                                        factor_harvey);
+                sum -= p_j_doubled & -(u64)(sum >= p_j_doubled);
+                comp[i] = sum;
+            }
+        }
+        {
+            // the raw transforms record no span of their own
+            HEHUB_TRACE_SPAN("INTT");
+            intt_negacyclic_inplace_lazy(log_dimension, p_j, comp);
+        }
+        if (plain_modulus) {
+            const u64 inv_t_harvey = harvey(inv_t[j], p_j);
+            for (size_t i = 0; i < dimension; i++) {
+                comp[i] = mul_mod_harvey_lazy(p_j, comp[i], inv_t[j],
+                                              inv_t_harvey);
+            }
+        }
+        batched_reduce_strict(p_j, dimension, comp);
+    });
+
+    // The Garner digits replace the dropped components in place, and the sign
+    // of the centered remainder is kept in the top bit of the last digit.
+    const u64 sign_bit = 1ULL << 63;
+    parallel_for(0, 2, [&](size_t poly_idx) {
+        std::vector<u64 *> digits(drop_count);
+        for (size_t j = 0; j < drop_count; j++) {
+            digits[j] = ct[poly_idx][remaining_count + j].data();
+        }
+        std::vector<std::vector<u64>> prefix_harvey(drop_count);
+        std::vector<u64> inv_prefix_harvey(drop_count);
+        for (size_t j = 0; j < drop_count; j++) {
+            for (auto factor : prefix[j]) {
+                prefix_harvey[j].push_back(harvey(factor, dropped[j]));
+            }
+            inv_prefix_harvey[j] = harvey(inv_prefix[j], dropped[j]);
+        }
+        for (size_t i = 0; i < dimension; i++) {
+            for (size_t j = 1; j < drop_count; j++) {
+                const auto p_j = dropped[j];
+                const u64 p_j_doubled = 2 * p_j;
+                u64 partial = 0;
+                for (size_t l = 0; l < j; l++) {
+                    partial += mul_mod_harvey_lazy(p_j, digits[l][i],
+                                                   prefix[j][l],
+                                                   prefix_harvey[j][l]);
+                    partial -= p_j_doubled & -(u64)(partial >= p_j_doubled);
+                }
+                u64 digit = mul_mod_harvey_lazy(
+                    p_j, digits[j][i] + p_j_doubled - partial, inv_prefix[j],
+                    inv_prefix_harvey[j]);
+                digit -= p_j & -(u64)(digit >= p_j);
+                digits[j][i] = digit;
+            }
+            bool centered_negative = true;
+            for (size_t j = drop_count; j-- > 0;) {
+                if (digits[j][i] != halves[j]) {
+                    centered_negative = digits[j][i] > halves[j];
+                    break;
+                }
+            }
+            digits[drop_count - 1][i] |= sign_bit & -(u64)centered_negative;
+        }
+    });
+
+    parallel_for(0, 2 * remaining_count, [&](size_t task_idx) {
+        const auto poly_idx = task_idx / remaining_count;
+        auto &rns_poly = ct[poly_idx];
+        const auto k = task_idx % remaining_count;
+        const auto q_i = ct_moduli[k];
+        const u64 q_i_doubled = 2 * q_i;
+        std::vector<u64> weights_harvey(drop_count);
+        for (size_t j = 0; j < drop_count; j++) {
+            weights_harvey[j] = harvey(weights[k][j], q_i);
+        }
+        // read through a const reference, as the other tasks share the digits
+        const auto &digit_poly = rns_poly;
+        std::vector<const u64 *> digits(drop_count);
+        for (size_t j = 0; j < drop_count; j++) {
+            digits[j] = digit_poly[remaining_count + j].data();
+        }
+
+        SmartArray<u64> remainder(dimension);
+        for (size_t i = 0; i < dimension; i++) {
+            u64 lifted = 0;
+            for (size_t j = 0; j + 1 < drop_count; j++) {
+                lifted += mul_mod_harvey_lazy(q_i, digits[j][i], weights[k][j],
+                                              weights_harvey[j]);
+                lifted -= q_i_doubled & -(u64)(lifted >= q_i_doubled);
+            }
+            const auto top = digits[drop_count - 1][i];
+            lifted += mul_mod_harvey_lazy(q_i, top & ~sign_bit,
+                                          weights[k][drop_count - 1],
+                                          weights_harvey[drop_count - 1]);
+            lifted -= q_i_doubled & -(u64)(lifted >= q_i_doubled);
+            lifted += corrections[k] & -(top >> 63);
+            lifted -= q_i_doubled & -(u64)(lifted >= q_i_doubled);
+            remainder[i] = lifted;
+        }
+        {
+            HEHUB_TRACE_SPAN("NTT");
+            ntt_negacyclic_inplace_lazy(log_dimension, q_i, remainder.data());
+        }
+
+        const auto addend = addends[poly_idx];
+        if (addend) {
+            const auto comp = rns_poly[k].data();
+            const auto add_comp = (*addend)[k].data();
+            const auto special_reduced = special_mod % q_i;
+            const auto special_harvey = harvey(special_reduced, q_i);
+            const auto result_harvey = harvey(result_factors[k], q_i);
+            for (size_t i = 0; i < dimension; i++) {
+                u64 sum = comp[i] + mul_mod_harvey_lazy(q_i, add_comp[i],
+                                                        special_reduced,
+                                                        special_harvey);
+                sum -= q_i_doubled & -(u64)(sum >= q_i_doubled);
+                comp[i] = mul_mod_harvey_lazy(
+                    q_i, sum + q_i_doubled - remainder[i], result_factors[k],
+                    result_harvey);
+            }
+        } else {
+            batched_sub_mul_scalar_lazy(q_i, dimension, rns_poly[k].data(),
+                                        remainder.data(), result_factors[k]);
+        }
+    });
+
+    for (auto &rns_poly : ct) {
+        rns_poly.remove_components(drop_count);
+        rns_poly.value_bound = PolyValueBound::two_q;
+    }
+}
+
+void drop_last_primes_inplace(RlweCt &ct, const size_t dropping_primes,
+                              const u64 plain_modulus) {
+    if (dropping_primes == 0) {
+        throw std::invalid_argument(
+            "The number of primes to be dropped is not positive.");
+    }
+    __drop_last_primes(ct, dropping_primes, plain_modulus, {nullptr, nullptr});
+}
+
+void mod_down_and_drop_inplace(RlweCt &ct_tilde, const RnsPolynomial *addend0,
+                               const RnsPolynomial *addend1,
+                               const size_t dropping_primes,
+                               const u64 plain_modulus) {
+    if (!addend0 && !addend1) {
+        throw std::invalid_argument("No addend given.");
+    }
+    __drop_last_primes(ct_tilde, dropping_primes + 1, plain_modulus,
+                       {addend0, addend1});
+}
+
 } // namespace hehub
@@ -7,6 +7,7 @@
 
 #include "fhe/common/rns.h"
 #include <array>
+#include <functional>
 
 namespace hehub {
 
@@ -22,6 +23,22 @@ using RlweParams = RnsPolynomial::Params;
  */
 RlweParams create_params(size_t dimension, std::vector<int> modulus_bits);
 
+/// @brief The classical security levels of the homomorphic encryption
+/// standard, with ternary secrets.
+enum class SecurityLevel { classical_128, classical_192, classical_256 };
+
+/**
+ * @brief The maximum bit length of the modulus (including the additional
+ * moduli of key switching) allowed at a security level by the homomorphic
+ * encryption standard.
+ * @param dimension The RLWE dimension, which is a power of 2 from 1024 to
+ * 32768.
+ * @param level The security level.
+ * @return The maximum log2 of the modulus.
+ */
+size_t max_modulus_bits(size_t dimension,
+                        SecurityLevel level = SecurityLevel::classical_128);
+
 using RlwePt = RnsPolynomial;
 
 using RlweCt = std::array<RnsPolynomial, 2>;
@@ -66,13 +83,29 @@ RlweCt get_rlwe_sample(const RlweSk &sk, size_t components = 0);
 RlweCt encrypt_core(const RlwePt &pt, const RlweSk &sk);
 
 /**
- * @brief TODO
- *
- * @param ct
- * @param sk
- * @return RlwePt
+ * @brief Decrypt a ciphertext with its first components only, i.e. the result
+ * is c0 + c1 * sk modulo the product of their moduli, which is the plaintext
+ * (plus the noise) if the latter is less than half of the product.
+ * @param ct The ciphertext.
+ * @param sk The secret key.
+ * @param component_count The number of components to decrypt with, where 0
+ * means all of them.
+ * @return RlwePt The plaintext under the first component_count moduli, in
+ * coefficient form.
  */
-RlwePt decrypt_core(const RlweCt &ct, const RlweSk &sk);
+RlwePt decrypt_core(const RlweCt &ct, const RlweSk &sk,
+                    size_t component_count = 0);
+
+/**
+ * @brief Decrypt a ciphertext with its first component alone whenever that
+ * suffices, which is checked by decrypting with the second one as well, and
+ * otherwise with all of them. This costs two components instead of all in the
+ * common case of a plaintext less than half of the first modulus.
+ * @param ct The ciphertext.
+ * @param sk The secret key.
+ * @return RlwePt The plaintext under the first one or all of the moduli.
+ */
+RlwePt decrypt_core_minimal(const RlweCt &ct, const RlweSk &sk);
 
 /**
  * @brief TODO
@@ -119,4 +152,101 @@ RlweCt sub_plain_core(const RlweCt &ct, const RlwePt &pt);
  */
 RlweCt mult_plain_core(const RlweCt &ct, const RlwePt &pt);
 
+/**
+ * @brief Compute the tensor product of two ciphertexts in NTT form, i.e. the
+ * quadratic ciphertext (c0 d0, c0 d1 + c1 d0, c1 d1), by one fused kernel per
+ * prime which reads each input component once and reduces each output once.
+ * As for the product of polynomials, it is modulo the primes common to both.
+ * @param ct1 The first ciphertext.
+ * @param ct2 The second ciphertext.
+ * @param ct_prod The output, whose polynomials are reused if they already have
+ * the primes of the product, and allocated otherwise.
+ */
+void tensor_product(const RlweCt &ct1, const RlweCt &ct2,
+                    std::array<RnsPolynomial, 3> &ct_prod);
+
+/**
+ * @brief Compute the linear combination sum_j w_j * ct_j of ciphertexts with
+ * scalar weights in one sweep, where for each component the products are
+ * accumulated in 128 bits and reduced only when the sum might overflow.
+ * @param cts The ciphertexts, which have the same primes.
+ * @param rns_weights The weights reduced modulo each prime, where that of
+ * ct_j modulo the k-th prime is rns_weights[j * component_count + k].
+ * @return RlweCt
+ */
+RlweCt linear_combination_core(
+    const std::vector<std::reference_wrapper<const RlweCt>> &cts,
+    const std::vector<u64> &rns_weights);
+
+/**
+ * @brief Drop the last primes of a ciphertext in NTT form, dividing both
+ * polynomials by their product M with rounding, i.e. c' = (c - [c]_M) / M
+ * modulo the other primes, where [c]_M is centered. This is the rescaling of
+ * CKKS and the ModDown after key switching. The remainder is found from the
+ * dropped components by Garner's algorithm, and for each remaining prime it
+ * is lifted and reduced on the way into its NTT, and the subtraction and the
+ * division are one pass, where only one component of scratch is used per task.
+ * Hence dropping several primes takes one pass instead of one per prime.
+ * @param ct The ciphertext, whose polynomials have the same primes.
+ * @param dropping_primes The number of primes to drop, less than the number
+ * of primes of ct.
+ * @param plain_modulus If nonzero, the remainder is the multiple of t congruent
+ * to c modulo M, i.e. t * [c / t]_M, and the result is multiplied by M modulo
+ * t, which is the modulus switching of BGV keeping the plaintext.
+ */
+void drop_last_primes_inplace(RlweCt &ct, const size_t dropping_primes = 1,
+                              const u64 plain_modulus = 0);
+
+/**
+ * @brief Finish a key switching by the ModDown, adding the other part of the
+ * ciphertext, and drop more primes in the same pass, i.e. compute
+ * (ct_tilde + P * addend) / (P * M) with rounding, where P is the special prime
+ * and M the product of the dropped ones. A multiplication followed by the
+ * rescaling thus takes the NTTs and the base conversion of one division.
+ * @param ct_tilde The ciphertext from ext_prod_montgomery, whose last prime is
+ * the special one.
+ * @param addend0 The polynomial added to ct_tilde[0], modulo the primes of
+ * ct_tilde but the special one, or null if none.
+ * @param addend1 The polynomial added to ct_tilde[1], or null if none.
+ * @param dropping_primes The number of primes to drop besides the special one.
+ * @param plain_modulus If nonzero, the division is that of BGV as in
+ * drop_last_primes_inplace, where the result is multiplied by M modulo t, which
+ * keeps the plaintext of ct_tilde / P + addend.
+ */
+void mod_down_and_drop_inplace(RlweCt &ct_tilde, const RnsPolynomial *addend0,
+                               const RnsPolynomial *addend1,
+                               const size_t dropping_primes,
+                               const u64 plain_modulus = 0);
+
+/**
+ * @brief An accumulator summing many ciphertexts, which keeps the raw sums of
+ * the values in 64 bits and reduces a component only when its next addition
+ * might overflow, i.e. after about 2^64 / 2q additions. Adding a ciphertext
+ * is thus a plain vector addition without any allocation, while a sum by add
+ * takes a conditional subtraction per value and a new ciphertext per call.
+ */
+class CtAccumulator {
+public:
+    /// @brief Add a ciphertext in NTT form, which should have the primes of
+    /// the ones added before.
+    void add(const RlweCt &ct);
+
+    /// @brief The sum of the ciphertexts added, as a normal ciphertext.
+    RlweCt result() const;
+
+    /// @brief The number of the ciphertexts added.
+    inline size_t count() const { return count_; }
+
+private:
+    RlweCt sum_;
+
+    /// The additions since the last reduction of each component.
+    std::vector<u64> pending_;
+
+    /// The additions allowed between two reductions of each component.
+    std::vector<u64> capacity_;
+
+    size_t count_ = 0;
+};
+
 } // namespace hehub
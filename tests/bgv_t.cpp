@@ -22,6 +22,39 @@ TEST_CASE("bgv encoding") {
 
     // check
     REQUIRE(data_decoded == data);
+
+    // a few data in many slots, and a few slots decoded
+    std::vector<u64> few_data(data.begin(), data.begin() + 5);
+    auto sparse_pt = bgv::simd_encode(few_data, p, n);
+    auto full_pt = bgv::simd_encode(
+        [&] {
+            auto padded(few_data);
+            padded.resize(n, 0);
+            return padded;
+        }(),
+        p, n);
+    reduce_strict(sparse_pt);
+    reduce_strict(full_pt);
+    REQUIRE(sparse_pt == full_pt);
+    REQUIRE(bgv::simd_decode(sparse_pt, 5) == few_data);
+    REQUIRE(bgv::simd_decode(pt, 10) ==
+            std::vector<u64>(data.begin(), data.begin() + 10));
+
+    // the slots of the small modulus are transformed on 32-bit words, which
+    // agree with those on 64-bit words
+    RnsPolynomial expected(RnsPolyParams{n, 1, std::vector<u64>{p}});
+    std::copy(data.begin(), data.end(), expected[0].begin());
+    expected.rep_form = PolyRepForm::value;
+    intt_negacyclic_inplace(expected);
+    reduce_strict(pt);
+    REQUIRE(pt == expected);
+
+    // and the large ones on 64-bit words
+    u64 large_p = 1099510054913;
+    auto large_pt = bgv::simd_encode(data, large_p);
+    REQUIRE(bgv::simd_decode(large_pt) == data);
+    REQUIRE(bgv::simd_decode(bgv::simd_encode(few_data, large_p, n), 5) ==
+            few_data);
 }
 
 TEST_CASE("bgv encryption") {
@@ -103,6 +136,32 @@ TEST_CASE("bgv arith") {
         // check
         REQUIRE(pt_sum == sum_recovered);
     }
+    SECTION("linear combination") {
+        u64 pt_modulus = 65537;
+        RnsPolyParams pt_params{dimension, 1, std::vector{pt_modulus}};
+
+        // random plaintext data and weights, one of them negative
+        std::vector<BgvPt> pts{get_rand_uniform_poly(pt_params),
+                               get_rand_uniform_poly(pt_params),
+                               get_rand_uniform_poly(pt_params)};
+        std::vector<u64> weights{3, pt_modulus - 7, 12345};
+        std::vector<BgvCt> cts;
+        for (auto &pt : pts) {
+            reduce_strict(pt);
+            cts.push_back(bgv::encrypt(pt, sk));
+        }
+
+        auto ct_comb = bgv::linear_combination(cts, weights);
+        auto comb_recovered = bgv::decrypt(ct_comb, sk);
+
+        for (size_t i = 0; i < dimension; i++) {
+            u64 expected = 0;
+            for (size_t j = 0; j < pts.size(); j++) {
+                expected = (expected + pts[j][0][i] * weights[j]) % pt_modulus;
+            }
+            REQUIRE(comb_recovered[0][i] == expected);
+        }
+    }
     SECTION("subtraction") {
         u64 pt_modulus = 65537;
         RnsPolyParams pt_params{dimension, 1, std::vector{pt_modulus}};
@@ -257,3 +316,58 @@ TEST_CASE("bgv mod switch") {
 
     REQUIRE(pt_new == pt);
 }
+
+TEST_CASE("bgv mod switch by several primes") {
+    u64 pt_modulus = 65537;
+    size_t dimension = 8;
+    auto ct_params = create_params(dimension, {47, 47, 47, 47});
+    const auto &ct_moduli = ct_params.moduli;
+    RlweSk sk(ct_params);
+
+    // random data, seen as real plaintext with large noise
+    u64 seed = 42;
+    auto get_ct = [&](size_t components) {
+        RnsPolyParams params{dimension, components,
+                             std::vector(ct_moduli.begin(),
+                                         ct_moduli.begin() + components)};
+        RnsPolynomial fake_pt(params);
+        for (size_t i = 0; i < dimension; i++) {
+            seed = (seed * 1024 + 348398497) % 12345678901111111;
+            for (size_t k = 0; k < components; k++) {
+                fake_pt[k][i] = seed % ct_moduli[k];
+            }
+        }
+        ntt_negacyclic_inplace_lazy(fake_pt);
+        BgvCt ct = bgv::get_rlwe_sample_lift_noise(sk, pt_modulus, components);
+        ct.plain_modulus = pt_modulus;
+        ct[1] += fake_pt;
+        return ct;
+    };
+
+    SECTION("mod switch") {
+        auto ct = get_ct(4);
+        auto pt = bgv::decrypt(ct, sk);
+        bgv::mod_switch_inplace(ct, 3);
+        REQUIRE(ct[0].component_count() == 1);
+        REQUIRE(bgv::decrypt(ct, sk) == pt);
+    }
+    SECTION("merged with ModDown") {
+        // ct_tilde / P + ct, where P is the last prime
+        auto ct_tilde = get_ct(4);
+        auto ct = get_ct(3);
+        auto pt_tilde = bgv::decrypt(ct_tilde, sk);
+        auto pt = bgv::decrypt(ct, sk);
+        auto special_mod = ct_moduli.back();
+        auto inv_special = inverse_mod_prime(special_mod % pt_modulus, pt_modulus);
+
+        mod_down_and_drop_inplace(ct_tilde, &ct[0], &ct[1], 2, pt_modulus);
+        BgvCt ct_new = std::move(ct_tilde);
+        ct_new.plain_modulus = pt_modulus;
+        REQUIRE(ct_new[0].component_count() == 1);
+        auto pt_new = bgv::decrypt(ct_new, sk);
+        for (size_t i = 0; i < dimension; i++) {
+            REQUIRE(pt_new[0][i] ==
+                    (pt_tilde[0][i] * inv_special + pt[0][i]) % pt_modulus);
+        }
+    }
+}
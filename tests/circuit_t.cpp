@@ -0,0 +1,192 @@
+#include "catch2/catch.hpp"
+#include "circuit.h"
+#include "fhe/common/task_runtime.h"
+
+using namespace hehub;
+using StepKind = CircuitGraph::StepKind;
+
+TEST_CASE("ckks circuit") {
+    const size_t dimension = 256;
+    const auto slot_count = dimension / 2;
+    auto params = ckks::create_params(dimension, {40, 30, 30}, 40,
+                                      std::pow(2.0, 30));
+    CkksSk sk(params);
+    auto relin_key = get_relin_key(sk, params.additional_mod);
+    std::vector<RotKey> rot_keys(slot_count);
+    for (auto step : {1, 2}) {
+        rot_keys[step] = get_rot_key(sk, params.additional_mod, step);
+    }
+
+    std::vector<double> x(slot_count), y(slot_count), z(slot_count),
+        w(slot_count);
+    for (size_t i = 0; i < slot_count; i++) {
+        x[i] = std::sin(i);
+        y[i] = std::cos(i);
+        z[i] = std::sin(i * 2.0);
+        w[i] = 1.0 / (i + 1);
+    }
+
+    ckks::Circuit circuit;
+    auto x_in = circuit.input();
+    auto y_in = circuit.input();
+    auto z_in = circuit.input();
+    auto xy = circuit.mult(x_in, y_in);
+    auto yx = circuit.mult(y_in, x_in); // common subexpression
+    REQUIRE(yx == xy);
+    auto xz = circuit.mult(x_in, z_in);
+    circuit.add(xy, xz); // not output, hence dead
+    circuit.output(circuit.add(circuit.rotate(xy, 1), circuit.rotate(yx, 2)));
+    circuit.output(circuit.add(xy, circuit.mult_plain(z_in, w)));
+    circuit.output(circuit.mult(yx, z_in));
+
+    auto plan = circuit.optimize();
+    // x * y is relinearized once for all its uses, and its sum with the
+    // plaintext product is relinearized and rescaled once, each in one
+    // division
+    CHECK(plan.count(StepKind::mult) == 2);
+    CHECK(plan.count(StepKind::mult_plain) == 1);
+    CHECK(plan.count(StepKind::relinearize_rescale) == 3);
+    CHECK(plan.count(StepKind::relinearize) == 0);
+    CHECK(plan.count(StepKind::rescale) == 0);
+    // z is aligned to x * y when multiplied
+    CHECK(plan.count(StepKind::drop_primes) == 1);
+    // the rotations of x * y share the decomposition
+    CHECK(plan.count(StepKind::decompose) == 1);
+    CHECK(plan.count(StepKind::rotate) == 2);
+
+    std::vector<CkksCt> inputs;
+    for (auto data : {&x, &y, &z}) {
+        inputs.push_back(ckks::encrypt(ckks::simd_encode(*data, params), sk));
+    }
+    auto outputs = circuit.execute(inputs, relin_key, rot_keys);
+    REQUIRE(outputs.size() == 3);
+
+    std::vector<std::vector<double>> results;
+    for (auto &ct : outputs) {
+        results.push_back(ckks::simd_decode(ckks::decrypt(ct, sk)));
+    }
+    for (size_t i = 0; i < slot_count; i++) {
+        auto rot1 = (i + slot_count - 1) % slot_count;
+        auto rot2 = (i + slot_count - 2) % slot_count;
+        CHECK(std::abs(results[0][i] - x[rot1] * y[rot1] -
+                       x[rot2] * y[rot2]) < std::pow(2.0, -15));
+        CHECK(std::abs(results[1][i] - x[i] * y[i] - z[i] * w[i]) <
+              std::pow(2.0, -15));
+        CHECK(std::abs(results[2][i] - x[i] * y[i] * z[i]) <
+              std::pow(2.0, -10));
+    }
+
+    // the parallel execution produces the same ciphertexts
+    set_thread_count(4);
+    auto outputs_parallel = circuit.execute(inputs, relin_key, rot_keys);
+    set_thread_count(1);
+    for (size_t k = 0; k < outputs.size(); k++) {
+        REQUIRE(outputs_parallel[k] == outputs[k]);
+    }
+
+    SECTION("addends of different scaling factors") {
+        ckks::Circuit sum_circuit;
+        auto x_wire = sum_circuit.input();
+        auto y_wire = sum_circuit.input();
+        auto z_wire = sum_circuit.input();
+        auto xy_wire = sum_circuit.mult(x_wire, y_wire);
+        // z is brought to the scaling factor of x * y, and the sum is
+        // rescaled once
+        sum_circuit.output(sum_circuit.add(xy_wire, z_wire));
+        // z is brought to that of x * y rescaled, and rescaled itself
+        sum_circuit.output(
+            sum_circuit.sub(sum_circuit.rotate(xy_wire, 1), z_wire));
+
+        auto sum_plan = sum_circuit.optimize();
+        CHECK(sum_plan.count(StepKind::upscale) == 2);
+        CHECK(sum_plan.count(StepKind::relinearize_rescale) == 2);
+        CHECK(sum_plan.count(StepKind::rescale) == 1);
+        CHECK(sum_plan.count(StepKind::drop_primes) == 0);
+
+        auto sums = sum_circuit.execute(inputs, relin_key, rot_keys);
+        auto sum = ckks::simd_decode(ckks::decrypt(sums[0], sk));
+        auto difference = ckks::simd_decode(ckks::decrypt(sums[1], sk));
+        for (size_t i = 0; i < slot_count; i++) {
+            auto rot1 = (i + slot_count - 1) % slot_count;
+            CHECK(std::abs(sum[i] - x[i] * y[i] - z[i]) < std::pow(2.0, -15));
+            CHECK(std::abs(difference[i] - x[rot1] * y[rot1] + z[i]) <
+                  std::pow(2.0, -15));
+        }
+    }
+
+    SECTION("missing rotation key") {
+        std::vector<RotKey> partial_rot_keys(slot_count);
+        partial_rot_keys[1] = rot_keys[1];
+        REQUIRE_THROWS_AS(circuit.execute(inputs, relin_key, partial_rot_keys),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("bgv circuit") {
+    const size_t dimension = 256;
+    u64 pt_modulus = 65537;
+    std::vector<u64> ct_moduli{140737486520321, 140737485864961,
+                               140737484685313, 140737483898881};
+    u64 additional_mod = 140737487306753;
+    RlweSk sk(RnsPolyParams{dimension, ct_moduli.size(), ct_moduli});
+    auto relin_key = get_relin_key(sk, additional_mod);
+
+    std::vector<u64> x(dimension), y(dimension), z(dimension), w(dimension);
+    for (size_t i = 0; i < dimension; i++) {
+        x[i] = (i * 888) % pt_modulus;
+        y[i] = (i * 777 + 1) % pt_modulus;
+        z[i] = (i * 666 + 2) % pt_modulus;
+        w[i] = (i * 555 + 3) % pt_modulus;
+    }
+
+    bgv::Circuit product_circuit;
+    auto x_in = product_circuit.input();
+    auto y_in = product_circuit.input();
+    auto z_in = product_circuit.input();
+    auto xy = product_circuit.mult(x_in, y_in);
+    auto xz = product_circuit.mult(x_in, z_in);
+    product_circuit.output(
+        product_circuit.sub(product_circuit.add_plain(xy, w), xz));
+    product_circuit.output(
+        product_circuit.mult(product_circuit.mult_plain(xy, w), z_in));
+
+    auto plan = product_circuit.optimize();
+    // the plaintext product is the only one switched apart from the key
+    // switching
+    CHECK(plan.count(StepKind::relinearize_rescale) == 3);
+    CHECK(plan.count(StepKind::relinearize) == 0);
+    CHECK(plan.count(StepKind::rescale) == 1);
+
+    // The ciphertext multiplication of BGV is still under development (see
+    // bgv_t.cpp), hence only the linear part is executed.
+    bgv::Circuit circuit;
+    x_in = circuit.input();
+    y_in = circuit.input();
+    z_in = circuit.input();
+    circuit.output(circuit.sub(circuit.add_plain(x_in, w), y_in));
+    circuit.output(circuit.add(circuit.mult_plain(x_in, w), z_in));
+
+    plan = circuit.optimize();
+    // z is added to the plaintext product before it is switched
+    CHECK(plan.count(StepKind::upscale) == 1);
+    CHECK(plan.count(StepKind::rescale) == 1);
+    CHECK(plan.count(StepKind::drop_primes) == 0);
+
+    std::vector<BgvCt> inputs;
+    for (auto data : {&x, &y, &z}) {
+        inputs.push_back(
+            bgv::encrypt(bgv::simd_encode(*data, pt_modulus), sk));
+    }
+    for (auto thread_count : {1, 4}) {
+        set_thread_count(thread_count);
+        auto outputs = circuit.execute(inputs, relin_key);
+        auto result0 = bgv::simd_decode(bgv::decrypt(outputs[0], sk));
+        auto result1 = bgv::simd_decode(bgv::decrypt(outputs[1], sk));
+        for (size_t i = 0; i < dimension; i++) {
+            REQUIRE(result0[i] ==
+                    (x[i] + w[i] + pt_modulus - y[i]) % pt_modulus);
+            REQUIRE(result1[i] == (x[i] * w[i] + z[i]) % pt_modulus);
+        }
+    }
+    set_thread_count(1);
+}
@@ -5,6 +5,7 @@
 #include "fhe/common/ntt.h"
 #include "fhe/common/permutation.h"
 #include "fhe/common/sampling.h"
+#include <numeric>
 #include <type_traits>
 
 using namespace hehub;
@@ -131,6 +132,29 @@ TEST_CASE("ckks encoding") {
         REQUIRE(data_recovered.size() == data.size());
         REQUIRE_ALL_CLOSE(data, data_recovered, pow(2.0, -35));
     }
+    SECTION("partial decoding") {
+        params.initial_scaling_factor = std::pow(2.0, 80);
+        std::vector<cc_double> data(data_size);
+        for (auto &d : data) {
+            d = {distribution(generator), distribution(generator)};
+        }
+
+        CkksPt pt = ckks::simd_encode(data, params);
+        auto all_slots = ckks::simd_decode<cc_double>(pt);
+
+        // evaluated at the roots directly, and by the FFT
+        for (size_t count : {1, 2, 7}) {
+            auto prefix = ckks::simd_decode<cc_double>(pt, count);
+            std::vector expected(all_slots.begin(), all_slots.begin() + count);
+            REQUIRE_ALL_CLOSE(prefix, expected, pow(2.0, -35));
+        }
+
+        auto sum = std::accumulate(all_slots.begin(), all_slots.end(),
+                                   cc_double(0));
+        auto mean = sum / (double)all_slots.size();
+        CHECK(std::abs(ckks::decode(pt) - mean.real()) < pow(2.0, -35));
+        CHECK(std::abs(ckks::decode<cc_double>(pt) - mean) < pow(2.0, -35));
+    }
 }
 
 TEST_CASE("ckks rescaling") {
@@ -174,6 +198,57 @@ TEST_CASE("ckks rescaling") {
     }
 }
 
+TEST_CASE("ckks rescaling by several primes") {
+    size_t dimension = 8;
+    size_t dropping_primes = 2;
+    RnsPolyParams ct_params = create_params(dimension, {34, 34, 34, 34});
+
+    CkksCt ct;
+    ct.scaling_factor = std::pow(2.0, 80);
+    for (auto &c : ct) {
+        c = get_rand_uniform_poly(ct_params, PolyRepForm::coeff);
+    }
+    std::array composed{UBIntVec(ct[0]), UBIntVec(ct[1])};
+
+    for (auto &c : ct) {
+        ntt_negacyclic_inplace_lazy(c);
+    }
+    ckks::rescale_inplace(ct, dropping_primes);
+    for (auto &c : ct) {
+        intt_negacyclic_inplace_lazy(c);
+        reduce_strict(c);
+    }
+
+    // The division rounds up from (M - 1) / 2 as for one prime, and the result
+    // is modulo the remaining primes.
+    UBInt dropped_product = 1;
+    UBInt remaining_product = 1;
+    double dropped_product_approx = 1.0;
+    for (size_t k = 0; k < ct_params.component_count; k++) {
+        auto q = ct_params.moduli[k];
+        if (k < ct_params.component_count - dropping_primes) {
+            remaining_product *= q;
+        } else {
+            dropped_product *= q;
+            dropped_product_approx *= q;
+        }
+    }
+    REQUIRE(ct[0].component_count() == 2);
+    REQUIRE(ct[1].component_count() == 2);
+    REQUIRE(ct.scaling_factor ==
+            Approx(std::pow(2.0, 80) / dropped_product_approx));
+
+    std::array composed_new{UBIntVec(ct[0]), UBIntVec(ct[1])};
+    auto half_up = (dropped_product + 1) / 2;
+    for (auto half : {0, 1}) {
+        for (size_t i = 0; i < dimension; i++) {
+            REQUIRE((composed[half][i] + half_up) / dropped_product %
+                        remaining_product ==
+                    composed_new[half][i]);
+        }
+    }
+}
+
 TEST_CASE("ckks encryption") {
     size_t dimension = 8;
     int scaling_bits = 30;
@@ -255,6 +330,44 @@ TEST_CASE("ckks arith") {
         double eps = std::pow(2.0, 5 + 1 - scaling_bits);
         REQUIRE_ALL_CLOSE(data_sum, sum_recovered, eps);
     }
+    SECTION("linear combination") {
+        std::vector<double> weights{0.5, -1.25, 3.0};
+        std::vector<double> data_comb(data_count);
+        for (size_t i = 0; i < data_count; i++) {
+            data_comb[i] = weights[0] * plain_data1[i] +
+                           weights[1] * plain_data2[i] +
+                           weights[2] * plain_data3[i];
+        }
+
+        std::vector<CkksCt> cts{ckks::encrypt(pt1, sk), ckks::encrypt(pt2, sk),
+                                ckks::encrypt(pt3, sk)};
+        auto ct_comb = ckks::linear_combination(cts, weights);
+        REQUIRE(ct_comb[0].component_count() == 2);
+        REQUIRE(ct_comb.scaling_factor == Approx(cts[0].scaling_factor));
+
+        auto comb_recovered = ckks::simd_decode(ckks::decrypt(ct_comb, sk));
+        double eps = pow(2, 5 + 3 - scaling_bits);
+        REQUIRE_ALL_CLOSE(data_comb, comb_recovered, eps);
+
+        CHECK_THROWS(ckks::linear_combination(cts, {1.0, 2.0}));
+    }
+    SECTION("accumulation") {
+        auto data_sum(plain_data1);
+        for (size_t i = 0; i < data_count; i++) {
+            data_sum[i] += plain_data2[i] + plain_data3[i];
+        }
+
+        ckks::CtAccumulator accumulator;
+        for (auto &pt : {pt1, pt2, pt3}) {
+            accumulator.add(ckks::encrypt(pt, sk));
+        }
+        auto ct_sum = accumulator.result();
+        REQUIRE(ct_sum.scaling_factor == Approx(pt1.scaling_factor));
+
+        auto sum_recovered = ckks::simd_decode(ckks::decrypt(ct_sum, sk));
+        double eps = pow(2, 5 + 2 - scaling_bits);
+        REQUIRE_ALL_CLOSE(data_sum, sum_recovered, eps);
+    }
     SECTION("subtraction") {
         auto data_diff(plain_data1);
         for (size_t i = 0; i < data_count; i++) {
@@ -340,6 +453,18 @@ TEST_CASE("ckks arith") {
                                                   // with σ = data's std dev
             REQUIRE_ALL_CLOSE(data_prod, prod_recovered, eps);
         }
+        SECTION("merged with rescaling") {
+            auto ct_merged = ckks::mult_and_rescale(ct1, ct2, relin_key);
+            ckks::rescale_inplace(ct_prod);
+            REQUIRE(ct_merged[0].component_count() == 2);
+            REQUIRE(ct_merged[1].component_count() == 2);
+            REQUIRE(ct_merged.scaling_factor == ct_prod.scaling_factor);
+
+            auto prod_recovered =
+                ckks::simd_decode(ckks::decrypt(ct_merged, sk));
+            double eps = pow(2, 3 + 5 + 1 - scaling_bits);
+            REQUIRE_ALL_CLOSE(data_prod, prod_recovered, eps);
+        }
         SECTION("with rescaling") {
             // rescaling
             ckks::rescale_inplace(ct_prod);
@@ -389,6 +514,37 @@ TEST_CASE("ckks key switch") {
         double eps = pow(2.0, -25); // empirical, needs analysis
         REQUIRE_ALL_CLOSE(plain_data, data_recovered, eps);
     }
+    SECTION("60-62-bit primes") {
+        // more components than the products summed in u128 at once
+        size_t dimension = 8;
+        auto ct_params = ckks::create_params(
+            dimension, {60, 61, 61, 61, 61, 62, 62, 62}, 62, pow(2.0, 40));
+        u64 additional_mod = ct_params.additional_mod;
+
+        auto data_count = dimension / 2;
+        std::vector<double> plain_data(data_count);
+        std::default_random_engine generator;
+        std::normal_distribution<double> data_dist(0, 1);
+        for (auto &d : plain_data) {
+            d = data_dist(generator);
+        }
+
+        RlweSk sk1(ct_params);
+        RlweSk sk2(ct_params);
+        auto ksk = RlweKsk(sk1, sk2, additional_mod);
+
+        auto pt = ckks::simd_encode(plain_data, ct_params);
+        auto ct = ckks::encrypt(pt, sk1);
+        CkksCt ct_new = ext_prod_montgomery(ct[1], ksk);
+        ckks::rescale_inplace(ct_new);
+        ct_new.scaling_factor = ct.scaling_factor;
+        ct_new[0] += ct[0];
+
+        auto pt_recovered = ckks::decrypt(ct_new, sk2);
+        auto data_recovered = ckks::simd_decode(pt_recovered);
+        double eps = pow(2.0, -25);
+        REQUIRE_ALL_CLOSE(plain_data, data_recovered, eps);
+    }
     SECTION("conjugation") {
         size_t dimension = 8;
         auto ct_params =
@@ -4,7 +4,10 @@
 #include "fhe/common/ntt.h"
 #include "fhe/common/permutation.h"
 #include "fhe/common/rns.h"
+#include "fhe/common/rns_transform.h"
 #include "fhe/common/sampling.h"
+#include <thread>
+#include <utility>
 
 using namespace hehub;
 
@@ -17,11 +20,23 @@ TEST_CASE("allocation") {
     REQUIRE(allocator.get_blocks_total() == 1);
     REQUIRE(allocator.get_blocks_in_use() == 1);
     REQUIRE(allocator.get_blocks_free() == 0);
+    std::fill(p1.begin(), p1.end(), 1);
 
+    // a copy shares the block until either is accessed mutably
     SimplePoly p2 = p1;
+    REQUIRE(allocator.get_blocks_total() == 1);
+    REQUIRE(allocator.get_blocks_in_use() == 1);
+    REQUIRE(p1.use_count() == 2);
+    REQUIRE(std::as_const(p2).data() == std::as_const(p1).data());
+
+    p2[0] = 2;
     REQUIRE(allocator.get_blocks_total() == 2);
     REQUIRE(allocator.get_blocks_in_use() == 2);
     REQUIRE(allocator.get_blocks_free() == 0);
+    REQUIRE(p1.use_count() == 1);
+    REQUIRE(p2.use_count() == 1);
+    REQUIRE(p1[0] == 1);
+    REQUIRE(p2[1] == 1);
 
     SimplePoly p3(std::move(p1));
     REQUIRE(allocator.get_blocks_total() == 2);
@@ -34,6 +49,29 @@ TEST_CASE("allocation") {
     REQUIRE(allocator.get_blocks_total() == 3);
     REQUIRE(allocator.get_blocks_in_use() == 2);
     REQUIRE(allocator.get_blocks_free() == 1);
+
+    // the block is returned when the last sharing array is destructed
+    {
+        SimplePoly shared = p3;
+        p3 = p2;
+        REQUIRE(allocator.get_blocks_in_use() == 2);
+    }
+    REQUIRE(allocator.get_blocks_in_use() == 1);
+    REQUIRE(allocator.get_blocks_free() == 2);
+
+    // the copies are independent among threads
+    std::vector<SimplePoly> copies(8, p2);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < copies.size(); t++) {
+        threads.emplace_back([&copies, t]() { copies[t][0] = t; });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    for (size_t t = 0; t < copies.size(); t++) {
+        CHECK(copies[t][0] == t);
+    }
+    CHECK(p2[0] == 2);
 }
 
 TEST_CASE("RNS polynomial") {
@@ -60,6 +98,147 @@ TEST_CASE("RNS polynomial") {
     REQUIRE_THROWS(RnsPolynomial(RnsPolyParams{4097, 3, std::vector<u64>(3)}));
 }
 
+TEST_CASE("RNS polynomial views") {
+    const size_t dimension = 256;
+    const std::vector<u64> moduli{1099510054913, 1099507695617, 1099506515969};
+    RnsPolyParams params{dimension, 3, moduli};
+    auto a = get_rand_uniform_poly(params);
+    auto b = get_rand_uniform_poly(params);
+
+    // the last two components, which are transformed and added in place
+    auto a_copy(a), a_original(a);
+    RnsPolyView a_tail(a, 1, 2);
+    REQUIRE(a_tail.component_count() == 2);
+    REQUIRE(a_tail.modulus_at(0) == moduli[1]);
+    ntt_negacyclic_inplace_lazy(a_tail);
+    ntt_negacyclic_inplace_lazy(a_copy);
+    add_inplace(a_tail, RnsPolyConstView(b, 1, 2));
+    (RnsIntVec &)a_copy += b;
+    reduce_strict(a_tail);
+    reduce_strict(a_copy);
+    CHECK(a[0] == a_original[0]);
+    for (size_t k = 1; k < 3; k++) {
+        CHECK(a[k] == a_copy[k]);
+    }
+
+    // base transformation of one component without copying it
+    RnsPolynomial first(dimension, 1, moduli);
+    first[0] = b[0];
+    std::vector<u64> rest_moduli(moduli.begin() + 1, moduli.end());
+    auto expected = rns_base_transform(first, rest_moduli);
+    auto transformed =
+        rns_base_transform(RnsPolyConstView(b, 0, 1), rest_moduli);
+    CHECK(transformed == expected);
+
+    RnsPolyConstView all(b);
+    REQUIRE(all.component_count() == 3);
+    CHECK(all.subview(2, 1)[0] == std::as_const(b)[2].data());
+    CHECK_THROWS(RnsPolyConstView(b, 2, 2));
+    CHECK_THROWS(all.subview(1, 3));
+    CHECK_THROWS(add_inplace(a_tail, RnsPolyConstView(b, 0, 2)));
+}
+
+TEST_CASE("value bound") {
+    const size_t dimension = 256;
+    const std::vector<u64> moduli{1099510054913, 1099507695617};
+    RnsPolyParams params{dimension, 2, moduli};
+    auto a = get_rand_uniform_poly(params);
+    auto b = get_rand_uniform_poly(params);
+    for (auto poly : {&a, &b}) {
+        // lazy values in [0, 2q)
+        for (size_t k = 0; k < moduli.size(); k++) {
+            for (auto &value : (*poly)[k]) {
+                value += moduli[k];
+            }
+        }
+    }
+    REQUIRE(a.value_bound == PolyValueBound::two_q);
+
+    auto a_reduced(a), b_reduced(b);
+    reduce_strict(a_reduced);
+    reduce_strict(b_reduced);
+    REQUIRE(a_reduced.value_bound == PolyValueBound::q);
+
+    // the sums and differences of the reduced operands skip the correction,
+    // yet agree with the others modulo q
+    auto check_congruent = [&](const RnsPolynomial &x, const RnsPolynomial &y) {
+        REQUIRE(x.value_bound == PolyValueBound::two_q);
+        for (size_t k = 0; k < moduli.size(); k++) {
+            for (size_t i = 0; i < dimension; i++) {
+                REQUIRE(x[k][i] < 2 * moduli[k]);
+                REQUIRE(x[k][i] % moduli[k] == y[k][i] % moduli[k]);
+            }
+        }
+    };
+    check_congruent(a_reduced + b_reduced, a + b);
+    check_congruent(a_reduced - b_reduced, a - b);
+
+    // a reduction is skipped on the reduced values
+    auto tweaked(a_reduced);
+    tweaked[0][0] = moduli[0];
+    reduce_strict(tweaked);
+    REQUIRE(tweaked[0][0] == moduli[0]);
+    tweaked.value_bound = PolyValueBound::two_q;
+    reduce_strict(tweaked);
+    REQUIRE(tweaked[0][0] == 0);
+
+    // the kernels leave the values in [0, 2q)
+    ntt_negacyclic_inplace_lazy(a_reduced);
+    REQUIRE(a_reduced.value_bound == PolyValueBound::two_q);
+    intt_negacyclic_inplace(a_reduced);
+    REQUIRE(a_reduced.value_bound == PolyValueBound::q);
+    b_reduced *= 3;
+    REQUIRE(b_reduced.value_bound == PolyValueBound::two_q);
+}
+
+TEST_CASE("RNS polynomials on 32-bit words") {
+    const size_t dimension = 256;
+    // the first prime takes the butterflies reducing the values at each level
+    const std::vector<u64> moduli{998244353, 132120577, 65537};
+    RnsPolyParams params{dimension, 3, moduli};
+    REQUIRE(moduli_fit_words<u32>(params));
+    REQUIRE_FALSE(moduli_fit_words<u32>(
+        RnsPolyParams{dimension, 1, std::vector<u64>{1099510054913}}));
+    REQUIRE_THROWS(RnsPolynomial32(
+        RnsPolyParams{dimension, 1, std::vector<u64>{1099510054913}}));
+
+    auto a = get_rand_uniform_poly(params, PolyRepForm::value);
+    auto b = get_rand_uniform_poly(params, PolyRepForm::value);
+    RnsPolynomial32 a32(a), b32(b);
+    REQUIRE(a32.rep_form == PolyRepForm::value);
+    REQUIRE(RnsPolynomial(a32) == a);
+
+    // the results agree with those on 64-bit words modulo q
+    auto check_same = [&](const RnsPolynomial32 &x32, RnsPolynomial x) {
+        RnsPolynomial widened(x32);
+        widened.value_bound = x.value_bound = PolyValueBound::two_q;
+        reduce_strict(widened);
+        reduce_strict(x);
+        CHECK(widened == x);
+    };
+    check_same(a32 + b32, a + b);
+    check_same(a32 - b32, a - b);
+    check_same(a32 * b32, a * b);
+    check_same(a32 * std::vector<u64>{3, 5, 1ULL << 40},
+               a * std::vector<u64>{3, 5, 1ULL << 40});
+    auto a32_scaled(a32);
+    auto a_scaled(a);
+    a32_scaled *= 12345;
+    a_scaled *= 12345;
+    check_same(a32_scaled, a_scaled);
+
+    // NTT round trip
+    a.rep_form = a32.rep_form = PolyRepForm::coeff;
+    auto a_coeffs(a);
+    ntt_negacyclic_inplace_lazy(a32);
+    ntt_negacyclic_inplace_lazy(a);
+    REQUIRE(a32.rep_form == PolyRepForm::value);
+    check_same(a32, a);
+    intt_negacyclic_inplace_lazy(a32);
+    REQUIRE(a32.rep_form == PolyRepForm::coeff);
+    check_same(a32, a_coeffs);
+}
+
 TEST_CASE("bit rev", "[.]") {
     REQUIRE(__bit_rev_naive_16(12345, 14) == __bit_rev_naive(12345, 14));
     REQUIRE(__bit_rev_naive_16(12345, 15) == __bit_rev_naive(12345, 15));
@@ -0,0 +1,231 @@
+#include "catch2/catch.hpp"
+#include "fhe/bgv/bgv.h"
+#include "fhe/ckks/ckks.h"
+#include "fhe/common/sampling.h"
+#include "fhe/common/task_runtime.h"
+#include <atomic>
+#include <thread>
+
+using namespace hehub;
+
+/// Run CKKS operations on ciphertexts owned by the calling thread, returning
+/// whether all the results are correct. Catch2 assertions are not thread-safe,
+/// hence the checks are collected and reported by the main thread.
+bool ckks_workload(size_t dimension, int rounds) {
+    int scaling_bits = 30;
+    auto params = ckks::create_params(dimension, {40, 30, 30}, 40,
+                                      std::pow(2.0, scaling_bits));
+    RlweSk sk(params);
+    auto relin_key = get_relin_key(sk, params.additional_mod);
+    auto rot_key = get_rot_key(sk, params.additional_mod, 1);
+
+    auto data_count = dimension / 2;
+    std::default_random_engine generator(dimension);
+    std::normal_distribution<double> data_dist(0, 1);
+
+    bool correct = true;
+    for (int r = 0; r < rounds; r++) {
+        std::vector<double> data1(data_count), data2(data_count);
+        for (size_t i = 0; i < data_count; i++) {
+            data1[i] = data_dist(generator);
+            data2[i] = data_dist(generator);
+        }
+
+        auto ct1 = ckks::encrypt(ckks::simd_encode(data1, params), sk);
+        auto ct2 = ckks::encrypt(ckks::simd_encode(data2, params), sk);
+        auto ct_prod = ckks::mult(ct1, ct2, relin_key);
+        auto ct_rot = ckks::rotate(ct_prod, rot_key);
+        ckks::rescale_inplace(ct_rot);
+
+        auto prod_recovered = ckks::simd_decode(ckks::decrypt(ct_rot, sk));
+        for (size_t i = 0; i < data_count; i++) {
+            auto expected = data1[i] * data2[i];
+            auto actual = prod_recovered[(i + 1) % data_count];
+            correct = correct && std::abs(expected - actual) < pow(2.0, -15);
+        }
+    }
+    return correct;
+}
+
+/// Run BGV operations on ciphertexts owned by the calling thread, returning
+/// whether all the results are correct.
+bool bgv_workload(size_t dimension, int rounds) {
+    u64 pt_modulus = 65537;
+    std::vector<u64> ct_moduli{131530753, 130809857};
+    RlweSk sk(RnsPolyParams{dimension, ct_moduli.size(), ct_moduli});
+
+    bool correct = true;
+    for (int r = 0; r < rounds; r++) {
+        std::vector<u64> data1(dimension), data2(dimension);
+        for (size_t i = 0; i < dimension; i++) {
+            data1[i] = (i * 888 + r * 123) % pt_modulus;
+            data2[i] = (i * 777 + r * 321) % pt_modulus;
+        }
+
+        auto ct = bgv::encrypt(bgv::simd_encode(data1, pt_modulus), sk);
+        ct = bgv::mult_plain(ct, bgv::simd_encode(data2, pt_modulus));
+        auto res = bgv::simd_decode(bgv::decrypt(ct, sk));
+        for (size_t i = 0; i < dimension; i++) {
+            correct = correct && res[i] == data1[i] * data2[i] % pt_modulus;
+        }
+    }
+    return correct;
+}
+
+TEST_CASE("concurrent operations") {
+    // Threads working on the same dimension share the precomputed tables,
+    // which are also likely to be created concurrently since different tests
+    // use different dimensions.
+    const size_t thread_count = 8;
+    const int rounds = 4;
+    std::vector<char> results(thread_count, false);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++) {
+        threads.emplace_back([&results, t]() {
+            auto dimension = 64 << (t % 4);
+            if (t % 2 == 0) {
+                results[t] = ckks_workload(dimension, rounds);
+            } else {
+                results[t] = bgv_workload(dimension, rounds);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    for (size_t t = 0; t < thread_count; t++) {
+        REQUIRE(results[t]);
+    }
+}
+
+/// An external executor which simply starts a thread for each task.
+class ThreadPerTaskExecutor : public Executor {
+public:
+    ~ThreadPerTaskExecutor() {
+        for (auto &thread : threads_) {
+            thread.join();
+        }
+    }
+
+    void submit(Task task) override {
+        std::lock_guard lock(mutex_);
+        submitted++;
+        threads_.emplace_back(std::move(task));
+    }
+
+    size_t concurrency() const override { return 4; }
+
+    std::atomic<size_t> submitted = 0;
+
+private:
+    std::mutex mutex_;
+
+    std::vector<std::thread> threads_;
+};
+
+TEST_CASE("task runtime") {
+    const size_t count = 1000;
+
+    SECTION("parallel for") {
+        set_thread_count(4);
+        REQUIRE(get_thread_count() == 4);
+        std::vector<std::atomic<int>> visited(count);
+        parallel_for(0, count, [&](size_t i) { visited[i]++; });
+        for (auto &v : visited) {
+            REQUIRE(v == 1);
+        }
+    }
+    SECTION("nested task groups") {
+        set_thread_count(3);
+        std::atomic<size_t> sum = 0;
+        TaskGroup group;
+        for (size_t t = 0; t < 10; t++) {
+            group.spawn([&sum, t]() {
+                parallel_for(0, count, [&](size_t i) { sum += t * i; });
+            });
+        }
+        group.wait();
+        REQUIRE(sum == 45 * count * (count - 1) / 2);
+    }
+    SECTION("exception") {
+        set_thread_count(4);
+        auto throwing = [](size_t i) {
+            if (i == 7) {
+                throw std::invalid_argument("Test exception.");
+            }
+        };
+        REQUIRE_THROWS_AS(parallel_for(0, 10, throwing), std::invalid_argument);
+    }
+    SECTION("external executor") {
+        auto executor = std::make_shared<ThreadPerTaskExecutor>();
+        set_executor(executor);
+        REQUIRE(get_thread_count() == 4);
+        std::vector<std::atomic<int>> visited(count);
+        parallel_for(0, count, [&](size_t i) { visited[i]++; });
+        for (auto &v : visited) {
+            REQUIRE(v == 1);
+        }
+        REQUIRE(executor->submitted > 0);
+        set_executor(nullptr);
+    }
+    SECTION("key switching") {
+        auto params = ckks::create_params(4096, {40, 30, 30, 30}, 40,
+                                          std::pow(2.0, 30));
+        CkksSk sk(params);
+        auto relin_key = get_relin_key(sk, params.additional_mod);
+        auto rot_key = get_rot_key(sk, params.additional_mod, 3);
+        auto ct = ckks::encrypt(ckks::encode(1.0, params), sk);
+
+        set_thread_count(1);
+        auto ct_prod = ckks::mult(ct, ct, relin_key);
+        auto ct_rot = ckks::rotate(ct, rot_key);
+        set_thread_count(4);
+        auto ct_prod_parallel = ckks::mult(ct, ct, relin_key);
+        auto ct_rot_parallel = ckks::rotate(ct, rot_key);
+        REQUIRE(ct_prod_parallel == ct_prod);
+        REQUIRE(ct_rot_parallel == ct_rot);
+    }
+    set_thread_count(1);
+}
+
+TEST_CASE("async operations") {
+    auto params =
+        ckks::create_params(4096, {40, 30, 30, 30}, 40, std::pow(2.0, 30));
+    CkksSk sk(params);
+    auto relin_key = get_relin_key(sk, params.additional_mod);
+    auto rot_key = get_rot_key(sk, params.additional_mod, 1);
+    auto ct = ckks::encrypt(ckks::encode(1.0, params), sk);
+    auto ct_quadratic = ckks::mult_low_level(ct, ct);
+
+    auto ct_expected =
+        ckks::rotate(ckks::rotate(ckks::relinearize(ct_quadratic, relin_key),
+                                  rot_key),
+                     rot_key);
+    for (auto thread_count : {1, 4}) {
+        set_thread_count(thread_count);
+        auto ct_relin_fut = ckks::relinearize_async(ct_quadratic, relin_key);
+        auto ct_rot_fut =
+            ckks::rotate_async(ckks::rotate_async(ct_relin_fut, rot_key),
+                               rot_key);
+        REQUIRE(ct_rot_fut.get() == ct_expected);
+        REQUIRE(ct_relin_fut.ready());
+    }
+
+    SECTION("exception") {
+        set_thread_count(4);
+        // the scaling factors mismatch in the addition
+        auto ct_relin = ckks::relinearize(ct_quadratic, relin_key);
+        auto ct_fut = run_async([&]() { return ckks::add(ct, ct_relin); });
+        auto ct_next_fut = ckks::rotate_async(ct_fut, rot_key);
+        REQUIRE_THROWS_AS(ct_next_fut.get(), std::invalid_argument);
+    }
+
+    SECTION("empty future") {
+        Future<RlweCt> ct_fut;
+        REQUIRE_FALSE(ct_fut.valid());
+        REQUIRE_THROWS_AS(ct_fut.ready(), std::logic_error);
+        REQUIRE_THROWS_AS(ct_fut.get(), std::logic_error);
+    }
+    set_thread_count(1);
+}
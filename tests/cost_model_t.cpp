@@ -0,0 +1,124 @@
+#include "catch2/catch.hpp"
+#include "cost_model.h"
+#include "fhe/common/profiling.h"
+
+using namespace hehub;
+using StepKind = CircuitGraph::StepKind;
+
+TEST_CASE("cost model") {
+    const size_t dimension = 256;
+    const size_t component_count = 3;
+    const u64 comp_bytes = dimension * sizeof(u64);
+    CostCalibration calibration;
+    calibration.dimension = dimension;
+    calibration.ntt_ns = 1000;
+    calibration.mul_ns = 100;
+    calibration.key_mac_ns = 10;
+    CostModel model(CostParams{dimension, component_count}, calibration);
+
+    SECTION("operations") {
+        auto rotation = model.estimate(CostOp{StepKind::rotate});
+        // decomposition: 3 INTTs and 3 * 3 NTTs; ModDown: 2 * (1 + 3)
+        CHECK(rotation.ntt_count == 20);
+        CHECK(rotation.key_mac_count == 2 * 3 * 4);
+        CHECK(rotation.key_switch_count == 1);
+        CHECK(rotation.key_bytes == 2 * 3 * 4 * comp_bytes);
+        CHECK(rotation.latency_ns ==
+              Approx(20 * 1000 + rotation.mul_count * 100 + 24 * 10));
+
+        auto hoisted = model.estimate(
+            CostOp{StepKind::rotate, 0, 0, false, /*hoisted=*/true});
+        auto decomposition = model.estimate(CostOp{StepKind::decompose});
+        CHECK(hoisted.ntt_count + decomposition.ntt_count ==
+              rotation.ntt_count);
+
+        // a lower level costs less
+        auto lower = model.estimate(CostOp{StepKind::rotate, 1});
+        CHECK(lower.ntt_count < rotation.ntt_count);
+        CHECK(lower.key_bytes < rotation.key_bytes);
+
+        auto product = model.estimate(CostOp{StepKind::mult});
+        CHECK(product.mul_count == 3 * 3);
+        CHECK(product.peak_bytes == (2 * 2 + 3) * 3 * comp_bytes);
+
+        // CKKS drops primes for free, while BGV switches moduli
+        CostOp dropping{StepKind::drop_primes, 0, 2};
+        CHECK(model.estimate(dropping).ntt_count == 0);
+        CostModel bgv_model(
+            CostParams{dimension, component_count, CostScheme::bgv},
+            calibration);
+        // the two primes are dropped in one pass
+        CHECK(bgv_model.estimate(dropping).ntt_count == 2 * 3);
+
+        auto ops = model.estimate({CostOp{StepKind::mult},
+                                   CostOp{StepKind::relinearize},
+                                   CostOp{StepKind::rescale}});
+        auto relinearization = model.estimate(CostOp{StepKind::relinearize});
+        auto rescaling = model.estimate(CostOp{StepKind::rescale});
+        CHECK(ops.ntt_count ==
+              relinearization.ntt_count + rescaling.ntt_count);
+        CHECK(ops.peak_bytes == relinearization.peak_bytes);
+        CHECK(ops.to_string().find("key_switch=1") != std::string::npos);
+
+        // rescaling in the division by the special prime saves the NTTs of
+        // a second base conversion
+        auto fused = model.estimate(
+            CostOp{StepKind::relinearize_rescale, 0, 0, /*quadratic=*/true});
+        CHECK(fused.ntt_count == relinearization.ntt_count);
+        CHECK(fused.latency_ns <
+              relinearization.latency_ns + rescaling.latency_ns);
+
+        CHECK_THROWS(model.estimate(CostOp{StepKind::add, 3}));
+        CHECK_THROWS(model.estimate(CostOp{StepKind::rescale, 2}));
+    }
+
+    SECTION("circuit") {
+        ckks::Circuit circuit;
+        auto x = circuit.input();
+        auto y = circuit.input();
+        auto xy = circuit.mult(x, y);
+        circuit.output(circuit.add(circuit.rotate(xy, 1), circuit.rotate(xy, 2)));
+        auto plan = circuit.optimize();
+        auto estimate = model.estimate(circuit);
+        CHECK(estimate.key_switch_count ==
+              plan.count(StepKind::relinearize_rescale) +
+                  plan.count(StepKind::rotate));
+        // the rotations are hoisted and at the rescaled level
+        CHECK(estimate.ntt_count ==
+              model.estimate(CostOp{StepKind::relinearize_rescale}).ntt_count +
+                  model.estimate(CostOp{StepKind::decompose, 1}).ntt_count +
+                  2 * model.estimate(CostOp{StepKind::rotate, 1, 0, false,
+                                            true})
+                          .ntt_count);
+        // at least the inputs and the decomposition are alive at once
+        CHECK(estimate.peak_bytes >= 2 * 2 * 3 * comp_bytes);
+        CHECK(estimate.peak_bytes >=
+              model.estimate(CostOp{StepKind::rotate, 1, 0, false, true})
+                  .peak_bytes);
+    }
+
+    SECTION("measured") {
+        auto params = ckks::create_params(dimension, {40, 30, 30}, 40,
+                                          std::pow(2.0, 30));
+        CkksSk sk(params);
+        auto rot_key = get_rot_key(sk, params.additional_mod, 1);
+        std::vector<double> data(dimension / 2, 1.0);
+        auto ct = ckks::encrypt(ckks::simd_encode(data, params), sk);
+
+        ProfileScope scope;
+        ckks::rotate(ct, rot_key);
+        auto report = scope.report();
+#ifdef HEHUB_PROFILE
+        // the counts follow the implementation
+        auto rotation = model.estimate(CostOp{StepKind::rotate});
+        CHECK(report[ProfileCategory::ntt].count +
+                  report[ProfileCategory::intt].count ==
+              rotation.ntt_count);
+        CHECK(report[ProfileCategory::key_switch].bytes == rotation.key_bytes);
+#endif
+
+        CostModel host_model(CostParams{dimension, component_count});
+        CHECK(host_model.calibration().ntt_ns > 0);
+        CHECK(host_model.estimate(CostOp{StepKind::rotate}).latency_ns > 0);
+    }
+}
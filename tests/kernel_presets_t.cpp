@@ -0,0 +1,104 @@
+#include "catch2/catch.hpp"
+#include "fhe/ckks/ckks.h"
+#include "fhe/common/kernel_presets.h"
+#include "fhe/common/mod_arith.h"
+#include "fhe/common/ntt.h"
+#include <random>
+
+using namespace hehub;
+
+/// Unregisters the presets of a test when it ends, even by a failure, so that
+/// the other tests using the same moduli run the generic kernels.
+struct KernelPresetsGuard {
+    ~KernelPresetsGuard() { clear_kernel_presets(); }
+};
+
+TEST_CASE("kernel presets") {
+    const size_t log_dimension = 10;
+    const size_t dimension = 1 << log_dimension;
+    // prime_lists[40][0], prime_lists[40][1], prime_lists[50][0] and
+    // prime_lists[62][0]
+    constexpr u64 q0 = 1099510054913, q1 = 1099507695617,
+                  q2 = 1125899904679937, q3 = 4611686018427322369;
+    const std::vector<u64> moduli{q0, q1, q2, q3};
+
+    std::default_random_engine generator(42);
+    RnsPolynomial poly(dimension, moduli.size(), moduli);
+    RnsPolynomial other(dimension, moduli.size(), moduli);
+    for (size_t k = 0; k < moduli.size(); k++) {
+        std::uniform_int_distribution<u64> distribution(0, moduli[k] - 1);
+        for (size_t i = 0; i < dimension; i++) {
+            poly[k][i] = distribution(generator);
+            other[k][i] = distribution(generator);
+        }
+    }
+
+    // the results of the generic kernels, and a rescaling of a product
+    auto generic_ntt(poly), generic_intt(poly), generic_product(poly),
+        generic_sub_mul(poly);
+    ntt_negacyclic_inplace_lazy(generic_ntt);
+    intt_negacyclic_inplace_lazy(generic_intt);
+    for (size_t k = 0; k < moduli.size(); k++) {
+        batched_mul_mod_hybrid_lazy(moduli[k], dimension, poly[k].data(),
+                                    other[k].data(),
+                                    generic_product[k].data());
+        batched_sub_mul_scalar_lazy(moduli[k], dimension,
+                                    generic_sub_mul[k].data(),
+                                    other[k].data(), 12345);
+    }
+
+    auto params = ckks::create_params(dimension, {40, 40}, 50, pow(2.0, 30));
+    CkksSk sk(params);
+    std::vector<double> data(dimension / 2, 0.25);
+    auto pt = ckks::simd_encode(data, params);
+    auto ct = ckks::encrypt(pt, sk);
+    auto generic_prod = ckks::mult_low_level(ct, ct);
+    auto generic_rescaled(ct);
+    ckks::rescale_inplace(generic_rescaled);
+
+    CHECK_FALSE(has_kernel_preset(log_dimension, q0));
+    KernelPresetsGuard guard;
+    register_kernel_preset<log_dimension, q0, q1, q2, q3>();
+    for (auto modulus : moduli) {
+        CHECK(has_kernel_preset(log_dimension, modulus));
+    }
+    CHECK_FALSE(has_kernel_preset(log_dimension + 1, q0));
+
+    // the specialized kernels give the same results
+    auto preset_ntt(poly), preset_intt(poly), preset_product(poly),
+        preset_sub_mul(poly);
+    ntt_negacyclic_inplace_lazy(preset_ntt);
+    intt_negacyclic_inplace_lazy(preset_intt);
+    for (size_t k = 0; k < moduli.size(); k++) {
+        batched_mul_mod_hybrid_lazy(moduli[k], dimension, poly[k].data(),
+                                    other[k].data(), preset_product[k].data());
+        batched_sub_mul_scalar_lazy(moduli[k], dimension,
+                                    preset_sub_mul[k].data(), other[k].data(),
+                                    12345);
+    }
+    CHECK(preset_ntt == generic_ntt);
+    CHECK(preset_intt == generic_intt);
+    CHECK(preset_product == generic_product);
+    CHECK(preset_sub_mul == generic_sub_mul);
+
+    auto preset_prod = ckks::mult_low_level(ct, ct);
+    auto preset_rescaled(ct);
+    ckks::rescale_inplace(preset_rescaled);
+    for (size_t j = 0; j < 3; j++) {
+        CHECK(preset_prod[j] == generic_prod[j]);
+    }
+    CHECK(preset_rescaled[0] == generic_rescaled[0]);
+    CHECK(preset_rescaled[1] == generic_rescaled[1]);
+
+    // still transformed back and forth
+    auto round_trip(poly);
+    ntt_negacyclic_inplace_lazy(round_trip);
+    intt_negacyclic_inplace_lazy(round_trip);
+    reduce_strict(round_trip);
+    CHECK(round_trip == poly);
+
+    clear_kernel_presets();
+    for (auto modulus : moduli) {
+        CHECK_FALSE(has_kernel_preset(log_dimension, modulus));
+    }
+}
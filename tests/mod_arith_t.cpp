@@ -1,11 +1,13 @@
 #include "catch2/catch.hpp"
 #include "fhe/common/mod_arith.h"
+#include <vector>
 
 using namespace hehub;
 
 TEST_CASE("batched barrett") {
     const u64 modulus =
-        GENERATE(65537, 33333333, 777777777777777, 1234567890111111111);
+        GENERATE(65537, 33333333, 777777777777777, 1234567890111111111,
+                 4611686018427322369);
     const size_t vec_len = 1000;
 
     u64 seed = 42;
@@ -32,7 +34,7 @@ TEST_CASE("batched barrett") {
 }
 
 TEST_CASE("batched mul mod") {
-    const u64 modulus = 1234567890111111111;
+    const u64 modulus = GENERATE(1234567890111111111, 4611686018427322369);
     const size_t vec_len = 1000;
 
     u64 seed = 42;
@@ -46,16 +48,92 @@ TEST_CASE("batched mul mod") {
 
     SECTION("batched_mul_mod_hybrid") {
         batched_mul_mod_hybrid(modulus, vec_len, f, g, h);
-        for (size_t i = 1; i < vec_len; i *= 3) {
+        for (size_t i = 0; i < vec_len; i++) {
             REQUIRE(h[i] == (u128)f[i] * g[i] % modulus);
         }
     }
     SECTION("batched_mul_mod_barrett") {
         batched_mul_mod_barrett(modulus, vec_len, f, g, h);
-        for (size_t i = 1; i < vec_len; i *= 3) {
+        for (size_t i = 0; i < vec_len; i++) {
             REQUIRE(h[i] == (u128)f[i] * g[i] % modulus);
         }
     }
+    SECTION("batched_linear_combination_lazy") {
+        // enough terms for several intermediate reductions of 62-bit moduli
+        const size_t count = 20;
+        std::vector<const u64 *> in_vecs(count);
+        std::vector<u64> scalars(count);
+        for (size_t j = 0; j < count; j++) {
+            in_vecs[j] = j % 2 ? f : g;
+            scalars[j] = j == 3 ? 0 : modulus - 1 - j * 12345;
+        }
+        batched_linear_combination_lazy(modulus, vec_len, count,
+                                        in_vecs.data(), scalars.data(), h);
+        for (size_t i = 0; i < vec_len; i++) {
+            u64 expected = 0;
+            for (size_t j = 0; j < count; j++) {
+                expected = (expected + (u128)in_vecs[j][i] * scalars[j]) %
+                           modulus;
+            }
+            REQUIRE(h[i] < 2 * modulus);
+            REQUIRE(h[i] % modulus == expected);
+        }
+    }
+    SECTION("batched_tensor_mul_mod_hybrid_lazy") {
+        // the other inputs in [q, 2q), where the accumulation is the largest
+        u64 f1[vec_len], g1[vec_len], h1[vec_len], h2[vec_len];
+        for (size_t i = 0; i < vec_len; i++) {
+            f1[i] = g[i] + modulus;
+            g1[i] = 2 * modulus - 1 - f[i];
+        }
+        batched_tensor_mul_mod_hybrid_lazy(modulus, vec_len, f, f1, g, g1, h,
+                                           h1, h2);
+        for (size_t i = 0; i < vec_len; i++) {
+            REQUIRE(h[i] < 2 * modulus);
+            REQUIRE(h1[i] < 2 * modulus);
+            REQUIRE(h2[i] < 2 * modulus);
+            REQUIRE(h[i] % modulus == (u128)f[i] * g[i] % modulus);
+            REQUIRE(h1[i] % modulus ==
+                    ((u128)f[i] * g1[i] + (u128)f1[i] * g[i]) % modulus);
+            REQUIRE(h2[i] % modulus == (u128)f1[i] * g1[i] % modulus);
+        }
+    }
+}
+
+TEST_CASE("batched mul mod 32-bit") {
+    const u32 modulus = GENERATE(65537, 268369921, 1073479681);
+    const size_t vec_len = 1000;
+
+    u64 seed = 42;
+    u32 f[vec_len], g[vec_len], h[vec_len];
+    for (size_t i = 0; i < vec_len; i++) {
+        seed = seed * 65968279837582827 ^ 3948528936546489545;
+        f[i] = seed % modulus;
+        seed = seed * 43534547657678213 ^ 7955436776934235466;
+        g[i] = seed % modulus;
+    }
+
+    SECTION("batched_mul_mod_hybrid") {
+        batched_mul_mod_hybrid(modulus, vec_len, f, g, h);
+        for (size_t i = 0; i < vec_len; i++) {
+            REQUIRE(h[i] == (u64)f[i] * g[i] % modulus);
+        }
+    }
+    SECTION("batched_mul_mod_barrett") {
+        batched_mul_mod_barrett(modulus, vec_len, f, g, h);
+        for (size_t i = 0; i < vec_len; i++) {
+            REQUIRE(h[i] == (u64)f[i] * g[i] % modulus);
+        }
+    }
+    SECTION("batched_barrett") {
+        for (size_t i = 0; i < vec_len; i++) {
+            h[i] = (u32)(f[i] * (u64)g[i]);
+        }
+        batched_barrett(modulus, vec_len, h);
+        for (size_t i = 0; i < vec_len; i++) {
+            REQUIRE(h[i] == (u32)(f[i] * (u64)g[i]) % modulus);
+        }
+    }
 }
 
 TEST_CASE("montgomery") {
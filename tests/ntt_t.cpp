@@ -2,6 +2,7 @@
 #include "fhe/common/mod_arith.h"
 #include "fhe/common/ntt.h"
 #include "fhe/common/permutation.h"
+#include "fhe/common/primelists.h"
 #include "fhe/common/rns.h"
 #include <numeric>
 #include <random>
@@ -92,7 +93,9 @@ TEST_CASE("ntt round trip") {
     auto LOGN = GENERATE(4, 7, 13, 14, 15);
     u64 N = 1 << LOGN;
     u64 Q = GENERATE(65537ULL, 260898817ULL, 35184358850561ULL,
-                     36028796997599233ULL, 576460752272228353ULL);
+                     36028796997599233ULL, 576460752272228353ULL,
+                     prime_lists[60][0], prime_lists[61][0],
+                     prime_lists[62][0]);
 
     std::random_device rd;
     std::default_random_engine generator(rd());
@@ -179,3 +182,220 @@ TEST_CASE("ntt round trip") {
         REQUIRE(rns_poly == rns_poly_copy);
     }
 }
+
+TEST_CASE("interleaved ntt") {
+    auto LOGN = GENERATE(4, 10, 11);
+    auto component_count = GENERATE(2, 3, 4, 5, 8);
+    u64 N = 1 << LOGN;
+    std::vector<u64> moduli{65537ULL,
+                            260898817ULL,
+                            35184358850561ULL,
+                            36028796997599233ULL,
+                            576460752272228353ULL,
+                            prime_lists[40][0],
+                            prime_lists[50][0],
+                            prime_lists[59][0]};
+    // a prime beyond 59 bits makes the components transformed one by one
+    auto large_prime = GENERATE(false, true);
+    if (large_prime) {
+        moduli[1] = prime_lists[62][0];
+    }
+    moduli.resize(component_count);
+
+    std::random_device rd;
+    std::default_random_engine generator(rd());
+    RnsPolynomial rns_poly(N, component_count, moduli);
+    for (size_t k = 0; k < component_count; k++) {
+        std::uniform_int_distribution<u64> distribution(0, moduli[k] - 1);
+        for (int i = 0; i < N; i++) {
+            rns_poly[k][i] = distribution(generator);
+        }
+    }
+    auto rns_poly_copy(rns_poly);
+
+    // the same results as transforming the components one by one
+    auto expected(rns_poly);
+    for (size_t k = 0; k < component_count; k++) {
+        ntt_negacyclic_inplace_lazy(LOGN, moduli[k], expected[k].data());
+    }
+    ntt_negacyclic_inplace_lazy(rns_poly);
+    REQUIRE(rns_poly == expected);
+
+    for (size_t k = 0; k < component_count; k++) {
+        intt_negacyclic_inplace_lazy(LOGN, moduli[k], expected[k].data());
+    }
+    intt_negacyclic_inplace_lazy(rns_poly);
+    REQUIRE(rns_poly == expected);
+
+    reduce_strict(rns_poly);
+    REQUIRE(rns_poly == rns_poly_copy);
+
+    // an empty batch is rejected before its moduli are read
+    u64 *no_components[1];
+    REQUIRE_THROWS_AS(
+        ntt_negacyclic_inplace_lazy(LOGN, 0, nullptr, no_components),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        intt_negacyclic_inplace_lazy(LOGN, 0, nullptr, no_components),
+        std::invalid_argument);
+}
+
+TEST_CASE("32-bit ntt") {
+    auto LOGN = GENERATE(4, 10, 12);
+    const u32 Q = GENERATE(65537U, (u32)prime_lists[27][0], 260898817U,
+                           (u32)prime_lists[29][0]);
+    u64 N = 1 << LOGN;
+
+    std::random_device rd;
+    std::default_random_engine generator(rd());
+    std::uniform_int_distribution<u32> distribution(0, Q - 1);
+    std::vector<u32> poly(N);
+    std::vector<u64> poly_64bit(N);
+    for (int i = 0; i < N; i++) {
+        poly[i] = distribution(generator);
+        poly_64bit[i] = poly[i];
+    }
+    auto poly_copy(poly);
+
+    // the same values as those on 64-bit words, up to the lazy reduction
+    ntt_negacyclic_inplace_lazy(LOGN, Q, poly.data());
+    ntt_negacyclic_inplace_lazy(LOGN, (u64)Q, poly_64bit.data());
+    for (int i = 0; i < N; i++) {
+        REQUIRE(poly[i] < 2 * Q);
+        REQUIRE(poly[i] % Q == poly_64bit[i] % Q);
+    }
+
+    intt_negacyclic_inplace_lazy(LOGN, Q, poly.data());
+    batched_reduce_strict(Q, N, poly.data());
+    REQUIRE(poly == poly_copy);
+
+    // the primes must leave room for the lazy values
+    CHECK_THROWS(
+        ntt_negacyclic_inplace_lazy(LOGN, (u32)3221225473, poly.data()));
+}
+
+TEST_CASE("sparse ntt") {
+    auto LOGN = GENERATE(4, 10, 13);
+    u64 N = 1 << LOGN;
+    u64 Q = GENERATE(65537ULL, 576460752272228353ULL, prime_lists[62][0]);
+    auto nonzero_count = GENERATE(1, 3, 8, 100);
+    auto stride = GENERATE(1, 2, 16);
+    if (nonzero_count > N || stride > N) {
+        return;
+    }
+
+    std::random_device rd;
+    std::default_random_engine generator(rd());
+    std::uniform_int_distribution<u64> distribution(0, Q - 1);
+    SimplePoly poly(N);
+    for (size_t i = 0; i < N; i++) {
+        poly[i] = i < nonzero_count && i % stride == 0 ? distribution(generator)
+                                                       : 0;
+    }
+
+    SECTION("sparse input") {
+        auto expected(poly);
+        ntt_negacyclic_inplace_lazy(LOGN, Q, expected.data());
+        ntt_negacyclic_inplace_lazy_sparse(LOGN, Q, poly.data(), nonzero_count,
+                                           stride);
+        for (size_t i = 0; i < N; i++) {
+            REQUIRE(poly[i] < 2 * Q);
+            REQUIRE(poly[i] % Q == expected[i] % Q);
+        }
+    }
+    SECTION("sparse values") {
+        // here the nonzero values form a prefix
+        for (size_t i = 0; i < N; i++) {
+            poly[i] = i < nonzero_count ? distribution(generator) : 0;
+        }
+        auto expected(poly);
+        intt_negacyclic_inplace_lazy(LOGN, Q, expected.data());
+        intt_negacyclic_inplace_lazy_sparse(LOGN, Q, poly.data(),
+                                            nonzero_count);
+        for (size_t i = 0; i < N; i++) {
+            REQUIRE(poly[i] < 2 * Q);
+            REQUIRE(poly[i] % Q == expected[i] % Q);
+        }
+    }
+    SECTION("truncated output") {
+        for (size_t i = 0; i < N; i++) {
+            poly[i] = distribution(generator);
+        }
+        auto expected(poly);
+        ntt_negacyclic_inplace_lazy(LOGN, Q, expected.data());
+        auto output_begin = std::min<size_t>(3 * stride, N - 1);
+        auto output_count = std::min<size_t>(nonzero_count, N - output_begin);
+        ntt_negacyclic_inplace_lazy_truncated(LOGN, Q, poly.data(),
+                                              output_begin, output_count);
+        for (size_t i = output_begin; i < output_begin + output_count; i++) {
+            REQUIRE(poly[i] < 2 * Q);
+            REQUIRE(poly[i] % Q == expected[i] % Q);
+        }
+    }
+
+    CHECK_THROWS(
+        ntt_negacyclic_inplace_lazy_sparse(LOGN, Q, poly.data(), 1, 3));
+    CHECK_THROWS(
+        ntt_negacyclic_inplace_lazy_truncated(LOGN, Q, poly.data(), N, 1));
+}
+
+TEST_CASE("compact ntt factors") {
+    auto LOGN = GENERATE(1, 2, 7, 13);
+    u64 N = 1 << LOGN;
+    u64 Q = GENERATE(65537ULL, prime_lists[50][0], prime_lists[62][0]);
+
+    std::random_device rd;
+    std::default_random_engine generator(rd());
+    std::uniform_int_distribution<u64> distribution(0, Q - 1);
+    SimplePoly poly(N);
+    for (size_t i = 0; i < N; i++) {
+        poly[i] = distribution(generator);
+    }
+    auto poly_copy(poly);
+
+    // the same values as those of the full storage modulo q
+    auto expected(poly);
+    ntt_negacyclic_inplace_lazy(LOGN, Q, expected.data());
+    set_ntt_factor_storage(NTTFactorStorage::compact);
+    ntt_negacyclic_inplace_lazy(LOGN, Q, poly.data());
+    for (size_t i = 0; i < N; i++) {
+        REQUIRE(poly[i] < 2 * Q);
+        REQUIRE(poly[i] % Q == expected[i] % Q);
+    }
+
+    intt_negacyclic_inplace_lazy(LOGN, Q, poly.data());
+    for (size_t i = 0; i < N; i++) {
+        REQUIRE(poly[i] < 2 * Q);
+    }
+    batched_reduce_strict(Q, N, poly.data());
+    REQUIRE(poly == poly_copy);
+
+    // on 32-bit words
+    const u32 Q_32bit = prime_lists[27][0];
+    std::vector<u32> poly_32bit(N);
+    for (size_t i = 0; i < N; i++) {
+        poly_32bit[i] = poly_copy[i] % Q_32bit;
+    }
+    auto poly_32bit_copy(poly_32bit);
+    ntt_negacyclic_inplace_lazy(LOGN, Q_32bit, poly_32bit.data());
+    intt_negacyclic_inplace_lazy(LOGN, Q_32bit, poly_32bit.data());
+    batched_reduce_strict(Q_32bit, N, poly_32bit.data());
+    REQUIRE(poly_32bit == poly_32bit_copy);
+
+    // several components, which are transformed one by one
+    std::vector<u64> moduli{prime_lists[50][0], prime_lists[50][1]};
+    RnsPolynomial rns_poly(N, 2, moduli);
+    for (size_t k = 0; k < 2; k++) {
+        for (size_t i = 0; i < N; i++) {
+            rns_poly[k][i] = poly_copy[i] % moduli[k];
+        }
+    }
+    auto rns_poly_copy(rns_poly);
+    ntt_negacyclic_inplace_lazy(rns_poly);
+    intt_negacyclic_inplace(rns_poly);
+    REQUIRE(rns_poly == rns_poly_copy);
+
+    set_ntt_factor_storage(NTTFactorStorage::full);
+    CHECK(ntt_factor_bytes(16, NTTFactorStorage::compact) * 6 <
+          ntt_factor_bytes(16, NTTFactorStorage::full));
+}
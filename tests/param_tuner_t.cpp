@@ -0,0 +1,96 @@
+#include "catch2/catch.hpp"
+#include "param_tuner.h"
+#include <algorithm>
+#include <set>
+#include <tuple>
+
+using namespace hehub;
+
+TEST_CASE("parameter tuning") {
+    ckks::TuningRequirements req;
+    req.depth = 3;
+    req.precision_bits = 20;
+    req.rotation_steps = {1, 2};
+
+    auto candidates = ckks::tuning_candidates(req);
+    REQUIRE(!candidates.empty());
+    std::set<std::tuple<size_t, std::vector<u64>, u64>> chains;
+    for (auto &candidate : candidates) {
+        const auto &params = candidate.params;
+        CHECK(params.component_count >= req.depth + 1);
+        double total_bits = std::log2(params.additional_mod);
+        for (auto modulus : params.moduli) {
+            total_bits += std::log2(modulus);
+            CHECK(modulus < params.additional_mod);
+        }
+        CHECK(total_bits <= max_modulus_bits(params.dimension));
+        CHECK(std::round(total_bits) == candidate.modulus_bits);
+        CHECK(candidate.scaling_bits >= req.precision_bits);
+        CHECK(candidate.estimate.key_switch_count == req.depth + 2);
+        chains.emplace(params.dimension, params.moduli, params.additional_mod);
+    }
+    // several sizes of the primes are tried for a dimension
+    CHECK(chains.size() == candidates.size());
+    CHECK(std::count_if(candidates.begin(), candidates.end(),
+                        [&](const ckks::TunedParams &candidate) {
+                            return candidate.params.dimension ==
+                                   candidates[0].params.dimension;
+                        }) > 1);
+
+    // The cost grows with the dimension, hence the smallest one is chosen,
+    // with the fewest bits among the chains as fast.
+    auto tuned = ckks::tune_params(req);
+    CHECK(tuned.params.dimension == 8192);
+    CHECK(tuned.params.dimension == candidates[0].params.dimension);
+    CHECK(tuned.params.component_count == req.depth + 1);
+    CHECK(tuned.modulus_bits == candidates[0].modulus_bits);
+    CHECK(tuned.params.initial_scaling_factor ==
+          std::pow(2.0, tuned.scaling_bits));
+
+    // unknown dimensions are still reported as before
+    CHECK_THROWS_AS(ckks::create_params(3000, 30), const char *);
+
+    SECTION("security") {
+        req.security = SecurityLevel::classical_192;
+        CHECK(ckks::tune_params(req).params.dimension == 16384);
+        req.depth = 40;
+        CHECK_THROWS(ckks::tune_params(req));
+    }
+
+    SECTION("split base modulus") {
+        // the integral and precision bits do not fit in one prime
+        req.precision_bits = 40;
+        req.integer_bits = 30;
+        auto split = ckks::tune_params(req);
+        CHECK(split.params.component_count == req.depth + 2);
+        CHECK(std::log2(split.params.moduli[0]) +
+                  std::log2(split.params.moduli[1]) >=
+              split.scaling_bits + req.integer_bits - 1);
+    }
+
+    SECTION("slots") {
+        req.slot_count = 8192;
+        CHECK(ckks::tune_params(req).params.dimension == 16384);
+    }
+
+    SECTION("circuit") {
+        ckks::Circuit circuit;
+        auto x = circuit.input();
+        circuit.output(circuit.rotate(circuit.mult(x, x), 1));
+        req.circuit = &circuit;
+        req.depth = 1;
+        auto tuned_circuit = ckks::tune_params(req);
+        CHECK(tuned_circuit.params.component_count == 2);
+        CHECK(tuned_circuit.estimate.key_switch_count == 2);
+    }
+
+    SECTION("benchmark") {
+        req.depth = 1;
+        req.precision_bits = 10;
+        req.rotation_steps = {1};
+        req.benchmark = true;
+        auto benchmarked = ckks::tune_params(req);
+        CHECK(benchmarked.measured_ns > 0);
+        CHECK(benchmarked.params.dimension >= 4096);
+    }
+}
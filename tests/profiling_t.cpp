@@ -0,0 +1,64 @@
+#include "catch2/catch.hpp"
+#include "fhe/ckks/ckks.h"
+#include "fhe/common/profiling.h"
+#include "fhe/common/task_runtime.h"
+
+using namespace hehub;
+using Category = ProfileCategory;
+
+TEST_CASE("profiling") {
+    auto params = ckks::create_params(256, {40, 30, 30}, 40, std::pow(2.0, 30));
+    CkksSk sk(params);
+    auto rot_key = get_rot_key(sk, params.additional_mod, 1);
+    std::vector<double> data(128, 1.0);
+    auto pt = ckks::simd_encode(data, params);
+    auto ct = ckks::encrypt(pt, sk);
+
+    ProfileScope outer_scope;
+    auto ct_new = ckks::encrypt(pt, sk);
+    ProfileReport rotation_report;
+    {
+        ProfileScope inner_scope;
+        auto ct_rotated = ckks::rotate(ct, rot_key);
+        rotation_report = inner_scope.report();
+    }
+    auto report = outer_scope.report();
+
+#ifdef HEHUB_PROFILE
+    CHECK(rotation_report[Category::key_switch].count == 1);
+    CHECK(rotation_report[Category::automorphism].count == 2);
+    CHECK(rotation_report[Category::rescale].count == 1);
+    CHECK(rotation_report[Category::sampling].count == 0);
+    CHECK(rotation_report[Category::ntt].count > 0);
+    CHECK(rotation_report[Category::intt].count > 0);
+    CHECK(rotation_report[Category::allocation].count > 0);
+    CHECK(rotation_report[Category::key_switch].bytes > 0);
+
+    // the outer scope also counts the encryption
+    CHECK(report[Category::key_switch].count == 1);
+    CHECK(report[Category::sampling].count > 0);
+    CHECK(report[Category::ntt].count >
+          rotation_report[Category::ntt].count);
+    CHECK(report.to_string().find("key_switch=1") != std::string::npos);
+
+    SECTION("parallel") {
+        // the work of the tasks on other threads goes to the same scope
+        set_thread_count(4);
+        ProfileScope scope;
+        auto ct_rotated = ckks::rotate(ct, rot_key);
+        auto parallel_report = scope.report();
+        set_thread_count(1);
+        for (auto category : {Category::ntt, Category::intt,
+                              Category::key_switch, Category::rescale,
+                              Category::automorphism}) {
+            CHECK(parallel_report[category].count ==
+                  rotation_report[category].count);
+        }
+    }
+#else
+    for (auto &entry : report.entries) {
+        CHECK(entry.count == 0);
+    }
+    CHECK(report.to_string().empty());
+#endif
+}
@@ -1,5 +1,8 @@
 #include "catch2/catch.hpp"
+#include "fhe/common/mod_arith.h"
+#include "fhe/common/sampling.h"
 #include "fhe/primitives/rlwe.h"
+#include <algorithm>
 #include <numeric>
 
 using namespace hehub;
@@ -32,3 +35,77 @@ TEST_CASE("rlwe") {
                                 true, check_if_close));
     }
 }
+
+TEST_CASE("rlwe minimal decryption") {
+    RnsPolyParams params = create_params(4096, {30, 30, 30});
+    RlweSk sk(params);
+
+    SECTION("small plaintext") {
+        RlwePt pt(params);
+        for (auto &component_poly : pt) {
+            std::fill(component_poly.begin(), component_poly.end(), 123456);
+        }
+        auto ct = encrypt_core(pt, sk);
+
+        auto pt_recovered = decrypt_core_minimal(ct, sk);
+        REQUIRE(pt_recovered.component_count() == 1);
+        auto pt_full = decrypt_core(ct, sk);
+        CHECK(std::equal(pt_recovered[0].begin(), pt_recovered[0].end(),
+                         pt_full[0].begin()));
+
+        auto pt_truncated = decrypt_core(ct, sk, 2);
+        REQUIRE(pt_truncated.component_count() == 2);
+        for (size_t k = 0; k < 2; k++) {
+            CHECK(std::equal(pt_truncated[k].begin(), pt_truncated[k].end(),
+                             pt_full[k].begin()));
+        }
+        CHECK_THROWS(decrypt_core(ct, sk, 4));
+    }
+
+    SECTION("large plaintext") {
+        auto pt = get_rand_uniform_poly(params, PolyRepForm::coeff);
+        auto ct = encrypt_core(pt, sk);
+
+        // the first prime does not suffice, hence all of them are used
+        auto pt_recovered = decrypt_core_minimal(ct, sk);
+        REQUIRE(pt_recovered.component_count() == 3);
+        CHECK(pt_recovered == decrypt_core(ct, sk));
+    }
+}
+
+TEST_CASE("ct accumulator") {
+    // 62-bit primes, which are reduced at every other addition, and a smaller
+    // one, which is reduced only in the end
+    auto params = create_params(16, {62, 62, 40});
+    const size_t count = 10;
+
+    CtAccumulator accumulator;
+    RlweCt sum;
+    for (size_t j = 0; j < count; j++) {
+        RlweCt ct;
+        for (auto &rns_poly : ct) {
+            rns_poly = get_rand_uniform_poly(params, PolyRepForm::value);
+            // lazy values in [q, 2q) where possible, as the largest inputs
+            for (size_t k = 0; k < params.component_count; k++) {
+                for (auto &value : rns_poly[k]) {
+                    value += params.moduli[k];
+                }
+            }
+        }
+        accumulator.add(ct);
+        sum = j == 0 ? ct : add(sum, ct);
+    }
+    REQUIRE(accumulator.count() == count);
+
+    auto result = accumulator.result();
+    for (size_t poly_idx = 0; poly_idx < 2; poly_idx++) {
+        reduce_strict(result[poly_idx]);
+        reduce_strict(sum[poly_idx]);
+        CHECK(result[poly_idx] == sum[poly_idx]);
+    }
+
+    CHECK_THROWS(CtAccumulator().result());
+    RlweCt other{RnsPolynomial(create_params(16, {30})),
+                 RnsPolynomial(create_params(16, {30}))};
+    CHECK_THROWS(accumulator.add(other));
+}
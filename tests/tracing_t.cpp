@@ -0,0 +1,87 @@
+#include "catch2/catch.hpp"
+#include "fhe/ckks/ckks.h"
+#include "fhe/common/task_runtime.h"
+#include "fhe/common/tracing.h"
+#include <sstream>
+
+using namespace hehub;
+
+static size_t count_occurrences(const std::string &trace,
+                                const std::string &pattern) {
+    size_t count = 0;
+    for (auto pos = trace.find(pattern); pos != std::string::npos;
+         pos = trace.find(pattern, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+static size_t count_events(const std::string &trace, const std::string &name,
+                           char phase) {
+    return count_occurrences(trace, "\"name\":\"" + name + "\",\"ph\":\"" +
+                                        phase + "\"");
+}
+
+TEST_CASE("tracing") {
+    auto params = ckks::create_params(256, {40, 30, 30}, 40, std::pow(2.0, 30));
+    CkksSk sk(params);
+    auto rot_key = get_rot_key(sk, params.additional_mod, 1);
+    std::vector<double> data(128, 1.0);
+    auto ct = ckks::encrypt(ckks::simd_encode(data, params), sk);
+
+    trace_start();
+    auto ct_rotated = ckks::rotate(ct, rot_key);
+    trace_stop();
+    std::stringstream out;
+    auto event_count = trace_flush(out);
+    auto trace = out.str();
+
+    CHECK(trace.find("\"traceEvents\"") != std::string::npos);
+#ifdef HEHUB_TRACE
+    CHECK(count_events(trace, "ckks::rotate", 'B') == 1);
+    CHECK(count_events(trace, "ckks::rotate", 'E') == 1);
+    for (auto phase : {"ModUp", "KeyMAC", "ModDown", "Rescale", "NTT"}) {
+        CHECK(count_events(trace, phase, 'B') > 0);
+    }
+    CHECK(count_occurrences(trace, "\"ph\":\"B\"") ==
+          count_occurrences(trace, "\"ph\":\"E\""));
+    CHECK(count_occurrences(trace, "\"ph\":") == event_count);
+
+    // the events are not recorded after stopping, and are cleared by flushing
+    ckks::rotate(ct, rot_key);
+    std::stringstream empty_out;
+    CHECK(trace_flush(empty_out) == 0);
+
+    SECTION("sampling") {
+        TraceOptions options;
+        options.sample_period = 2;
+        trace_start(options);
+        for (int i = 0; i < 4; i++) {
+            ckks::rotate(ct, rot_key);
+        }
+        trace_stop();
+        std::stringstream sampled_out;
+        trace_flush(sampled_out);
+        CHECK(count_events(sampled_out.str(), "ckks::rotate", 'B') == 2);
+        // the phases are only traced in the sampled operations
+        CHECK(count_events(sampled_out.str(), "KeyMAC", 'B') == 2);
+    }
+
+    SECTION("parallel") {
+        // the tasks on other threads follow the operation being traced
+        set_thread_count(4);
+        trace_start();
+        ckks::rotate(ct, rot_key);
+        trace_stop();
+        set_thread_count(1);
+        std::stringstream parallel_out;
+        trace_flush(parallel_out);
+        auto parallel_trace = parallel_out.str();
+        CHECK(count_events(parallel_trace, "ckks::rotate", 'B') == 1);
+        CHECK(count_events(parallel_trace, "KeyMAC", 'B') == 1);
+        CHECK(count_events(parallel_trace, "KeyMAC", 'E') == 1);
+    }
+#else
+    CHECK(event_count == 0);
+#endif
+}